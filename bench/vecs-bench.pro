@@ -0,0 +1,14 @@
+# Бенчмарки горячего пути сбора данных.
+# Результаты в машиночитаемом виде: ./vecs-bench -o results.xml,xml (или -csv)
+
+TEMPLATE = app
+TARGET = vecs-bench
+
+QT += testlib qml bluetooth network
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(../vecs-core.pri)
+
+SOURCES += vecsbench.cpp
@@ -0,0 +1,468 @@
+#include <QtTest>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QThread>
+#include <QUdpSocket>
+#include <algorithm>
+#include <random>
+#include "vecsdevice.h"
+#include "vecsbletransport.h"
+#include "vecssimtransport.h"
+#include "vecsunits.h"
+#include "vecsfusion.h"
+#include "vecsstreamserver.h"
+#include "vecssamplecodec.h"
+
+/*
+ * Транспорт для измерений: повторяет путь уведомления VecsBleTransport
+ * (декодирование пакета и запись в буфер), но пакеты подаются вызовом notify().
+ */
+class VecsBenchTransport : public VecsTransport
+{
+    Q_OBJECT
+
+public:
+    explicit VecsBenchTransport(const QBluetoothAddress &address, QObject *parent = 0) :
+        VecsTransport(address, parent)
+    {
+        beginMpuStream();
+    }
+
+    void notify(const QByteArray &data)
+    {
+        VecsSample s;
+        s.timestamp = vecsTimestamp();
+        if (VecsBleTransport::decodeMpuData(data, &s))
+            pushSample(s);
+    }
+
+public slots:
+    void connectToDevice() override {}
+    void disconnectFromDevice() override {}
+    void keyRequest(int delay) override { Q_UNUSED(delay) }
+    void mpuStart() override {}
+    void mpuStop() override {}
+};
+
+// Пакет MPU в формате устройства (big endian)
+static QByteArray mpuPacket(quint16 index)
+{
+    QByteArray data(14, 0);
+    uchar *p = reinterpret_cast<uchar *>(data.data());
+    const qint16 values[7] = { qint16(index * 3), -16384, 120, qint16(index), 5, qint16(-index), 17 };
+    for (int i = 0; i < 7; ++i)
+        qToBigEndian<qint16>(values[i], p + 2 * i);
+    return data;
+}
+
+static QBluetoothAddress benchAddress(int n)
+{
+    return QBluetoothAddress(Q_UINT64_C(0x020000000000) + quint64(n + 1));
+}
+
+class VecsBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    // Декодирование одного пакета MPU
+    void decode();
+    // Перевод блока отсчетов в физические единицы (развертывание в структуру массивов и умножение)
+    void convert_data();
+    void convert();
+    // Один шаг фильтра ориентации для всех датчиков выровненного кадра
+    void fusion_data();
+    void fusion();
+    // Путь уведомления: декодирование, учет потерь, интерполяция, запись в буфер, пробуждение потребителя
+    void notification_data();
+    void notification();
+    // Один кадр: разбор буферов всех устройств, публикация свойств и пересчет привязок QML
+    void fanout_data();
+    void fanout();
+    // Отправка отсчетов одного устройства подписчику по UDP (кодирование и датаграммы)
+    void streaming_data();
+    void streaming();
+    // Кодирование и распаковка сжатого блока из 256 отсчетов (запись сессии, сжатые кадры)
+    void codec_data();
+    void codec();
+    // Средняя задержка от приема пакета до потребителя в потоке GUI, мс
+    void endToEnd_data();
+    void endToEnd();
+
+private:
+    void deviceRows();
+};
+
+void VecsBench::initTestCase()
+{
+    qRegisterMetaType<VecsSample>();
+    qmlRegisterType<VecsDevice>("com.vecs.device", 1, 0, "VecsDevice");
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    qmlRegisterAnonymousType<VecsSampleWindow>("com.vecs.device", 1);
+#else
+    qmlRegisterType<VecsSampleWindow>();
+#endif
+}
+
+void VecsBench::deviceRows()
+{
+    QTest::addColumn<int>("devices");
+    QTest::addColumn<int>("rate");
+
+    const int devices[] = { 1, 4, 8, 16, 32 };
+    const int rates[] = { 50, 100, 200 };
+    for (int d : devices) {
+        for (int r : rates)
+            QTest::newRow(qPrintable(QString("%1dev@%2Hz").arg(d).arg(r))) << d << r;
+    }
+}
+
+void VecsBench::decode()
+{
+    QVector<QByteArray> packets;
+    for (int i = 0; i < 1024; ++i)
+        packets.append(mpuPacket(quint16(i)));
+
+    VecsSample s;
+    int decoded = 0;
+    QBENCHMARK {
+        for (const auto& packet : packets)
+            decoded += VecsBleTransport::decodeMpuData(packet, &s);
+    }
+    QVERIFY(decoded > 0);
+}
+
+void VecsBench::convert_data()
+{
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("frame@200Hz") << 4;
+    QTest::newRow("64") << 64;
+    QTest::newRow("1024") << 1024;
+}
+
+void VecsBench::convert()
+{
+    QFETCH(int, size);
+
+    QVector<VecsSample> samples(size);
+    for (int i = 0; i < size; ++i)
+        VecsBleTransport::decodeMpuData(mpuPacket(quint16(i)), &samples[i]);
+
+    VecsSampleBlock raw;
+    VecsMotionBlock motion;
+    QBENCHMARK {
+        raw.clear();
+        raw.append(samples.constData(), size);
+        VecsUnits::convert(raw, 1, 2, &motion);
+    }
+    QCOMPARE(motion.size(), size);
+}
+
+void VecsBench::fusion_data()
+{
+    QTest::addColumn<int>("devices");
+
+    QTest::newRow("1dev") << 1;
+    QTest::newRow("8dev") << 8;
+    QTest::newRow("32dev") << 32;
+}
+
+void VecsBench::fusion()
+{
+    QFETCH(int, devices);
+
+    VecsFusionEngine engine;
+    for (int i = 0; i < devices; ++i)
+        engine.setStreamRanges(i, VecsDevice::ACC_2G, VecsDevice::GYRO_250DEGS);
+
+    // Кадры 200 Гц с датчиками в покое под разными углами
+    VecsAlignedFrame frame;
+    frame.validMask = (devices == 32) ? 0xffffffffu : (1u << devices) - 1;
+    frame.samples.resize(devices);
+    for (int i = 0; i < devices; ++i) {
+        VecsSample &s = frame.samples[i];
+        s.accel[0] = qint16(200 * i);
+        s.accel[1] = -1000;
+        s.accel[2] = 16000;
+        s.gyro[0] = 10;
+        s.gyro[1] = -20;
+        s.gyro[2] = qint16(i);
+    }
+
+    QBENCHMARK {
+        frame.timestamp += 5000000;
+        for (auto& s : frame.samples)
+            s.timestamp = frame.timestamp;
+        engine.processFrame(frame);
+    }
+
+    VecsOrientation q;
+    QVERIFY(engine.orientation(devices - 1, &q));
+    QVERIFY(qAbs(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z - 1.0f) < 1e-3f);
+}
+
+void VecsBench::notification_data()
+{
+    QTest::addColumn<double>("lossRate");
+    QTest::addColumn<int>("interpolate");
+
+    QTest::newRow("clean") << 0.0 << 0;
+    QTest::newRow("loss 5%") << 0.05 << 0;
+    QTest::newRow("loss 5%, interpolated") << 0.05 << 4;
+}
+
+void VecsBench::notification()
+{
+    QFETCH(double, lossRate);
+    QFETCH(int, interpolate);
+
+    // Потери задаются заранее, чтобы генератор случайных чисел не попадал в измерение.
+    // Блок покрывает весь диапазон счетчика, поэтому повторы продолжают поток без скачков
+    QVector<QByteArray> packets;
+    std::minstd_rand random(1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int index = 0; index < 65536; ++index) {
+        if (uniform(random) >= lossRate)
+            packets.append(mpuPacket(quint16(index)));
+    }
+
+    VecsSampleRing ring;
+    VecsBenchTransport transport(benchAddress(0));
+    transport.setRing(&ring);
+    transport.setMaxInterpolatedGap(interpolate);
+
+    // Потребитель сразу подтверждает пробуждение, как это делает VecsDevice
+    connect(&transport, &VecsTransport::samplesAvailable, &transport, &VecsTransport::acknowledgeSamples);
+
+    QBENCHMARK {
+        for (const auto& packet : packets)
+            transport.notify(packet);
+    }
+    QVERIFY(ring.head() > 0);
+}
+
+void VecsBench::fanout_data()
+{
+    deviceRows();
+}
+
+void VecsBench::fanout()
+{
+    QFETCH(int, devices);
+    QFETCH(int, rate);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData("import QtQml 2.2\n"
+                      "QtObject {\n"
+                      "    property QtObject device\n"
+                      "    property real accel: device ? device.accelX + device.accelY + device.accelZ : 0\n"
+                      "    property real gyro: device ? device.gyroX + device.gyroY + device.gyroZ : 0\n"
+                      "    property int index: device ? device.packetIndex : 0\n"
+                      "    property var low: device ? device.mpuWindow.min : []\n"
+                      "    property var high: device ? device.mpuWindow.max : []\n"
+                      "    property var mean: device ? device.mpuWindow.mean : []\n"
+                      "}\n", QUrl());
+    QVERIFY2(component.isReady(), qPrintable(component.errorString()));
+
+    QList<VecsBenchTransport *> transports;
+    QList<VecsDevice *> devs;
+    QList<QObject *> bindings;
+    for (int i = 0; i < devices; ++i) {
+        VecsBenchTransport *transport = new VecsBenchTransport(benchAddress(i));
+        VecsDevice *dev = new VecsDevice(transport, 0, nullptr, this);
+        dev->setMpuRate(rate);
+        transports.append(transport);
+        devs.append(dev);
+
+        QObject *binding = component.beginCreate(engine.rootContext());
+        binding->setProperty("device", QVariant::fromValue<QObject *>(dev));
+        component.completeCreate();
+        bindings.append(binding);
+    }
+
+    // Пакеты, приходящие за один кадр 60 Гц
+    const int perFrame = qMax(1, rate / 60);
+    quint16 index = 0;
+
+    QBENCHMARK {
+        for (int k = 0; k < perFrame; ++k, ++index) {
+            const QByteArray packet = mpuPacket(index);
+            for (auto transport : transports)
+                transport->notify(packet);
+        }
+        for (auto dev : devs)
+            dev->publishFrame();
+    }
+
+    QCOMPARE(bindings.first()->property("index").toInt(), int(devs.first()->packetIndex()));
+
+    qDeleteAll(bindings);
+    qDeleteAll(devs);
+    // Транспорты удаляются через deleteLater()
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+void VecsBench::streaming_data()
+{
+    QTest::addColumn<int>("batch");
+
+    QTest::newRow("batch 1") << 1;
+    QTest::newRow("batch 8") << 8;
+}
+
+void VecsBench::streaming()
+{
+    QFETCH(int, batch);
+
+    VecsSampleRing ring;
+    VecsStreamServer server;
+    server.setUdpPort(45760);
+    server.setTcpPort(0);
+    server.setBatch(batch);
+    server.addStream(&ring, VecsStreamServer::StreamInfo{ benchAddress(0).toString(), VecsDevice::RolePatientHand,
+                                                         VecsDevice::ACC_2G, VecsDevice::GYRO_250DEGS, 200 });
+    QVERIFY(server.start());
+
+    QUdpSocket client;
+    QVERIFY(client.bind(QHostAddress::LocalHost, 0));
+    QByteArray subscribe(VecsStreamFormat::HeaderSize, 0);
+    VecsStreamFormat::Header header = {};
+    header.type = VecsStreamFormat::FrameSubscribe;
+    header.device = VecsStreamFormat::AllDevices;
+    VecsStreamFormat::writeHeader(reinterpret_cast<uchar *>(subscribe.data()), header);
+    client.writeDatagram(subscribe, QHostAddress::LocalHost, 45760);
+    QTRY_VERIFY(client.hasPendingDatagrams());
+
+    // 16 отсчетов за опрос: пачка из кольца при частоте опроса ниже частоты датчика
+    VecsSample s;
+    VecsBleTransport::decodeMpuData(mpuPacket(0), &s);
+    QBENCHMARK {
+        for (int i = 0; i < 16; ++i) {
+            s.timestamp = vecsTimestamp();
+            s.packetIndex++;
+            ring.push(s);
+        }
+        server.poll();
+        // Датаграммы вычитываются, чтобы не переполнить буфер приема
+        while (client.hasPendingDatagrams())
+            client.readDatagram(nullptr, 0);
+    }
+
+    QVERIFY(server.samplesSent() > 0);
+    server.stop();
+}
+
+void VecsBench::codec_data()
+{
+    QTest::addColumn<bool>("decode");
+
+    QTest::newRow("encode") << false;
+    QTest::newRow("decode") << true;
+}
+
+void VecsBench::codec()
+{
+    QFETCH(bool, decode);
+
+    // Интервал 5 мс с дрожанием времени приема, как у уведомлений BLE при 200 Гц
+    const int count = VecsSampleCodec::BlockSamples;
+    QVector<VecsSample> samples(count);
+    for (int i = 0; i < count; ++i) {
+        VecsBleTransport::decodeMpuData(mpuPacket(quint16(i)), &samples[i]);
+        samples[i].timestamp = qint64(i) * 5000000 + (i * 7919) % 300000;
+    }
+
+    QByteArray block(VecsSampleCodec::maxEncodedSize(count), 0);
+    uchar *p = reinterpret_cast<uchar *>(block.data());
+    const int size = VecsSampleCodec::encode(samples.constData(), count, 0, 0, p);
+    QVERIFY(size > 0);
+
+    QVector<VecsSample> decoded(count);
+    if (decode) {
+        QBENCHMARK {
+            VecsSampleCodec::decode(p, size, decoded.data());
+        }
+    } else {
+        QBENCHMARK {
+            VecsSampleCodec::encode(samples.constData(), count, 0, 0, p);
+        }
+        VecsSampleCodec::decode(p, size, decoded.data());
+    }
+    QCOMPARE(decoded.last().timestamp, samples.last().timestamp);
+    QCOMPARE(decoded.last().gyro[2], samples.last().gyro[2]);
+}
+
+void VecsBench::endToEnd_data()
+{
+    deviceRows();
+}
+
+void VecsBench::endToEnd()
+{
+    QFETCH(int, devices);
+    QFETCH(int, rate);
+
+    const int duration = qEnvironmentVariableIsSet("VECS_BENCH_DURATION")
+            ? qgetenv("VECS_BENCH_DURATION").toInt() : 2000;
+
+    QThread thread;
+    thread.setObjectName("acquisition");
+    thread.start(QThread::HighPriority);
+
+    VecsSimConfig config;
+    config.connectTime = 10;
+
+    QList<VecsDevice *> devs;
+    for (int i = 0; i < devices; ++i) {
+        config.seed = quint32(i + 1);
+        VecsDevice *dev = new VecsDevice(new VecsSimTransport(benchAddress(i), config), 0, &thread, this);
+        dev->setMpuRate(rate);
+        // Роль пациента включает автоматический запуск MPU после подключения
+        dev->setRole(VecsDevice::RolePatientHand);
+        dev->connectToDevice();
+        devs.append(dev);
+    }
+
+    QTRY_VERIFY_WITH_TIMEOUT(std::all_of(devs.begin(), devs.end(),
+                                         [](VecsDevice *dev) { return dev->mpuState(); }), 5000);
+
+    QVector<qint64> latencies;
+    latencies.reserve(devices * rate * duration / 1000 * 2);
+    bool measuring = true;
+    for (auto dev : devs) {
+        connect(dev, &VecsDevice::mpuSampleReceived, this, [&](const VecsSample &s) {
+            if (measuring)
+                latencies.append(vecsTimestamp() - s.timestamp);
+        });
+    }
+
+    QTest::qWait(duration);
+    measuring = false;
+
+    qDeleteAll(devs);
+    thread.quit();
+    thread.wait();
+
+    QVERIFY(!latencies.isEmpty());
+    std::sort(latencies.begin(), latencies.end());
+
+    qint64 total = 0;
+    for (qint64 latency : latencies)
+        total += latency;
+
+    qInfo("samples %d, median %.3f ms, p99 %.3f ms, max %.3f ms",
+          latencies.size(),
+          latencies.at(latencies.size() / 2) / 1e6,
+          latencies.at(latencies.size() * 99 / 100) / 1e6,
+          latencies.last() / 1e6);
+
+    QTest::setBenchmarkResult(double(total) / latencies.size() / 1e6, QTest::WalltimeMilliseconds);
+}
+
+QTEST_GUILESS_MAIN(VecsBench)
+
+#include "vecsbench.moc"
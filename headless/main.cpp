@@ -0,0 +1,50 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include "vecsheadless.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("vecs-headless");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("VECS acquisition without user interface");
+    parser.addHelpOption();
+    QCommandLineOption configOption("config", "Read settings from an INI <file> instead of the application settings.", "file");
+    QCommandLineOption devicesOption("devices", "Start the session once <count> devices are found.", "count");
+    QCommandLineOption durationOption("duration", "Stop after <seconds> of recording.", "seconds");
+    QCommandLineOption recordOption("record", "Record the session to <file> (empty name: documents folder).", "file");
+    parser.addOption(configOption);
+    parser.addOption(devicesOption);
+    parser.addOption(durationOption);
+    parser.addOption(recordOption);
+    parser.process(app);
+
+    QSettings *settings = parser.isSet(configOption)
+            ? new QSettings(parser.value(configOption), QSettings::IniFormat)
+            : new QSettings("krisaf", "vecs-controller");
+
+    // Параметры командной строки имеют приоритет над группой headless в настройках
+    VecsHeadless::Options options;
+    options.devices = settings->value("headless/devices", 0).toInt();
+    options.duration = settings->value("headless/duration", 0).toInt();
+    options.record = settings->value("headless/record", false).toBool();
+    options.recordFile = settings->value("headless/record_file").toString();
+    if (parser.isSet(devicesOption))
+        options.devices = parser.value(devicesOption).toInt();
+    if (parser.isSet(durationOption))
+        options.duration = parser.value(durationOption).toInt();
+    if (parser.isSet(recordOption)) {
+        options.record = true;
+        options.recordFile = parser.value(recordOption);
+    }
+
+    VecsHeadless::installSignalHandlers();
+
+    VecsController vecs(settings);
+    VecsHeadless headless(&vecs, options);
+    QTimer::singleShot(0, &headless, SLOT(start()));
+
+    return app.exec();
+}
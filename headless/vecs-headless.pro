@@ -0,0 +1,17 @@
+# Сбор данных без интерфейса: без QML, OpenGL и QtGui.
+# Настройки те же, что у приложения (QSettings), или файл: ./vecs-headless --config capture.ini
+
+TEMPLATE = app
+TARGET = vecs-headless
+
+QT += bluetooth
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(../vecs-core.pri)
+
+SOURCES += main.cpp \
+    vecsheadless.cpp
+
+HEADERS += vecsheadless.h
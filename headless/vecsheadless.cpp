@@ -0,0 +1,154 @@
+#include "vecsheadless.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <QDebug>
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Сигнал передается в цикл событий через пару сокетов: в обработчике допустим только write()
+static int signalFds[2] = { -1, -1 };
+
+#ifdef Q_OS_UNIX
+static void signalHandler(int signal)
+{
+    const char c = char(signal);
+    const ssize_t written = ::write(signalFds[0], &c, sizeof(c));
+    Q_UNUSED(written)
+}
+#endif
+
+VecsHeadless::Options::Options() :
+    devices(0),
+    duration(0),
+    record(false)
+{
+}
+
+VecsHeadless::VecsHeadless(VecsController *controller, const Options &options, QObject *parent) :
+    QObject(parent),
+    m_controller(controller),
+    m_options(options),
+    m_sessionStarted(false),
+    m_signalNotifier(nullptr)
+{
+    connect(m_controller, &VecsController::messageChanged, this, &VecsHeadless::printMessage);
+    connect(m_controller, &VecsController::stateChanged, this, &VecsHeadless::scanStateChanged);
+    connect(m_controller->model(), &VecsDeviceModel::countChanged, this, &VecsHeadless::devicesChanged);
+
+    VecsSessionStarter *session = m_controller->session();
+    connect(session, &VecsSessionStarter::finished, this, &VecsHeadless::sessionFinished);
+    connect(session, &VecsSessionStarter::deviceReady, this, &VecsHeadless::deviceReady);
+    connect(session, &VecsSessionStarter::deviceFailed, this, &VecsHeadless::deviceFailed);
+
+    if (signalFds[1] >= 0) {
+        m_signalNotifier = new QSocketNotifier(signalFds[1], QSocketNotifier::Read, this);
+        connect(m_signalNotifier, &QSocketNotifier::activated, this, &VecsHeadless::signalReceived);
+    }
+}
+
+void VecsHeadless::installSignalHandlers()
+{
+#ifdef Q_OS_UNIX
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalFds) != 0) {
+        qWarning() << "can't create signal socket pair, SIGINT will not stop recording cleanly";
+        return;
+    }
+
+    struct sigaction action;
+    action.sa_handler = signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+#endif
+}
+
+void VecsHeadless::start()
+{
+    m_controller->startScan();
+
+    // Имитация и воспроизведение создают устройства сразу, без поиска
+    if (!m_controller->discovering())
+        startSession();
+}
+
+void VecsHeadless::stop()
+{
+    m_controller->stopRecording();
+    for (const auto& dev : m_controller->devices())
+        dev->disconnectFromDevice();
+
+    QCoreApplication::quit();
+}
+
+void VecsHeadless::printMessage()
+{
+    qInfo().noquote() << m_controller->message();
+}
+
+void VecsHeadless::devicesChanged()
+{
+    if (m_options.devices > 0 && m_controller->model()->count() >= m_options.devices)
+        startSession();
+}
+
+void VecsHeadless::scanStateChanged()
+{
+    if (!m_controller->discovering())
+        startSession();
+}
+
+void VecsHeadless::startSession()
+{
+    if (m_sessionStarted)
+        return;
+
+    if (m_controller->model()->count() == 0) {
+        qWarning() << "no devices found";
+        QCoreApplication::exit(1);
+        return;
+    }
+
+    m_sessionStarted = true;
+    m_controller->startSession();
+}
+
+void VecsHeadless::sessionFinished(int elapsed)
+{
+    Q_UNUSED(elapsed)
+
+    if (m_controller->session()->ready() == 0) {
+        qWarning() << "no devices are ready";
+        QCoreApplication::exit(1);
+        return;
+    }
+
+    if (m_options.record)
+        m_controller->startRecording(m_options.recordFile);
+
+    if (m_options.duration > 0)
+        QTimer::singleShot(m_options.duration * 1000, this, SLOT(stop()));
+}
+
+void VecsHeadless::deviceReady(VecsDevice *device, int elapsed)
+{
+    qInfo().noquote() << QString("[%1] ready in %2 ms").arg(device->address()).arg(elapsed);
+}
+
+void VecsHeadless::deviceFailed(const QString &address, const QString &reason)
+{
+    qWarning().noquote() << QString("[%1] failed: %2").arg(address, reason);
+}
+
+void VecsHeadless::signalReceived()
+{
+    char c;
+    const ssize_t n = ::read(signalFds[1], &c, sizeof(c));
+    Q_UNUSED(n)
+
+    qInfo() << "stopping on signal";
+    stop();
+}
@@ -0,0 +1,56 @@
+#ifndef VECSHEADLESS_H
+#define VECSHEADLESS_H
+
+#include <QObject>
+#include <QSocketNotifier>
+#include "vecscontroller.h"
+
+/*
+ * Сценарий сбора без интерфейса: поиск устройств, запуск сеанса по ролям,
+ * запись сессии и завершение по времени или по SIGINT/SIGTERM.
+ * Сеанс запускается, когда найдено ожидаемое число устройств (headless/devices)
+ * или когда поиск закончился.
+ */
+class VecsHeadless : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        Options();
+
+        int devices;        // Ожидаемое число устройств (0 - ждать окончания поиска)
+        int duration;       // Длительность записи, с (0 - до сигнала)
+        bool record;
+        QString recordFile; // Пустое имя - файл в папке документов
+    };
+
+    VecsHeadless(VecsController *controller, const Options &options, QObject *parent = 0);
+
+    // Перехват SIGINT/SIGTERM для корректного закрытия файла записи
+    static void installSignalHandlers();
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void printMessage();
+    void devicesChanged();
+    void scanStateChanged();
+    void sessionFinished(int elapsed);
+    void deviceReady(VecsDevice *device, int elapsed);
+    void deviceFailed(const QString &address, const QString &reason);
+    void signalReceived();
+
+private:
+    void startSession();
+
+private:
+    VecsController *m_controller;
+    Options m_options;
+    bool m_sessionStarted;
+    QSocketNotifier *m_signalNotifier;
+};
+
+#endif // VECSHEADLESS_H
@@ -3,6 +3,7 @@
 #include <QQmlComponent>
 #include <QQmlContext>
 #include "vecscontroller.h"
+#include "vecswaveform.h"
 
 int main(int argc, char *argv[])
 {
@@ -11,6 +12,20 @@ int main(int argc, char *argv[])
     VecsController vecs;
 
     qmlRegisterType<VecsDevice>("com.vecs.device", 1, 0, "VecsDevice");
+    qmlRegisterType<VecsWaveform>("com.vecs.device", 1, 0, "VecsWaveform");
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    qmlRegisterAnonymousType<VecsSampleWindow>("com.vecs.device", 1);
+    qmlRegisterAnonymousType<VecsFeatureEngine>("com.vecs.device", 1);
+    qmlRegisterAnonymousType<VecsDeviceMetrics>("com.vecs.device", 1);
+    qmlRegisterAnonymousType<VecsSessionStarter>("com.vecs.device", 1);
+    qmlRegisterAnonymousType<VecsDeviceModel>("com.vecs.device", 1);
+#else
+    qmlRegisterType<VecsSampleWindow>();
+    qmlRegisterType<VecsFeatureEngine>();
+    qmlRegisterType<VecsDeviceMetrics>();
+    qmlRegisterType<VecsSessionStarter>();
+    qmlRegisterType<VecsDeviceModel>();
+#endif
 
     QQmlApplicationEngine engine;
     QQmlContext *ctx = engine.rootContext();
@@ -51,6 +51,17 @@ Window {
                     }
                 }
 
+                BorToolButton {
+                    height: toolBar.height
+                    text: vecs.recording ? "Stop recording" : "Record"
+                    onClicked: {
+                        if (vecs.recording)
+                            vecs.stopRecording();
+                        else
+                            vecs.startRecording();
+                    }
+                }
+
                 BorToolButton {
                     height: toolBar.height
                     text: "Save session"
@@ -73,8 +84,10 @@ Window {
                 width: parent.width
                 height: column.height
 
+                property VecsDevice vecs: device
+
                 Connections {
-                    target: modelData
+                    target: device
                     onKeyPressed: {
                         beepButton.checked = false;
                     }
@@ -97,16 +110,16 @@ Window {
 
                         Column {
                             width: 150
-                            Text { text: modelData.address; font.bold: true }
-                            Text { text: "<b>rssi:</b> " + modelData.rssi + "dBm" }
-                            Text { text: "<b>status:</b> " + (modelData.connectionState === 2 ? "connected" : "disconnected") }
-                            Text { text: "<b>role:</b> " + Helper.deviceRoleWrap(modelData.role) }
+                            Text { text: device.address; font.bold: true }
+                            Text { text: "<b>rssi:</b> " + device.rssi + "dBm" }
+                            Text { text: "<b>status:</b> " + (device.connectionState === 2 ? "connected" : "disconnected") }
+                            Text { text: "<b>role:</b> " + Helper.deviceRoleWrap(device.role) }
                         }
 
                         BorCheckButton {
                             anchors.verticalCenter: row.verticalCenter
                             text: {
-                                switch (modelData.connectionState) {
+                                switch (device.connectionState) {
                                 case VecsDevice.StateDisconnected:
                                     return "Connect";
                                 case VecsDevice.StateConnecting:
@@ -116,7 +129,7 @@ Window {
                                 }
                             }
 
-                            checked: modelData.connectionState === VecsDevice.StateConnected
+                            checked: device.connectionState === VecsDevice.StateConnected
 
                             onCheckedChanged: {
                                 if (!checked) {
@@ -125,12 +138,12 @@ Window {
                             }
 
                             onClicked:  {
-                                switch (modelData.connectionState) {
+                                switch (device.connectionState) {
                                 case VecsDevice.StateDisconnected:
-                                    modelData.connectToDevice();
+                                    device.connectToDevice();
                                     break;
                                 case VecsDevice.StateConnected:
-                                    modelData.disconnectFromDevice();                                    
+                                    device.disconnectFromDevice();                                    
                                     break;
                                 }
                             }
@@ -144,24 +157,24 @@ Window {
                         BorDelayButton {
                             id: beepButton
                             anchors.verticalCenter: row.verticalCenter
-                            visible: modelData.connectionState === VecsDevice.StateConnected
+                            visible: device.connectionState === VecsDevice.StateConnected
                             delay: 500
                             text: "Beep"
                             onActivated: {
-                                modelData.keyRequest();
+                                device.keyRequest();
                             }
                         }
                         BorCheckButton {
                             id: mpuStartButton
                             anchors.verticalCenter: row.verticalCenter
-                            visible: modelData.connectionState === VecsDevice.StateConnected
+                            visible: device.connectionState === VecsDevice.StateConnected
                             text: checked ? "Stop" : "Start"
-                            checked: modelData.mpuState
+                            checked: device.mpuState
                             onClicked: {
-                                if (!modelData.mpuState) {
-                                    modelData.mpuStart();
+                                if (!device.mpuState) {
+                                    device.mpuStart();
                                 } else {
-                                    modelData.mpuStop();
+                                    device.mpuStop();
                                 }
 
                             }
@@ -189,9 +202,9 @@ Window {
                             BorSlider {
                                 id: roleSlider
                                 count: 4
-                                value: modelData.role
+                                value: device.role
                                 onValueChanged: {
-                                    modelData.setRole(value);
+                                    device.setRole(value);
                                 }
                             }
                             Row {
@@ -209,9 +222,9 @@ Window {
                             BorSlider {
                                 id: accelSlider
                                 count: 4
-                                value: modelData.accelRange
+                                value: device.accelRange
                                 onValueChanged: {
-                                    modelData.setAccelRange(value);
+                                    device.setAccelRange(value);
                                 }
                             }
                             Row {
@@ -229,9 +242,9 @@ Window {
                             BorSlider {
                                 id: gyroSlider
                                 count: 4
-                                value: modelData.gyroRange
+                                value: device.gyroRange
                                 onValueChanged: {
-                                    modelData.setGyroRange(value);
+                                    device.setGyroRange(value);
                                 }
                             }
                             Row {
@@ -263,7 +276,7 @@ Window {
                     Row {
                         id: rowInfo
 
-                        property bool visibleState: modelData.connectionState === VecsDevice.StateConnected
+                        property bool visibleState: device.connectionState === VecsDevice.StateConnected
 
                         visible: false
                         opacity: 0
@@ -273,62 +286,51 @@ Window {
 
                         Column {
                             anchors.verticalCenter: parent.verticalCenter
-                            Text { text: "<b>battery</b>: " + modelData.batteryLevel + "%" }
+                            Text { text: "<b>battery</b>: " + device.batteryLevel + "%" }
                         }
 
                         Column {
                             anchors.verticalCenter: parent.verticalCenter
-                            Text { text: "<b>single clicks:</b> " + modelData.singleClickCount }
-                            Text { text: "<b>double clicks:</b> " + modelData.doubleClickCount }
-                            Text { text: "<b>long clicks:</b> " + modelData.longClickCount }
+                            Text { text: "<b>single clicks:</b> " + device.singleClickCount }
+                            Text { text: "<b>double clicks:</b> " + device.doubleClickCount }
+                            Text { text: "<b>long clicks:</b> " + device.longClickCount }
                         }
 
                         Column {
                             anchors.verticalCenter: parent.verticalCenter
-                            Text { text: "<b>MPU Rate:</b> " + modelData.mpuRate + "Hz"}
-                            Text { text: "<b>Gyro Range:</b> ±" + Helper.gyroRangeWrap(modelData.gyroRange) + "°/s" }
-                            Text { text: "<b>Accel Range:</b> ±" + Helper.accelRangeWrap(modelData.accelRange) + "G" }
+                            Text { text: "<b>MPU Rate:</b> " + device.mpuRate + "Hz" + (device.moving ? "" : " (rest)")}
+                            Text { text: "<b>Gyro Range:</b> ±" + Helper.gyroRangeWrap(device.gyroRange) + "°/s" }
+                            Text { text: "<b>Accel Range:</b> ±" + Helper.accelRangeWrap(device.accelRange) + "G" }
+                            Text { text: "<b>Latency:</b> " + device.notificationLatency + "/" + device.notificationLatencyMax + "µs" }
+                            Text { text: "<b>Loss:</b> " + (device.lossRate * 100).toFixed(1) + "% (max gap " + device.longestGap + ")" }
+                            Text { text: "<b>Stream stalled</b> (" + device.stallCount + ")"; color: "red"; visible: device.stalled }
+                            Text { text: "<b>Interval:</b> " + device.connectionInterval.toFixed(2) + "ms, latency " + device.connectionLatency }
+                            Text { text: "<b>Link:</b> " + device.metrics.notificationRate.toFixed(0) + "/s, jitter " + device.metrics.jitter.toFixed(1) + "ms, GATT " + device.metrics.gattRoundTrip.toFixed(1) + "ms" }
+                            Text { text: "<b>Tremor:</b> " + device.features.tremorFrequency[4].toFixed(1) + "Hz, RMS " + device.features.rms[4].toFixed(1) + "°/s" }
                         }
 
                         Text {
                             anchors.verticalCenter: parent.verticalCenter
                             text: "<b>Accel:</b>"
                         }
-
-                        BorGauge {
-                            maxAbsValue: 32768
-                            height: 50
-                            value: modelData.accelX
-                        }
-                        BorGauge {
-                            maxAbsValue: 32768
-                            height: 50
-                            value: modelData.accelY
-                        }
-                        BorGauge {
-                            maxAbsValue: 32768
+                        VecsWaveform {
+                            width: 300
                             height: 50
-                            value: modelData.accelZ
+                            device: deviceDelegate.vecs
+                            channels: 0x07
+                            points: 2 * deviceDelegate.vecs.targetRate
                         }
 
                         Text {
                             anchors.verticalCenter: parent.verticalCenter
                             text: "<b>Gyro:</b>"
                         }
-                        BorGauge {
-                            maxAbsValue: 32768
-                            height: 50
-                            value: modelData.gyroX
-                        }
-                        BorGauge {
-                            maxAbsValue: 32768
-                            height: 50
-                            value: modelData.gyroY
-                        }
-                        BorGauge {
-                            maxAbsValue: 32768
+                        VecsWaveform {
+                            width: 300
                             height: 50
-                            value: modelData.gyroZ
+                            device: deviceDelegate.vecs
+                            channels: 0x38
+                            points: 2 * deviceDelegate.vecs.targetRate
                         }
 
                         onOpacityChanged: {
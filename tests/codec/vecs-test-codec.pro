@@ -0,0 +1,13 @@
+# Сжатые блоки отсчетов (VecsSampleCodec): распаковка в точности повторяет исходные отсчеты
+
+TEMPLATE = app
+TARGET = vecs-test-codec
+
+QT += testlib
+QT -= gui
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+include(../../vecs-core.pri)
+
+SOURCES += vecscodectest.cpp
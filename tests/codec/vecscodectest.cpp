@@ -0,0 +1,229 @@
+#include <QtTest>
+#include <limits>
+#include <random>
+#include "vecssamplecodec.h"
+
+typedef QVector<VecsSample> VecsSamples;
+
+// Отсчеты MPU при 200 Гц: интервал 5 мс с дрожанием времени приема, медленно меняющиеся оси
+static VecsSamples mpuSamples(int count, quint16 firstIndex, quint32 seed)
+{
+    std::mt19937 random(seed);
+    VecsSamples samples(count);
+    for (int i = 0; i < count; ++i) {
+        VecsSample &s = samples[i];
+        s.timestamp = Q_INT64_C(1000000000) + qint64(i) * 5000000 + qint64(random() % 300000);
+        s.packetIndex = quint16(firstIndex + i);
+        s.flags = VecsSample::FlagNone;
+        for (int a = 0; a < 3; ++a) {
+            s.accel[a] = qint16((a == 2 ? -16384 : 0) + int(random() % 400) - 200);
+            s.gyro[a] = qint16(int(random() % 100) - 50);
+        }
+    }
+    return samples;
+}
+
+// Все поля случайны во всем диапазоне: разности любой ширины, время по 64 бита
+static VecsSamples randomSamples(int count, quint32 seed)
+{
+    std::mt19937_64 random(seed);
+    VecsSamples samples(count);
+    for (VecsSample &s : samples) {
+        s.timestamp = qint64(random());
+        s.packetIndex = quint16(random());
+        s.flags = quint16(random());
+        for (int a = 0; a < 3; ++a) {
+            s.accel[a] = qint16(random());
+            s.gyro[a] = qint16(random());
+        }
+    }
+    return samples;
+}
+
+// Соседние отсчеты различаются на максимальную по модулю величину во всех столбцах
+static VecsSamples extremeSamples(int count)
+{
+    VecsSamples samples(count);
+    for (int i = 0; i < count; ++i) {
+        VecsSample &s = samples[i];
+        const bool odd = i & 1;
+        s.timestamp = odd ? std::numeric_limits<qint64>::max() : std::numeric_limits<qint64>::min();
+        s.packetIndex = odd ? 0x8000 : 0x0000;
+        s.flags = odd ? 0xffff : 0x0000;
+        for (int a = 0; a < 3; ++a) {
+            s.accel[a] = odd ? std::numeric_limits<qint16>::max() : std::numeric_limits<qint16>::min();
+            s.gyro[a] = odd ? std::numeric_limits<qint16>::min() : std::numeric_limits<qint16>::max();
+        }
+    }
+    return samples;
+}
+
+static QByteArray encode(const VecsSamples &samples, int accelRange = 0, int gyroRange = 0)
+{
+    QByteArray block(VecsSampleCodec::maxEncodedSize(samples.size()), 0);
+    const int size = VecsSampleCodec::encode(samples.constData(), samples.size(), accelRange, gyroRange,
+                                             reinterpret_cast<uchar *>(block.data()));
+    block.resize(size);
+    return block;
+}
+
+static const uchar *bytes(const QByteArray &block)
+{
+    return reinterpret_cast<const uchar *>(block.constData());
+}
+
+class VecsCodecTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // Распаковка повторяет все поля всех отсчетов
+    void roundTrip_data();
+    void roundTrip();
+    // Блок, обрезанный на любом байте, не распаковывается
+    void truncated_data();
+    void truncated();
+    // Заголовок с недопустимыми значениями не распаковывается
+    void corrupted_data();
+    void corrupted();
+};
+
+void VecsCodecTest::roundTrip_data()
+{
+    QTest::addColumn<VecsSamples>("samples");
+
+    QTest::newRow("count 1") << mpuSamples(1, 42, 1);
+    QTest::newRow("count 1, extreme") << extremeSamples(1);
+    QTest::newRow("count 2") << mpuSamples(2, 0, 2);
+    QTest::newRow("count 9") << mpuSamples(9, 0, 3);
+    QTest::newRow("BlockSamples") << mpuSamples(VecsSampleCodec::BlockSamples, 0, 4);
+    QTest::newRow("BlockSamples + 1") << mpuSamples(VecsSampleCodec::BlockSamples + 1, 0, 5);
+    QTest::newRow("MaxSamples") << mpuSamples(VecsSampleCodec::MaxSamples, 0, 6);
+
+    // packetIndex переходит через 0xffff: столбец без потерь остается нулевой ширины
+    QTest::newRow("packetIndex wrap") << mpuSamples(VecsSampleCodec::BlockSamples, 0xff80, 7);
+    VecsSamples lost = mpuSamples(VecsSampleCodec::BlockSamples, 0xffc0, 8);
+    for (int i = 0; i < lost.size(); ++i)
+        lost[i].packetIndex = quint16(0xffc0 + i * 3);
+    QTest::newRow("packetIndex wrap with loss") << lost;
+    VecsSamples back = mpuSamples(4, 0, 9);
+    back[0].packetIndex = 0x0002;
+    back[1].packetIndex = 0xfffe;
+    back[2].packetIndex = 0x0001;
+    back[3].packetIndex = 0xffff;
+    QTest::newRow("packetIndex wrap backwards") << back;
+
+    QTest::newRow("maximum deltas") << extremeSamples(VecsSampleCodec::BlockSamples);
+    QTest::newRow("maximum deltas, odd count") << extremeSamples(17);
+
+    // Граница упаковки времени: разности до 56 бит упаковываются, шире - по 64 бита
+    const qint64 limit = Q_INT64_C(1) << 55;
+    const qint64 steps[] = { limit - 1, -limit, limit, -limit - 1 };
+    for (qint64 step : steps) {
+        VecsSamples samples = mpuSamples(33, 0, 10);
+        for (int i = 0; i < samples.size(); ++i)
+            samples[i].timestamp = (i & 1) ? step : 0;
+        QTest::newRow(qPrintable(QString("timestamp delta %1").arg(step))) << samples;
+    }
+
+    for (quint32 seed = 1; seed <= 16; ++seed) {
+        const int count = 1 + int(std::mt19937(seed)() % (2 * VecsSampleCodec::BlockSamples));
+        QTest::newRow(qPrintable(QString("random %1 (%2)").arg(seed).arg(count))) << randomSamples(count, seed);
+    }
+}
+
+void VecsCodecTest::roundTrip()
+{
+    QFETCH(VecsSamples, samples);
+
+    const int count = samples.size();
+    const QByteArray block = encode(samples, 2, 3);
+    QVERIFY(block.size() > 0);
+    QVERIFY(block.size() <= VecsSampleCodec::maxEncodedSize(count));
+
+    // Блок точного размера: чтение за его концом заметно под ASan
+    QCOMPARE(VecsSampleCodec::blockSize(bytes(block), block.size()), block.size());
+    QCOMPARE(VecsSampleCodec::sampleCount(bytes(block), block.size()), count);
+    QCOMPARE(VecsSampleCodec::accelRange(bytes(block)), 2);
+    QCOMPARE(VecsSampleCodec::gyroRange(bytes(block)), 3);
+
+    VecsSamples decoded(count);
+    QCOMPARE(VecsSampleCodec::decode(bytes(block), block.size(), decoded.data()), block.size());
+
+    for (int i = 0; i < count; ++i) {
+        const VecsSample &expected = samples.at(i);
+        const VecsSample &actual = decoded.at(i);
+        const QByteArray where = QByteArray::number(i);
+        QVERIFY2(actual.timestamp == expected.timestamp, where.constData());
+        QVERIFY2(actual.packetIndex == expected.packetIndex, where.constData());
+        QVERIFY2(actual.flags == expected.flags, where.constData());
+        for (int a = 0; a < 3; ++a) {
+            QVERIFY2(actual.accel[a] == expected.accel[a], where.constData());
+            QVERIFY2(actual.gyro[a] == expected.gyro[a], where.constData());
+        }
+    }
+}
+
+void VecsCodecTest::truncated_data()
+{
+    QTest::addColumn<VecsSamples>("samples");
+
+    QTest::newRow("count 1") << mpuSamples(1, 0, 1);
+    QTest::newRow("BlockSamples") << mpuSamples(VecsSampleCodec::BlockSamples, 0, 2);
+    QTest::newRow("maximum deltas") << extremeSamples(33);
+    QTest::newRow("random") << randomSamples(100, 3);
+}
+
+void VecsCodecTest::truncated()
+{
+    QFETCH(VecsSamples, samples);
+
+    const QByteArray block = encode(samples);
+    VecsSamples decoded(samples.size());
+
+    for (int size = 0; size < block.size(); ++size) {
+        const QByteArray part = block.left(size);
+        const QByteArray where = QByteArray::number(size);
+        QVERIFY2(VecsSampleCodec::blockSize(bytes(part), part.size()) == -1, where.constData());
+        QVERIFY2(VecsSampleCodec::sampleCount(bytes(part), part.size()) == -1, where.constData());
+        QVERIFY2(VecsSampleCodec::decode(bytes(part), part.size(), decoded.data()) == -1, where.constData());
+    }
+
+    // Данные после блока (следующий блок) не мешают распаковке
+    const QByteArray longer = block + QByteArray(64, '\xff');
+    QCOMPARE(VecsSampleCodec::decode(bytes(longer), longer.size(), decoded.data()), block.size());
+    QCOMPARE(decoded.last().timestamp, samples.last().timestamp);
+}
+
+void VecsCodecTest::corrupted_data()
+{
+    QTest::addColumn<int>("offset");
+    QTest::addColumn<int>("value");
+
+    QTest::newRow("count 0") << 0 << 0;
+    QTest::newRow("version") << 37 << VecsSampleCodec::Version + 1;
+    QTest::newRow("timestamp width 57") << 28 << 57;
+    QTest::newRow("timestamp width 65") << 28 << 65;
+    QTest::newRow("packetIndex width 17") << 29 << 17;
+    QTest::newRow("gyro width 255") << 36 << 255;
+}
+
+void VecsCodecTest::corrupted()
+{
+    QFETCH(int, offset);
+    QFETCH(int, value);
+
+    QByteArray block = encode(mpuSamples(VecsSampleCodec::BlockSamples, 0, 1));
+    block[offset] = char(value);
+    // count занимает два байта
+    if (offset == 0)
+        block[1] = 0;
+
+    VecsSamples decoded(VecsSampleCodec::BlockSamples);
+    QCOMPARE(VecsSampleCodec::blockSize(bytes(block), block.size()), -1);
+    QCOMPARE(VecsSampleCodec::decode(bytes(block), block.size(), decoded.data()), -1);
+}
+
+QTEST_GUILESS_MAIN(VecsCodecTest)
+
+#include "vecscodectest.moc"
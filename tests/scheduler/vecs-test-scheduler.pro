@@ -0,0 +1,13 @@
+# Колесо таймеров периодических задач (VecsScheduler)
+
+TEMPLATE = app
+TARGET = vecs-test-scheduler
+
+QT += testlib
+QT -= gui
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+include(../../vecs-core.pri)
+
+SOURCES += vecsschedulertest.cpp
@@ -0,0 +1,128 @@
+#include <QtTest>
+#include "vecsscheduler.h"
+
+// Шаги колеса вызываются напрямую: тест не зависит от таймера и цикла событий
+static void advance(VecsScheduler *scheduler, int ticks)
+{
+    for (int i = 0; i < ticks; ++i)
+        QMetaObject::invokeMethod(scheduler, "advance");
+}
+
+class VecsSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void periodic();
+    // setPeriod() из другой задачи того же шага не выполняет задачу дважды за период
+    void setPeriodFromJob();
+    void setPeriodOwn();
+    void removeFromJob();
+    void maxJobsPerTick();
+    void ownerDestroyed();
+};
+
+void VecsSchedulerTest::periodic()
+{
+    VecsScheduler scheduler;
+    scheduler.setTick(10);
+
+    int runs = 0;
+    scheduler.addJob(nullptr, 30, [&]() { runs++; });
+
+    // Шаги 1, 4, 7, 10
+    advance(&scheduler, 10);
+    QCOMPARE(runs, 4);
+}
+
+void VecsSchedulerTest::setPeriodFromJob()
+{
+    VecsScheduler scheduler;
+    scheduler.setTick(10);
+
+    // Обе задачи в одной ячейке: a выполняется раньше b на том же шаге
+    int a = 0, b = 0;
+    int idB = 0;
+    scheduler.addJob(nullptr, 10, [&]() {
+        if (a++ == 0)
+            scheduler.setPeriod(idB, 50);
+    });
+    idB = scheduler.addJob(nullptr, 10, [&]() { b++; });
+
+    // b: шаг 1 (срок уже наступил), затем 6 и 11
+    advance(&scheduler, 11);
+    QCOMPARE(a, 11);
+    QCOMPARE(b, 3);
+    QCOMPARE(scheduler.jobCount(), 2);
+}
+
+void VecsSchedulerTest::setPeriodOwn()
+{
+    VecsScheduler scheduler;
+    scheduler.setTick(10);
+
+    int runs = 0;
+    int id = 0;
+    id = scheduler.addJob(nullptr, 10, [&]() {
+        if (runs++ == 0)
+            scheduler.setPeriod(id, 40);
+    });
+
+    // Шаги 1, 5, 9
+    advance(&scheduler, 10);
+    QCOMPARE(runs, 3);
+}
+
+void VecsSchedulerTest::removeFromJob()
+{
+    VecsScheduler scheduler;
+    scheduler.setTick(10);
+
+    int b = 0;
+    int idB = 0;
+    scheduler.addJob(nullptr, 10, [&]() { scheduler.removeJob(idB); });
+    idB = scheduler.addJob(nullptr, 10, [&]() { b++; });
+
+    advance(&scheduler, 3);
+    QCOMPARE(b, 0);
+    QCOMPARE(scheduler.jobCount(), 1);
+}
+
+void VecsSchedulerTest::maxJobsPerTick()
+{
+    VecsScheduler scheduler;
+    scheduler.setTick(10);
+    scheduler.setMaxJobsPerTick(2);
+
+    int runs[3] = { 0, 0, 0 };
+    for (int i = 0; i < 3; ++i)
+        scheduler.addJob(nullptr, 10, [&runs, i]() { runs[i]++; });
+
+    advance(&scheduler, 1);
+    QCOMPARE(runs[0] + runs[1] + runs[2], 2);
+    QCOMPARE(scheduler.deferredJobs(), quint64(1));
+    QCOMPARE(scheduler.jobCount(), 3);
+
+    advance(&scheduler, 1);
+    QCOMPARE(runs[0] + runs[1] + runs[2], 4);
+}
+
+void VecsSchedulerTest::ownerDestroyed()
+{
+    VecsScheduler scheduler;
+    scheduler.setTick(10);
+
+    int runs = 0;
+    QObject *owner = new QObject;
+    scheduler.addJob(owner, 10, [&]() { runs++; });
+    advance(&scheduler, 1);
+    delete owner;
+    advance(&scheduler, 3);
+
+    QCOMPARE(runs, 1);
+    QCOMPARE(scheduler.jobCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(VecsSchedulerTest)
+
+#include "vecsschedulertest.moc"
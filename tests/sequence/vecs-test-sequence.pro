@@ -0,0 +1,13 @@
+# Учет потерь по счетчику пакетов MPU (VecsSequenceTracker)
+
+TEMPLATE = app
+TARGET = vecs-test-sequence
+
+QT += testlib
+QT -= gui
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+include(../../vecs-core.pri)
+
+SOURCES += vecssequencetest.cpp
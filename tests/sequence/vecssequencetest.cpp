@@ -0,0 +1,230 @@
+#include <QtTest>
+#include "vecssequencetracker.h"
+
+// Подает count пакетов подряд с номера first, возвращает число не принятых в порядке следования
+static int feed(VecsSequenceTracker *tracker, quint16 first, int count)
+{
+    int rejected = 0;
+    for (int i = 0; i < count; ++i) {
+        int gap = -1;
+        if (tracker->track(quint16(first + i), &gap) != VecsSequenceTracker::Accepted || gap != 0)
+            rejected++;
+    }
+    return rejected;
+}
+
+class VecsSequenceTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void inOrder();
+    // Переход счетчика через 0xffff не считается ни пропуском, ни перезапуском
+    void wrap();
+    void wrapGap();
+    void wrapReorder();
+    void gap();
+    void reorder();
+    void duplicate();
+    // Пакет старше окна истории не выдается за дубликат
+    void stale();
+    void staleLimit();
+    // Скачок дальше ResyncThreshold - новый поток, а не потеря
+    void resync();
+    void reset();
+};
+
+void VecsSequenceTest::inOrder()
+{
+    VecsSequenceTracker tracker;
+    QCOMPARE(feed(&tracker, 0, 1000), 0);
+
+    QCOMPARE(tracker.received(), quint64(1000));
+    QCOMPARE(tracker.expected(), quint64(1000));
+    QCOMPARE(tracker.lost(), quint64(0));
+    QCOMPARE(tracker.lossRate(), 0.0);
+    QCOMPARE(tracker.longestGap(), 0);
+}
+
+void VecsSequenceTest::wrap()
+{
+    VecsSequenceTracker tracker;
+    QCOMPARE(feed(&tracker, 0xff00, 0x200), 0);
+
+    QCOMPARE(tracker.received(), quint64(0x200));
+    QCOMPARE(tracker.expected(), quint64(0x200));
+    QCOMPARE(tracker.lost(), quint64(0));
+    QCOMPARE(tracker.duplicates(), quint64(0));
+    QCOMPARE(tracker.stale(), quint64(0));
+}
+
+void VecsSequenceTest::wrapGap()
+{
+    VecsSequenceTracker tracker;
+    int gap = -1;
+    QCOMPARE(tracker.track(0xfffd), VecsSequenceTracker::Accepted);
+    QCOMPARE(tracker.track(0xfffe), VecsSequenceTracker::Accepted);
+    QCOMPARE(tracker.track(0x0002, &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 3);
+
+    QCOMPARE(tracker.received(), quint64(3));
+    QCOMPARE(tracker.expected(), quint64(6));
+    QCOMPARE(tracker.lost(), quint64(3));
+    QCOMPARE(tracker.longestGap(), 3);
+}
+
+void VecsSequenceTest::wrapReorder()
+{
+    VecsSequenceTracker tracker;
+    QCOMPARE(tracker.track(0xfffe), VecsSequenceTracker::Accepted);
+    QCOMPARE(tracker.track(0x0000), VecsSequenceTracker::Accepted);
+    QCOMPARE(tracker.track(0xffff), VecsSequenceTracker::Late);
+    QCOMPARE(tracker.track(0xffff), VecsSequenceTracker::Duplicate);
+    QCOMPARE(tracker.track(0x0001), VecsSequenceTracker::Accepted);
+
+    QCOMPARE(tracker.received(), quint64(4));
+    QCOMPARE(tracker.expected(), quint64(4));
+    QCOMPARE(tracker.lost(), quint64(0));
+    QCOMPARE(tracker.reordered(), quint64(1));
+    QCOMPARE(tracker.duplicates(), quint64(1));
+}
+
+void VecsSequenceTest::gap()
+{
+    VecsSequenceTracker tracker;
+    int gap = -1;
+    QCOMPARE(feed(&tracker, 0, 10), 0);
+    QCOMPARE(tracker.track(15, &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 5);
+    QCOMPARE(tracker.track(17, &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 1);
+    QCOMPARE(tracker.track(18, &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 0);
+
+    QCOMPARE(tracker.received(), quint64(13));
+    QCOMPARE(tracker.expected(), quint64(19));
+    QCOMPARE(tracker.lost(), quint64(6));
+    QCOMPARE(tracker.lossRate(), 6.0 / 19);
+    QCOMPARE(tracker.longestGap(), 5);
+}
+
+void VecsSequenceTest::reorder()
+{
+    VecsSequenceTracker tracker;
+    int gap = -1;
+    QCOMPARE(feed(&tracker, 0, 100), 0);
+    QCOMPARE(tracker.track(102, &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 2);
+    QCOMPARE(tracker.lost(), quint64(2));
+
+    // Опоздавшие пакеты возвращают потерю, gap для них не выдается
+    QCOMPARE(tracker.track(101, &gap), VecsSequenceTracker::Late);
+    QCOMPARE(gap, 0);
+    QCOMPARE(tracker.track(100, &gap), VecsSequenceTracker::Late);
+    QCOMPARE(gap, 0);
+
+    // Самый старый пакет, который еще помещается в окно истории
+    QCOMPARE(feed(&tracker, 103, 70), 0);
+    QCOMPARE(tracker.track(172 - 63), VecsSequenceTracker::Duplicate);
+    QCOMPARE(tracker.track(120), VecsSequenceTracker::Duplicate);
+
+    QCOMPARE(tracker.received(), quint64(173));
+    QCOMPARE(tracker.expected(), quint64(173));
+    QCOMPARE(tracker.lost(), quint64(0));
+    QCOMPARE(tracker.reordered(), quint64(2));
+}
+
+void VecsSequenceTest::duplicate()
+{
+    VecsSequenceTracker tracker;
+    QCOMPARE(feed(&tracker, 0, 10), 0);
+    QCOMPARE(tracker.track(9), VecsSequenceTracker::Duplicate);
+    QCOMPARE(tracker.track(3), VecsSequenceTracker::Duplicate);
+    QCOMPARE(tracker.track(0), VecsSequenceTracker::Duplicate);
+    QCOMPARE(tracker.track(10), VecsSequenceTracker::Accepted);
+
+    QCOMPARE(tracker.received(), quint64(11));
+    QCOMPARE(tracker.expected(), quint64(11));
+    QCOMPARE(tracker.duplicates(), quint64(3));
+    QCOMPARE(tracker.reordered(), quint64(0));
+    QCOMPARE(tracker.stale(), quint64(0));
+}
+
+void VecsSequenceTest::stale()
+{
+    VecsSequenceTracker tracker;
+    QCOMPARE(feed(&tracker, 0, 50), 0);
+    QCOMPARE(tracker.track(51), VecsSequenceTracker::Accepted);
+    QCOMPARE(feed(&tracker, 52, 1000), 0);
+    QCOMPARE(tracker.lost(), quint64(1));
+
+    // Потерянный пакет 50 и уже принятый 40 далеко за окном: оба не дубликаты
+    QCOMPARE(tracker.track(50), VecsSequenceTracker::Stale);
+    QCOMPARE(tracker.track(40), VecsSequenceTracker::Stale);
+    // Последний пакет в окне и первый за ним
+    QCOMPARE(tracker.track(1051 - 63), VecsSequenceTracker::Duplicate);
+    QCOMPARE(tracker.track(1051 - 64), VecsSequenceTracker::Stale);
+
+    QCOMPARE(tracker.stale(), quint64(3));
+    QCOMPARE(tracker.duplicates(), quint64(1));
+    QCOMPARE(tracker.reordered(), quint64(0));
+    // Пакеты за окном не меняют оценку потерь
+    QCOMPARE(tracker.received(), quint64(1051));
+    QCOMPARE(tracker.expected(), quint64(1052));
+    QCOMPARE(tracker.lost(), quint64(1));
+}
+
+void VecsSequenceTest::staleLimit()
+{
+    VecsSequenceTracker tracker;
+    QCOMPARE(feed(&tracker, 0xf000, 0x2000), 0);
+    const quint16 newest = quint16(0xf000 + 0x2000 - 1);
+
+    QCOMPARE(tracker.track(quint16(newest - 4096)), VecsSequenceTracker::Stale);
+    QCOMPARE(tracker.stale(), quint64(1));
+
+    // Дальше порога - перезапуск потока с этого пакета
+    const quint16 restart = quint16(newest - 4097);
+    int gap = -1;
+    QCOMPARE(tracker.track(restart, &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 0);
+    QCOMPARE(tracker.track(quint16(restart + 1), &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 0);
+    QCOMPARE(tracker.stale(), quint64(1));
+    QCOMPARE(tracker.lost(), quint64(0));
+}
+
+void VecsSequenceTest::resync()
+{
+    VecsSequenceTracker tracker;
+    int gap = -1;
+    QCOMPARE(feed(&tracker, 0, 10), 0);
+    QCOMPARE(tracker.track(quint16(10 + 4096), &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 4096);
+    QCOMPARE(tracker.lost(), quint64(4096));
+
+    QCOMPARE(tracker.track(quint16(10 + 4096 + 1 + 4097), &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 0);
+    QCOMPARE(tracker.lost(), quint64(4096));
+    QCOMPARE(tracker.longestGap(), 4096);
+}
+
+void VecsSequenceTest::reset()
+{
+    VecsSequenceTracker tracker;
+    QCOMPARE(feed(&tracker, 0, 10), 0);
+    tracker.reset();
+
+    // Новый поток начинается с любого номера, счетчики сохраняются
+    int gap = -1;
+    QCOMPARE(tracker.track(5, &gap), VecsSequenceTracker::Accepted);
+    QCOMPARE(gap, 0);
+    QCOMPARE(tracker.track(5), VecsSequenceTracker::Duplicate);
+    QCOMPARE(tracker.received(), quint64(11));
+    QCOMPARE(tracker.expected(), quint64(11));
+    QCOMPARE(tracker.duplicates(), quint64(1));
+}
+
+QTEST_GUILESS_MAIN(VecsSequenceTest)
+
+#include "vecssequencetest.moc"
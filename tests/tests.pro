@@ -0,0 +1,7 @@
+# Модульные тесты ядра: qmake && make check
+
+TEMPLATE = subdirs
+
+SUBDIRS += codec \
+    sequence \
+    scheduler
@@ -0,0 +1,87 @@
+# Ядро сбора данных: общее для приложения, бенчмарков (bench/) и тестов (tests/)
+
+QT += bluetooth network
+CONFIG += c++11
+
+# Параметры соединения BLE (QLowEnergyConnectionParameters) появились в Qt 5.7
+lessThan(QT_MAJOR_VERSION, 5)|if(equals(QT_MAJOR_VERSION, 5):lessThan(QT_MINOR_VERSION, 7)) {
+    error("VECS requires Qt 5.7 or newer")
+}
+
+INCLUDEPATH += $$PWD
+
+# shm_open/shm_unlink (vecsshmpublisher.cpp)
+linux: LIBS += -lrt
+
+# Трассировка (vecstrace.h) включается настройкой trace/enabled;
+# CONFIG += vecs_notrace убирает ее из сборки полностью
+vecs_notrace: DEFINES += VECS_NO_TRACE
+
+SOURCES += \
+    $$PWD/vecscontroller.cpp \
+    $$PWD/vecsdevice.cpp \
+    $$PWD/vecssamplering.cpp \
+    $$PWD/vecsbletransport.cpp \
+    $$PWD/vecslatencyprobe.cpp \
+    $$PWD/vecsgattqueue.cpp \
+    $$PWD/vecssamplewindow.cpp \
+    $$PWD/vecssequencetracker.cpp \
+    $$PWD/vecssessionrecorder.cpp \
+    $$PWD/vecssessionreader.cpp \
+    $$PWD/vecssamplecodec.cpp \
+    $$PWD/vecstransport.cpp \
+    $$PWD/vecssimtransport.cpp \
+    $$PWD/vecsreplaytransport.cpp \
+    $$PWD/vecsstreamclock.cpp \
+    $$PWD/vecsstreamaligner.cpp \
+    $$PWD/vecssampleblock.cpp \
+    $$PWD/vecsunits.cpp \
+    $$PWD/vecsfusion.cpp \
+    $$PWD/vecsfft.cpp \
+    $$PWD/vecsfeatures.cpp \
+    $$PWD/vecssessionstarter.cpp \
+    $$PWD/vecsgattcache.cpp \
+    $$PWD/vecsdevicemodel.cpp \
+    $$PWD/vecsstreamserver.cpp \
+    $$PWD/vecsshmpublisher.cpp \
+    $$PWD/vecsactivity.cpp \
+    $$PWD/vecsscheduler.cpp \
+    $$PWD/vecsmetrics.cpp \
+    $$PWD/vecsmetricsexporter.cpp \
+    $$PWD/vecstrace.cpp
+
+HEADERS += \
+    $$PWD/vecscontroller.h \
+    $$PWD/vecsdevice.h \
+    $$PWD/vecssamplering.h \
+    $$PWD/vecsbletransport.h \
+    $$PWD/vecslatencyprobe.h \
+    $$PWD/vecsgattqueue.h \
+    $$PWD/vecssamplewindow.h \
+    $$PWD/vecssequencetracker.h \
+    $$PWD/vecssessionformat.h \
+    $$PWD/vecssamplecodec.h \
+    $$PWD/vecssessionrecorder.h \
+    $$PWD/vecssessionreader.h \
+    $$PWD/vecstransport.h \
+    $$PWD/vecssimtransport.h \
+    $$PWD/vecsreplaytransport.h \
+    $$PWD/vecsstreamclock.h \
+    $$PWD/vecsstreamaligner.h \
+    $$PWD/vecssampleblock.h \
+    $$PWD/vecsunits.h \
+    $$PWD/vecsfusion.h \
+    $$PWD/vecsfft.h \
+    $$PWD/vecsfeatures.h \
+    $$PWD/vecssessionstarter.h \
+    $$PWD/vecsgattcache.h \
+    $$PWD/vecsdevicemodel.h \
+    $$PWD/vecsstreamformat.h \
+    $$PWD/vecsstreamserver.h \
+    $$PWD/vecsshm.h \
+    $$PWD/vecsshmpublisher.h \
+    $$PWD/vecsactivity.h \
+    $$PWD/vecsscheduler.h \
+    $$PWD/vecsmetrics.h \
+    $$PWD/vecsmetricsexporter.h \
+    $$PWD/vecstrace.h
@@ -3,9 +3,12 @@ TEMPLATE = app
 QT += qml quick bluetooth
 CONFIG += c++11
 
+include(vecs-core.pri)
+
 SOURCES += main.cpp \
-    vecscontroller.cpp \
-    vecsdevice.cpp
+    vecswaveform.cpp
+
+HEADERS += vecswaveform.h
 
 RESOURCES += qml.qrc
 
@@ -15,10 +18,6 @@ QML_IMPORT_PATH =
 # Default rules for deployment.
 include(deployment.pri)
 
-HEADERS += \
-    vecscontroller.h \
-    vecsdevice.h
-
 DISTFILES += \
     BorDelayButton.qml \
     BorCheckButton.qml \
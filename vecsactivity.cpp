@@ -0,0 +1,114 @@
+#include "vecsactivity.h"
+#include <cmath>
+
+namespace {
+// Постоянные времени, с: оценка гравитации и сглаживание энергии
+const double GravityTau = 1.0;
+const double EnergyTau = 0.25;
+}
+
+VecsActivityDetector::VecsActivityDetector() :
+    m_gyroThreshold(5.0f),
+    m_accelThreshold(0.03f),
+    m_restDelay(3000000000LL),
+    m_accelScale(1.0f),
+    m_gyroScale(1.0f)
+{
+    reset();
+}
+
+void VecsActivityDetector::reset()
+{
+    // До первых отсчетов датчик считается движущимся: частота не снижается вслепую
+    m_started = false;
+    m_moving = true;
+    m_lastTime = 0;
+    m_quietSince = -1;
+    m_gravity[0] = m_gravity[1] = m_gravity[2] = 0.0f;
+    m_energy = 0.0f;
+}
+
+void VecsActivityDetector::setThresholds(float gyro, float accel)
+{
+    m_gyroThreshold = qMax(gyro, 0.01f);
+    m_accelThreshold = qMax(accel, 0.001f);
+}
+
+void VecsActivityDetector::setRestDelay(int delay)
+{
+    m_restDelay = qint64(qMax(0, delay)) * 1000000;
+}
+
+int VecsActivityDetector::restDelay() const
+{
+    return int(m_restDelay / 1000000);
+}
+
+void VecsActivityDetector::setScales(float accelScale, float gyroScale)
+{
+    m_accelScale = accelScale;
+    m_gyroScale = gyroScale;
+}
+
+bool VecsActivityDetector::addSample(const VecsSample &sample)
+{
+    float accel[3];
+    float gyro = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        accel[i] = sample.accel[i] * m_accelScale;
+        const float g = sample.gyro[i] * m_gyroScale;
+        gyro += g * g;
+    }
+
+    if (!m_started) {
+        for (int i = 0; i < 3; ++i)
+            m_gravity[i] = accel[i];
+        m_lastTime = sample.timestamp;
+        m_started = true;
+        return false;
+    }
+
+    // Коэффициенты сглаживания по фактическому шагу времени
+    const double dt = qBound(0.0, (sample.timestamp - m_lastTime) / 1e9, 1.0);
+    m_lastTime = sample.timestamp;
+    const float gravityAlpha = float(1.0 - std::exp(-dt / GravityTau));
+    const float energyAlpha = float(1.0 - std::exp(-dt / EnergyTau));
+
+    float linear = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        m_gravity[i] += gravityAlpha * (accel[i] - m_gravity[i]);
+        const float a = accel[i] - m_gravity[i];
+        linear += a * a;
+    }
+
+    const float energy = gyro / (m_gyroThreshold * m_gyroThreshold) +
+            linear / (m_accelThreshold * m_accelThreshold);
+    m_energy += energyAlpha * (energy - m_energy);
+
+    if (energy > 1.0f || m_energy > 1.0f) {
+        m_quietSince = -1;
+        if (!m_moving) {
+            m_moving = true;
+            return true;
+        }
+        return false;
+    }
+
+    if (m_quietSince < 0)
+        m_quietSince = sample.timestamp;
+    if (m_moving && sample.timestamp - m_quietSince >= m_restDelay) {
+        m_moving = false;
+        return true;
+    }
+    return false;
+}
+
+bool VecsActivityDetector::isMoving() const
+{
+    return m_moving;
+}
+
+float VecsActivityDetector::energy() const
+{
+    return m_energy;
+}
@@ -0,0 +1,57 @@
+#ifndef VECSACTIVITY_H
+#define VECSACTIVITY_H
+
+#include <QtGlobal>
+#include "vecssamplering.h"
+
+/*
+ * Обнаружение покоя датчика по энергии движения.
+ * Энергия отсчета - сумма квадратов угловой скорости и ускорения без гравитации,
+ * нормированных на пороги покоя (гравитация - медленное экспоненциальное среднее
+ * ускорения). Постоянные времени задаются в секундах и считаются по времени отсчетов,
+ * поэтому поведение не зависит от частоты MPU.
+ *
+ * Движение начинается сразу, как только энергия одного отсчета превысит порог,
+ * так что реакция ограничена периодом отсчетов. Покой наступает, когда сглаженная
+ * энергия держится ниже порога restDelay мс.
+ * Используется только одним потоком.
+ */
+class VecsActivityDetector
+{
+public:
+    VecsActivityDetector();
+
+    void reset();
+
+    // Пороги покоя: угловая скорость, °/s; ускорение без гравитации, g
+    void setThresholds(float gyro, float accel);
+    // Время без движения до перехода в покой, мс
+    void setRestDelay(int delay);
+    int restDelay() const;
+
+    // Цена разряда отсчетов (VecsUnits::accelScale / gyroScale)
+    void setScales(float accelScale, float gyroScale);
+
+    // Возвращает true, если состояние (движение/покой) изменилось
+    bool addSample(const VecsSample &sample);
+
+    bool isMoving() const;
+    // Сглаженная энергия движения; 1 - порог покоя
+    float energy() const;
+
+private:
+    float m_gyroThreshold;
+    float m_accelThreshold;
+    qint64 m_restDelay;
+    float m_accelScale;
+    float m_gyroScale;
+
+    bool m_started;
+    bool m_moving;
+    qint64 m_lastTime;
+    qint64 m_quietSince;
+    float m_gravity[3];
+    float m_energy;
+};
+
+#endif // VECSACTIVITY_H
@@ -0,0 +1,541 @@
+#include "vecsbletransport.h"
+#include "vecsgattcache.h"
+#include "vecstrace.h"
+#include <QDebug>
+#include <QtEndian>
+#include <memory>
+
+VecsBleTransport::VecsBleTransport(const QBluetoothAddress &address, QObject *parent) :
+    VecsTransport(address, parent),
+    m_batteryLevel(-1),
+    m_batteryNotify(false),
+    m_mpuRunning(false),
+    m_normalDisconnect(true),
+    m_reconnections(0),
+    m_resumeMpu(false),
+    m_controller(nullptr),
+    m_stableTimer(nullptr),
+    m_batteryService(nullptr),
+    m_keyService(nullptr),
+    m_mpuService(nullptr),
+    m_gatt(nullptr)
+{
+}
+
+VecsBleTransport::~VecsBleTransport()
+{
+    disconnectFromDevice();
+}
+
+void VecsBleTransport::open()
+{
+    // Контроллер создается в потоке сбора данных, которому принадлежит объект
+    if (m_controller != nullptr)
+        return;
+
+    m_controller = new QLowEnergyController(m_address, this);
+    connect(m_controller, &QLowEnergyController::connected, this, &VecsBleTransport::deviceConnected);
+    connect(m_controller, &QLowEnergyController::disconnected, this, &VecsBleTransport::deviceDisconnected);
+    connect(m_controller, SIGNAL(error(QLowEnergyController::Error)), this, SLOT(controllerError(QLowEnergyController::Error)));
+    connect(m_controller, &QLowEnergyController::serviceDiscovered, this, &VecsBleTransport::serviceFound);
+    connect(m_controller, &QLowEnergyController::discoveryFinished, this, &VecsBleTransport::serviceDiscoveryDone);
+    connect(m_controller, &QLowEnergyController::connectionUpdated, this, &VecsBleTransport::connectionUpdated);
+
+    m_stableTimer = new QTimer(this);
+    m_stableTimer->setSingleShot(true);
+    m_stableTimer->setInterval(StableLinkTime);
+    connect(m_stableTimer, &QTimer::timeout, [=]() {
+        m_reconnections = 0;
+    });
+
+    m_gatt = new VecsGattQueue(this);
+    m_gatt->setCounters(&m_counters);
+    connect(m_gatt, &VecsGattQueue::commandFailed, [=](const QString &description) {
+        qDebug() << "device [" << m_address.toString() << "] GATT command failed:" << description;
+    });
+}
+
+void VecsBleTransport::connectToDevice()
+{
+    // Подключение по запросу пользователя начинает отсчет попыток заново
+    m_reconnections = 0;
+    connectController();
+}
+
+void VecsBleTransport::connectController()
+{
+    open();
+    VECS_TRACE_ASYNC_BEGIN("ble", "connect", m_address.toUInt64(), 0);
+
+    m_controller->connectToDevice();
+    setConnectionState(StateConnecting);
+}
+
+void VecsBleTransport::disconnectFromDevice()
+{
+    if (m_controller == nullptr)
+        return;
+
+    m_normalDisconnect = true;
+    m_resumeMpu = false;
+    m_stableTimer->stop();
+    clearLinkLost();
+    m_batteryNotify = false;
+    m_gatt->clear();
+    m_controller->disconnectFromDevice();
+
+    // Все объекты удаляются при disconnectFromDevice() автоматически
+    m_batteryService = nullptr;
+    m_keyService = nullptr;
+    m_mpuService = nullptr;
+}
+
+void VecsBleTransport::deviceConnected()
+{
+    qDebug() << "device [" << m_address.toString() << "] connected";
+    VECS_TRACE_ASYNC_END("ble", "connect", m_address.toUInt64());
+
+    // Сброс данных для переподключения при обрыве связи
+    m_normalDisconnect = false;
+    m_stableTimer->start();
+
+    emit connected();
+
+    // Запускаем обнаружение сервисов
+    m_cachedServices = VecsGattCache::instance()->services(m_address);
+    VECS_TRACE_ASYNC_BEGIN("ble", "discovery", m_address.toUInt64(), 0);
+    m_controller->discoverServices();
+}
+
+void VecsBleTransport::deviceDisconnected()
+{
+    VECS_TRACE_INSTANT("ble", "disconnected", m_address.toUInt64());
+
+    // Незавершенные команды уже не получат ответа
+    m_gatt->clear();
+    m_stableTimer->stop();
+    m_batteryNotify = false;
+    if (!m_normalDisconnect && m_mpuRunning)
+        m_resumeMpu = true;
+    m_mpuRunning = false;
+    endMpuStream();
+    setConnectionState(StateDisconnected);
+
+    // Объекты сервисов удаляются контроллером при разрыве
+    m_batteryService = nullptr;
+    m_keyService = nullptr;
+    m_mpuService = nullptr;
+
+    if (!m_normalDisconnect) {
+        markLinkLost();
+        if (m_reconnections < m_maxReconnections) {
+            m_reconnections++;
+            const int delay = reconnectDelay(m_reconnections);
+            qDebug() << "recon: " << m_reconnections << " of max: " << m_maxReconnections;
+            qDebug() << "Connection to [" << m_address.toString() << "] lost.. trying to reconnect after" << delay << "ms";
+            QTimer::singleShot(delay, this, SLOT(reconnect()));
+        }
+    } else {
+        qDebug() << "device [" << m_address.toString() << "] disconnected";
+    }
+}
+
+void VecsBleTransport::reconnect()
+{
+    // Пользователь мог отключить устройство, пока шла задержка
+    if (m_normalDisconnect || m_connectionState != StateDisconnected)
+        return;
+
+    markReconnectAttempt();
+    connectController();
+}
+
+void VecsBleTransport::keyRequest(int delay)
+{
+    if (m_connectionState != StateConnected)
+        return;
+
+    writeCharacteristic(m_keyService, QBluetoothUuid((quint16)VecsBleTransport::CharKeyRequest), (quint8)delay);
+}
+
+void VecsBleTransport::mpuStart()
+{
+    if (m_connectionState != StateConnected)
+        return;
+
+    // Останавлиаваем MPU (если перезапуск с новыми параметрами)
+    if (m_mpuRunning)
+        mpuStop();
+
+    beginMpuStream();
+
+    // Команды уходят в очередь друг за другом без ожидания; результат сообщаем по последней
+    std::shared_ptr<bool> failed = std::make_shared<bool>(false);
+    auto check = [=](bool ok, const QByteArray &) {
+        if (!ok)
+            *failed = true;
+    };
+
+    // Пробуждение MPU, настройка частоты передачи данных и запуск
+    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsBleTransport::CharMpuControl), (quint8)m_mpuRate, check);
+
+    // Задаем диапазоны измерений гироскопа и акселерометра
+    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsBleTransport::CharAccelRange), (quint8)m_accelRange, check);
+    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsBleTransport::CharGyroRange), (quint8)m_gyroRange, check);
+
+    // Включение приема данных от MPU
+    enableNotifications(m_mpuService, QBluetoothUuid((quint16)VecsBleTransport::CharMpuData), true,
+                        [=](bool ok, const QByteArray &) {
+        m_mpuRunning = ok && !*failed;
+        if (!m_mpuRunning)
+            endMpuStream();
+        emit mpuStateChanged(m_mpuRunning);
+    });
+}
+
+void VecsBleTransport::mpuStop()
+{
+    if (m_connectionState != StateConnected)
+        return;
+
+    m_mpuRunning = false;
+    endMpuStream();
+
+    // Отключаем отправку данных
+    enableNotifications(m_mpuService, QBluetoothUuid((quint16)VecsBleTransport::CharMpuData), false);
+    // Останавливаем MPU
+    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsBleTransport::CharMpuControl), 0);
+
+    emit mpuStateChanged(false);
+}
+
+void VecsBleTransport::setMpuRate(int rate)
+{
+    if (rate == m_mpuRate)
+        return;
+
+    VecsTransport::setMpuRate(rate);
+    if (m_connectionState != StateConnected || !m_mpuRunning)
+        return;
+
+    // Повторная запись частоты в работающий MPU меняет период отправки, не отключая
+    // уведомления и не сбрасывая счетчик пакетов. Пакеты с новой частотой могут прийти
+    // на интервал соединения раньше ответа, поэтому отметка в потоке может запоздать на них
+    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsBleTransport::CharMpuControl), (quint8)rate,
+                        [=](bool ok, const QByteArray &) {
+        if (ok && m_mpuRunning)
+            markRateChange();
+    });
+}
+
+void VecsBleTransport::refreshBattery()
+{
+    if (m_batteryNotify || m_batteryService == nullptr)
+        return;
+    if (m_batteryService->state() != QLowEnergyService::ServiceDiscovered)
+        return;
+
+    m_gatt->read(m_batteryService, QBluetoothUuid(QBluetoothUuid::BatteryLevel));
+}
+
+void VecsBleTransport::setConnectionParameters(double minInterval, double maxInterval, int latency, int supervisionTimeout)
+{
+    VecsTransport::setConnectionParameters(minInterval, maxInterval, latency, supervisionTimeout);
+    if (m_connectionState == StateConnected && servicesReady())
+        requestConnectionParameters();
+}
+
+bool VecsBleTransport::servicesReady() const
+{
+    for (QLowEnergyService *service : { m_batteryService, m_keyService, m_mpuService }) {
+        if (service == nullptr || service->state() != QLowEnergyService::ServiceDiscovered)
+            return false;
+    }
+    return true;
+}
+
+void VecsBleTransport::requestConnectionParameters()
+{
+    // Запрос отправляется после обнаружения деталей всех сервисов: длинный интервал
+    // кнопочного датчика иначе замедлил бы обход характеристик
+    if (m_controller == nullptr || m_connMinInterval <= 0)
+        return;
+
+    QLowEnergyConnectionParameters parameters;
+    parameters.setIntervalRange(m_connMinInterval, m_connMaxInterval);
+    parameters.setLatency(m_connLatency);
+    parameters.setSupervisionTimeout(m_connTimeout);
+    m_controller->requestConnectionUpdate(parameters);
+}
+
+void VecsBleTransport::connectionUpdated(const QLowEnergyConnectionParameters &parameters)
+{
+    // Согласованный интервал один: минимум и максимум совпадают
+    emit connectionParametersChanged(parameters.minimumInterval(), parameters.latency(), parameters.supervisionTimeout());
+}
+
+void VecsBleTransport::controllerError(QLowEnergyController::Error error)
+{
+    qDebug() << "device controller error: " << error;
+    VECS_TRACE_INSTANT("ble", "controllerError", error);
+
+    // Неудачная попытка подключения не приводит к сигналу disconnected
+    if (m_connectionState == StateConnecting && m_controller->state() == QLowEnergyController::UnconnectedState) {
+        setConnectionState(StateDisconnected);
+
+        // Неудачное переподключение повторяется с увеличенной задержкой
+        if (!m_normalDisconnect && m_reconnections < m_maxReconnections) {
+            m_reconnections++;
+            QTimer::singleShot(reconnectDelay(m_reconnections), this, SLOT(reconnect()));
+        }
+    }
+}
+
+QLowEnergyService **VecsBleTransport::serviceSlot(const QBluetoothUuid &uuid)
+{
+    if (uuid == QBluetoothUuid(QBluetoothUuid::BatteryService))
+        return &m_batteryService;
+    if (uuid == QBluetoothUuid((quint16)VecsBleTransport::KeyService))
+        return &m_keyService;
+    if (uuid == QBluetoothUuid((quint16)VecsBleTransport::MpuService))
+        return &m_mpuService;
+    return nullptr;
+}
+
+void VecsBleTransport::cacheServiceLayout(QLowEnergyService *service)
+{
+    QList<QBluetoothUuid> characteristics;
+    for (const auto& c : service->characteristics())
+        characteristics.append(c.uuid());
+
+    // Если структура не совпала с кэшем, устройство изменилось: кэш заполняется заново
+    const QList<QBluetoothUuid> cached = VecsGattCache::instance()->characteristics(m_address, service->serviceUuid());
+    if (!cached.isEmpty() && cached != characteristics) {
+        qDebug() << "device [" << m_address.toString() << "] GATT layout changed, cache invalidated";
+        VecsGattCache::instance()->invalidate(m_address);
+    }
+
+    VecsGattCache::instance()->store(m_address, service->serviceUuid(), characteristics);
+}
+
+QLowEnergyService *VecsBleTransport::addService(const QBluetoothUuid &uuid)
+{
+    QLowEnergyService *service = m_controller->createServiceObject(uuid, this);
+    if (service == nullptr) {
+        qDebug() << "error: " << QString("0x%1").arg(uuid.toUInt16(), 4, 16, QLatin1Char('0')) << "service not found on the device";
+        return nullptr;
+    }
+
+    connect(service, &QLowEnergyService::stateChanged, this, &VecsBleTransport::serviceStateChanged);
+    connect(service, &QLowEnergyService::characteristicRead, this, &VecsBleTransport::characteristicRead);
+    connect(service, &QLowEnergyService::characteristicChanged, this, &VecsBleTransport::characteristicNotification);
+    connect(service, &QLowEnergyService::characteristicWritten, this, &VecsBleTransport::characteristicWritten);
+    connect(service, static_cast<void(QLowEnergyService::*)(QLowEnergyService::ServiceError)>(&QLowEnergyService::error),
+          [=](QLowEnergyService::ServiceError newError) {
+        qDebug() << "service error: " << newError;
+    });
+    m_gatt->attach(service);
+    service->discoverDetails();
+
+    return service;
+}
+
+bool VecsBleTransport::enableNotifications(QLowEnergyService *service, const QBluetoothUuid &uuid, bool enable,
+                                           const VecsGattQueue::Callback &callback)
+{
+    if (service == nullptr)
+        return false;
+
+    // Включаем уведомления по этой характеристике через дескриптор настройки
+    m_gatt->writeDescriptor(service, uuid, QByteArray::fromHex(enable ? "0100" : "0000"), callback);
+    return true;
+}
+
+bool VecsBleTransport::writeCharacteristic(QLowEnergyService *service, const QBluetoothUuid &uuid, quint8 value,
+                                           const VecsGattQueue::Callback &callback)
+{
+    if (service == nullptr)
+        return false;
+
+    m_gatt->write(service, uuid, QByteArray(1, (char)value), callback);
+    return true;
+}
+
+bool VecsBleTransport::decodeMpuData(const QByteArray &data, VecsSample *sample)
+{
+    // Формат пакета (big endian): accelX, accelY, accelZ, packetIndex, gyroX, gyroY, gyroZ
+    if (data.size() < 14)
+        return false;
+
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+
+    sample->flags = VecsSample::FlagNone;
+    sample->accel[0] = qFromBigEndian<qint16>(p);
+    sample->accel[1] = qFromBigEndian<qint16>(p + 2);
+    sample->accel[2] = qFromBigEndian<qint16>(p + 4);
+    sample->packetIndex = qFromBigEndian<quint16>(p + 6);
+    sample->gyro[0] = qFromBigEndian<qint16>(p + 8);
+    sample->gyro[1] = qFromBigEndian<qint16>(p + 10);
+    sample->gyro[2] = qFromBigEndian<qint16>(p + 12);
+
+    return true;
+}
+
+void VecsBleTransport::parseMpuData(const QByteArray &data)
+{
+    VecsSample s;
+    s.timestamp = vecsTimestamp();
+    if (decodeMpuData(data, &s))
+        pushSample(s);
+}
+
+void VecsBleTransport::serviceFound(const QBluetoothUuid &uuid)
+{
+    // Сервис уже известен по кэшу: запрашиваем детали, не дожидаясь конца обхода
+    if (!m_cachedServices.contains(uuid))
+        return;
+
+    QLowEnergyService **slot = serviceSlot(uuid);
+    if (slot == nullptr || *slot != nullptr)
+        return;
+
+    *slot = addService(uuid);
+
+    // Все нужные сервисы найдены - устройство готово раньше окончания обхода
+    if (m_batteryService != nullptr && m_keyService != nullptr && m_mpuService != nullptr)
+        setConnectionState(StateConnected);
+}
+
+void VecsBleTransport::serviceDiscoveryDone()
+{
+    VECS_TRACE_ASYNC_END("ble", "discovery", m_address.toUInt64());
+
+    // Детали сервисов запрашиваются сразу для всех; сервис MPU первым,
+    // так как от него зависит время до первого отсчета
+    if (m_mpuService == nullptr)
+        m_mpuService = addService(QBluetoothUuid((quint16)VecsBleTransport::MpuService));
+    if (m_keyService == nullptr)
+        m_keyService = addService(QBluetoothUuid((quint16)VecsBleTransport::KeyService));
+    if (m_batteryService == nullptr)
+        m_batteryService = addService(QBluetoothUuid::BatteryService);
+
+    // Сообщаем об изменении состояния после окончания обнаружения сервисов
+    setConnectionState(StateConnected);
+}
+
+void VecsBleTransport::serviceStateChanged(QLowEnergyService::ServiceState state)
+{
+    // Игнорируем все состояния кроме ServiceDiscovered
+    if (state != QLowEnergyService::ServiceDiscovered)
+        return;
+
+    // Распознаем отправителя сигнала
+    QLowEnergyService *service = qobject_cast<QLowEnergyService *>(sender());
+    if (!service)
+        return;
+
+    VECS_TRACE_SCOPE("ble", "serviceStateChanged", service->serviceUuid().toUInt16());
+    cacheServiceLayout(service);
+
+    if (service == m_batteryService) {
+        const QLowEnergyCharacteristic batteryLevel = service->characteristic(QBluetoothUuid::BatteryLevel);
+        if (batteryLevel.isValid()) {
+            // Обновляем значение заряда
+            m_batteryLevel = batteryLevel.value().at(0);
+            emit batteryLevelChanged(m_batteryLevel);
+
+            // Если характеристика поддерживает уведомления, опрос по расписанию не нужен
+            if (batteryLevel.properties() & QLowEnergyCharacteristic::Notify) {
+                enableNotifications(service, QBluetoothUuid(QBluetoothUuid::BatteryLevel), true,
+                                    [=](bool ok, const QByteArray &) {
+                    m_batteryNotify = ok;
+                });
+            }
+        } else {
+            qDebug() << "error: BatteryLevel characteristic not found";
+        }
+    } else if (service == m_keyService) {
+        // Включаем уведомления по характеристике KeyPressState
+        enableNotifications(service, QBluetoothUuid((quint16)VecsBleTransport::CharKeyPressState), true);
+    } else if (service == m_mpuService) {
+        // Автоматически запускаем прием данных для ролей пациента (запуск заново настраивает MPU),
+        // для остальных останавливаем работу MPU если был запущен до этого
+        // После обрыва связи MPU запускается снова, если работал до него
+        if (m_autoStart || m_resumeMpu)
+            mpuStart();
+        else
+            mpuStop();
+        m_resumeMpu = false;
+
+/* FIXME: Убрано, т.к. если пользователь настроил параметры до подключения,
+ * то при подключении они внезапно меняются на те, которые остались на приборе
+ * в прошлой сессии
+ *
+        // Характеристика "Диапазон аксеелерометра"
+        const QLowEnergyCharacteristic accelRange = service->characteristic(QBluetoothUuid((quint16)VecsBleTransport::CharAccelRange));
+        if (accelRange.isValid()) {
+            m_accelRange = (VecsDevice::AccelRange)accelRange.value().at(0);
+            emit accelRangeChanged();
+        } else {
+            qDebug() << "error: AccelRange characteristic not found";
+        }
+
+        // Характеристика "Диапазон гироскопа"
+        const QLowEnergyCharacteristic gyroRange = service->characteristic(QBluetoothUuid((quint16)VecsBleTransport::CharGyroRange));
+        if (gyroRange.isValid()) {
+            m_gyroRange = (VecsDevice::GyroRange)gyroRange.value().at(0);
+            emit gyroRangeChanged();
+        } else {
+            qDebug() << "error: GyroRange characteristic not found";
+        }
+*/
+    }
+
+    if (servicesReady())
+        requestConnectionParameters();
+}
+
+void VecsBleTransport::characteristicNotification(const QLowEnergyCharacteristic &c, const QByteArray &v)
+{
+    m_counters.addNotification(v.size(), vecsTimestamp());
+    VECS_TRACE_INSTANT("ble", "notification", c.uuid().toUInt16());
+
+    switch (c.uuid().toUInt16()) {
+    case VecsBleTransport::CharKeyPressState:
+        emit keyPressed(v.at(0));
+        break;
+    case VecsBleTransport::CharMpuData:
+        parseMpuData(v);
+        break;
+    case QBluetoothUuid::BatteryLevel:
+        updateBatteryLevel(v);
+        break;
+    }
+}
+
+void VecsBleTransport::characteristicRead(const QLowEnergyCharacteristic &c, const QByteArray &v)
+{
+    switch (c.uuid().toUInt16()) {
+        case QBluetoothUuid::BatteryLevel:
+            updateBatteryLevel(v);
+            break;
+    }
+}
+
+void VecsBleTransport::updateBatteryLevel(const QByteArray &value)
+{
+    if (!value.isEmpty() && value.at(0) != m_batteryLevel) {
+        m_batteryLevel = value.at(0);
+        emit batteryLevelChanged(m_batteryLevel);
+    }
+}
+
+void VecsBleTransport::characteristicWritten(const QLowEnergyCharacteristic &c, const QByteArray &v)
+{
+    Q_UNUSED(v)
+
+    qDebug() <<  QString("[%1] written %2 (uuid: 0x%3)")
+                 .arg(m_address.toString())
+                 .arg(c.name())
+                 .arg(c.uuid().toUInt16(), 4, 16, QLatin1Char('0'));
+}
@@ -0,0 +1,107 @@
+#ifndef VECSBLETRANSPORT_H
+#define VECSBLETRANSPORT_H
+
+#include <QLowEnergyController>
+#include <QLowEnergyConnectionParameters>
+#include <QLowEnergyService>
+#include <QTimer>
+#include "vecstransport.h"
+#include "vecsgattqueue.h"
+
+/*
+ * BLE-соединение с одним датчиком: владеет QLowEnergyController и сервисами
+ * и декодирует уведомления характеристики MPU.
+ */
+class VecsBleTransport : public VecsTransport
+{
+    Q_OBJECT
+
+public:
+    VecsBleTransport(const QBluetoothAddress &address, QObject *parent = 0);
+    ~VecsBleTransport();
+
+    // Декодирует уведомление характеристики MPU (без метки времени); false, если пакет короткий
+    static bool decodeMpuData(const QByteArray &data, VecsSample *sample);
+
+public slots:
+    void open() override;
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+
+    void keyRequest(int delay) override;
+    void mpuStart() override;
+    void mpuStop() override;
+    void setMpuRate(int rate) override;
+
+    void refreshBattery() override;
+    void setConnectionParameters(double minInterval, double maxInterval, int latency, int supervisionTimeout) override;
+
+private slots:
+    void deviceConnected();
+    void deviceDisconnected();
+    void serviceFound(const QBluetoothUuid &uuid);
+    void serviceDiscoveryDone();
+    void controllerError(QLowEnergyController::Error error);
+    void connectionUpdated(const QLowEnergyConnectionParameters &parameters);
+
+    void reconnect();
+
+    void serviceStateChanged(QLowEnergyService::ServiceState state);
+    void characteristicNotification(const QLowEnergyCharacteristic &c, const QByteArray &v);
+    void characteristicRead(const QLowEnergyCharacteristic &c, const QByteArray &v);
+    void characteristicWritten(const QLowEnergyCharacteristic &c, const QByteArray &v);
+
+private:
+    void connectController();
+    QLowEnergyService *addService(const QBluetoothUuid &uuid);
+    QLowEnergyService **serviceSlot(const QBluetoothUuid &uuid);
+    void cacheServiceLayout(QLowEnergyService *service);
+    bool servicesReady() const;
+    void requestConnectionParameters();
+    bool enableNotifications(QLowEnergyService *service, const QBluetoothUuid &uuid, bool enable,
+                             const VecsGattQueue::Callback &callback = VecsGattQueue::Callback());
+    bool writeCharacteristic(QLowEnergyService *service, const QBluetoothUuid &uuid, quint8 value,
+                             const VecsGattQueue::Callback &callback = VecsGattQueue::Callback());
+    void parseMpuData(const QByteArray &data);
+    void updateBatteryLevel(const QByteArray &value);
+
+private:
+    // UUID наших проприетарных сервисов и характеристик, которые не входят в список стандартных сервисов Bluetooth
+    enum ServiceUuid {
+        // Сервис кнопки
+        KeyService          = 0xffe0,
+        CharKeyPressState   = 0xffe1,
+        CharKeyRequest      = 0xffe2,
+        // Сервис MPU (Motion Processor Unit)
+        MpuService          = 0xfff0,
+        CharAccelRange      = 0xfff1,
+        CharGyroRange       = 0xfff2,
+        CharMpuControl      = 0xfff3,
+        CharMpuData         = 0xfff4,
+        CharMpuTemp         = 0xfff5
+    };
+
+    int m_batteryLevel;
+    // Датчик сам сообщает уровень заряда, опрос не нужен
+    bool m_batteryNotify;
+    bool m_mpuRunning;
+
+    bool m_normalDisconnect;
+    int m_reconnections;
+    // MPU работал в момент обрыва связи и будет запущен снова с прежними параметрами
+    bool m_resumeMpu;
+    // Сервисы, известные по кэшу GATT, создаются сразу при обнаружении
+    QList<QBluetoothUuid> m_cachedServices;
+
+    QLowEnergyController *m_controller;
+    // Сбрасывает m_reconnections, если связь продержалась StableLinkTime
+    QTimer *m_stableTimer;
+    QLowEnergyService *m_batteryService;
+    QLowEnergyService *m_keyService;
+    QLowEnergyService *m_mpuService;
+
+    VecsGattQueue *m_gatt;
+};
+
+#endif // VECSBLETRANSPORT_H
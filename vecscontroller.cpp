@@ -1,10 +1,29 @@
 #include "vecscontroller.h"
-#include <QObjectList>
+#include "vecsbletransport.h"
+#include "vecssimtransport.h"
+#include "vecsreplaytransport.h"
+#include "vecssessionreader.h"
+#include "vecstrace.h"
+#include <QDateTime>
+#include <QDir>
+#include <QStandardPaths>
 
 VecsController::VecsController(QObject *parent) :
+    VecsController(new QSettings("krisaf", "vecs-controller"), parent)
+{
+}
+
+VecsController::VecsController(QSettings *settings, QObject *parent) :
     QObject(parent),
     m_discovering(false),
-    m_agent(new QBluetoothDeviceDiscoveryAgent(this))
+    m_model(new VecsDeviceModel(this)),
+    m_agent(new QBluetoothDeviceDiscoveryAgent(this)),
+    m_settings(settings),
+    m_recording(false),
+    m_serverThread(nullptr),
+    m_server(nullptr),
+    m_shmThread(nullptr),
+    m_shm(nullptr)
 {
     connect(m_agent, SIGNAL(deviceDiscovered(QBluetoothDeviceInfo)),
             this, SLOT(addDevice(QBluetoothDeviceInfo)));
@@ -13,20 +32,185 @@ VecsController::VecsController(QObject *parent) :
     connect(m_agent, SIGNAL(finished()),
             this, SLOT(scanFinished()));    
 
-    m_settings = new QSettings("krisaf", "vecs-controller", this);
+    m_settings->setParent(this);
+
+    // Трассировка включается до создания потоков, чтобы их события попали в выгрузку
+    VecsTrace::setBufferSize(m_settings->value("trace/buffer_size", 65536).toInt());
+    VecsTrace::setEnabled(m_settings->value("trace/enabled", false).toBool());
+
+    // Обмен с датчиками идет вне потока GUI. При threads = 0 все работает в потоке GUI,
+    // как раньше (удобно для сравнения задержек notificationLatency)
+    const int threads = m_settings->value("acquisition/threads", 1).toInt();
+    for (int i = 0; i < threads; ++i) {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("vecs-acquisition-%1").arg(i));
+        thread->start(QThread::HighPriority);
+        m_threads.append(thread);
+    }
+    m_nextThread = 0;
+
+    const int fps = qBound(1, m_settings->value("presentation/fps", 60).toInt(), 240);
+    m_frameTimer = new QTimer(this);
+    m_frameTimer->setTimerType(Qt::PreciseTimer);
+    m_frameTimer->setInterval(1000 / fps);
+    connect(m_frameTimer, &QTimer::timeout, this, &VecsController::publishFrame);
+    m_frameTimer->start();
+
+    // Опрос батареи и сторожевые таймеры всех устройств - одно колесо таймеров
+    m_scheduler = new VecsScheduler(this);
+    m_scheduler->setTick(m_settings->value("scheduler/tick", 50).toInt());
+    m_scheduler->setMaxJobsPerTick(m_settings->value("scheduler/max_jobs", 8).toInt());
+
+    // Метрики каналов связи для локального сборщика
+    m_exporter = nullptr;
+    const QString metricsFile = m_settings->value("metrics/file").toString();
+    if (!metricsFile.isEmpty()) {
+        m_exporter = new VecsMetricsExporter(m_model, m_scheduler, this);
+        m_exporter->setFileName(metricsFile);
+        m_exporter->setFormat(m_settings->value("metrics/format", "json").toString() == "text" ?
+                                  VecsMetricsExporter::Text : VecsMetricsExporter::Json);
+        m_exporter->setInterval(m_settings->value("metrics/interval", 5000).toInt());
+        connect(m_exporter, &VecsMetricsExporter::error, this, &VecsController::setMessage);
+        m_exporter->start();
+    }
+
+    // Запись сессии ведется в отдельном потоке с низким приоритетом
+    m_recorderThread = new QThread(this);
+    m_recorderThread->setObjectName("vecs-recorder");
+    m_recorderThread->start(QThread::LowPriority);
+    m_recorder = new VecsSessionRecorder;
+    m_recorder->setCompress(m_settings->value("recording/compress", false).toBool());
+    m_recorder->moveToThread(m_recorderThread);
+    connect(m_recorder, &VecsSessionRecorder::error, this, &VecsController::setMessage);
+
+    // Раздача потоков внешним приложениям: отдельный поток, чтобы отправка не ждала GUI
+    if (m_settings->value("stream/enabled", false).toBool()) {
+        m_serverThread = new QThread(this);
+        m_serverThread->setObjectName("vecs-stream");
+        m_serverThread->start(QThread::HighPriority);
+        m_server = new VecsStreamServer;
+        m_server->setUdpPort(quint16(m_settings->value("stream/udp_port", 5760).toUInt()));
+        m_server->setTcpPort(quint16(m_settings->value("stream/tcp_port", 5761).toUInt()));
+        m_server->setInterval(m_settings->value("stream/interval", 1).toInt());
+        m_server->setBatch(m_settings->value("stream/batch", 1).toInt());
+        m_server->setHoldTime(m_settings->value("stream/hold_time", 10).toInt());
+        m_server->setCompress(m_settings->value("stream/compress", false).toBool());
+        m_server->moveToThread(m_serverThread);
+        connect(m_server, &VecsStreamServer::error, this, &VecsController::setMessage);
+        QMetaObject::invokeMethod(m_server, "start");
+    }
+
+    // Разделяемая память для потребителей на той же машине (формат - vecsshm.h)
+    if (m_settings->value("shm/enabled", false).toBool()) {
+        m_shmThread = new QThread(this);
+        m_shmThread->setObjectName("vecs-shm");
+        m_shmThread->start(QThread::HighPriority);
+        m_shm = new VecsShmPublisher;
+        m_shm->setName(m_settings->value("shm/name", VECS_SHM_NAME).toString());
+        m_shm->setCapacity(m_settings->value("shm/capacity", 1024).toInt());
+        m_shm->setMaxDevices(m_settings->value("shm/max_devices", 32).toInt());
+        m_shm->setInterval(m_settings->value("shm/interval", 1).toInt());
+        m_shm->moveToThread(m_shmThread);
+        connect(m_shm, &VecsShmPublisher::error, this, &VecsController::setMessage);
+        QMetaObject::invokeMethod(m_shm, "start");
+    }
+
+    // Выравнивание потоков разных датчиков по времени
+    m_alignerThread = new QThread(this);
+    m_alignerThread->setObjectName("vecs-aligner");
+    m_alignerThread->start(QThread::HighPriority);
+    m_aligner = new VecsStreamAligner;
+    m_aligner->setFrameRate(m_settings->value("alignment/fps", 200).toInt());
+    m_aligner->setMaxLatency(m_settings->value("alignment/max_latency", 50).toInt());
+    m_aligner->moveToThread(m_alignerThread);
+
+    // Фильтр ориентации работает в том же потоке и получает кадры напрямую
+    m_fusion = new VecsFusionEngine;
+    m_fusion->setBeta(m_settings->value("fusion/beta", 0.1).toFloat());
+    m_fusion->moveToThread(m_alignerThread);
+    connect(m_aligner, &VecsStreamAligner::frameReady, m_fusion, &VecsFusionEngine::processFrame);
+
+    QMetaObject::invokeMethod(m_aligner, "start");
+
+    m_starter = new VecsSessionStarter(this);
+    m_starter->setMaxConcurrency(m_settings->value("session/max_connections", 2).toInt());
+    m_starter->setTimeout(m_settings->value("session/timeout", 20000).toInt());
+    connect(m_starter, &VecsSessionStarter::finished, this, &VecsController::sessionStarted);
 }
 
 VecsController::~VecsController()
 {
-    qDeleteAll(m_devices);
-    m_devices.clear();
+    QMetaObject::invokeMethod(m_recorder, "stop", Qt::BlockingQueuedConnection);
+    m_recorderThread->quit();
+    m_recorderThread->wait();
+    delete m_recorder;
+
+    if (m_server != nullptr) {
+        QMetaObject::invokeMethod(m_server, "stop", Qt::BlockingQueuedConnection);
+        m_serverThread->quit();
+        m_serverThread->wait();
+        delete m_server;
+    }
+
+    if (m_shm != nullptr) {
+        QMetaObject::invokeMethod(m_shm, "stop", Qt::BlockingQueuedConnection);
+        m_shmThread->quit();
+        m_shmThread->wait();
+        delete m_shm;
+    }
+
+    QMetaObject::invokeMethod(m_aligner, "stop", Qt::BlockingQueuedConnection);
+    m_alignerThread->quit();
+    m_alignerThread->wait();
+    delete m_fusion;
+    delete m_aligner;
+
+    // Транспорты останавливаются, пока их потоки работают, а устройства
+    // (и их буферы) удаляются только после завершения потоков сбора данных
+    for (const auto& dev : m_model->devices())
+        dev->close();
+
+    for (const auto& thread : m_threads) {
+        thread->quit();
+        thread->wait();
+    }
+
+    qDeleteAll(m_model->devices());
+
+    if (VecsTrace::isEnabled())
+        dumpTrace();
+}
+
+bool VecsController::dumpTrace(const QString &fileName)
+{
+    const QString name = fileName.isEmpty() ? m_settings->value("trace/file", "vecs-trace.json").toString() : fileName;
+    if (!VecsTrace::dump(name)) {
+        setMessage(QString("Can't write trace to %1").arg(name));
+        return false;
+    }
+    setMessage(QString("Trace saved to %1").arg(name));
+    return true;
 }
 
 void VecsController::startScan()
 {
-    qDeleteAll(m_devices);
-    m_devices.clear();
-    emit devicesUpdated();
+    // Подключенные устройства переживают повторный поиск без изменений,
+    // отключенные и не найденные заново удаляются по его окончании
+    m_seen.clear();
+
+    // Источник устройств: реальные датчики (ble), имитация (sim) или запись сессии (replay)
+    const QString backend = m_settings->value("backend", "ble").toString();
+    if (backend == "sim") {
+        addSimulatedDevices(m_settings->value("simulation/devices", 6).toInt());
+        pruneDevices();
+        return;
+    } else if (backend == "replay") {
+        openReplay(m_settings->value("replay/file").toString(),
+                   m_settings->value("replay/speed", 1.0).toDouble(),
+                   m_settings->value("replay/loop", false).toBool());
+        pruneDevices();
+        return;
+    }
 
     m_agent->start();
 
@@ -36,56 +220,230 @@ void VecsController::startScan()
     setMessage("Scanning for devices...");
 }
 
+void VecsController::removeDevice(VecsDevice *dev)
+{
+    m_recorder->removeStream(dev->samples());
+    if (m_server != nullptr)
+        m_server->removeStream(dev->samples());
+    if (m_shm != nullptr)
+        m_shm->removeStream(dev->samples());
+    m_fusion->removeStream(m_aligner->streamIndex(dev->samples()));
+    m_aligner->removeStream(dev->samples());
+    m_model->remove(dev);
+    delete dev;
+}
+
+void VecsController::pruneDevices()
+{
+    for (const auto& dev : m_model->devices()) {
+        if (!m_seen.contains(dev->bluetoothAddress().toUInt64()) &&
+            dev->connectionState() == VecsDevice::StateDisconnected)
+            removeDevice(dev);
+    }
+}
+
+void VecsController::addSimulatedDevices(int count)
+{
+    VecsSimConfig config;
+    m_settings->beginGroup("simulation");
+    config.lossRate = m_settings->value("loss_rate", 0.0).toDouble();
+    config.jitter = m_settings->value("jitter", 0).toInt();
+    config.connectTime = m_settings->value("connect_time", 300).toInt();
+    config.disconnectInterval = m_settings->value("disconnect_interval", 0).toInt();
+    config.keyInterval = m_settings->value("key_interval", 0).toInt();
+    m_settings->endGroup();
+
+    for (int i = 1; i <= count; ++i) {
+        // Локально администрируемые адреса 02:00:00:00:xx:xx
+        const QBluetoothAddress address(Q_UINT64_C(0x020000000000) + quint64(i));
+        config.seed = quint32(i);
+        registerDevice(new VecsSimTransport(address, config));
+    }
+
+    setMessage(QString("Simulation: %1 devices").arg(count));
+}
+
+bool VecsController::openReplay(const QString &fileName, double speed, bool loop)
+{
+    // Описания потоков собираются проходом по файлу (он отображается в память, это быстро)
+    VecsSessionReader reader;
+    if (!reader.open(fileName)) {
+        setMessage(QString("Can't open session %1: %2").arg(fileName, reader.errorString()));
+        return false;
+    }
+
+    VecsSessionReader::Chunk chunk;
+    while (reader.readChunk(&chunk)) {
+    }
+
+    const QVector<VecsSessionFormat::StreamInfo> streams = reader.streams();
+    for (int i = 0; i < streams.size(); ++i) {
+        const VecsSessionFormat::StreamInfo &info = streams.at(i);
+        if (info.address.isEmpty())
+            continue;
+
+        // Уже воспроизводимый поток при повторном поиске не трогаем
+        const QBluetoothAddress address(info.address);
+        if (m_model->device(address) != nullptr) {
+            m_seen.insert(address.toUInt64());
+            continue;
+        }
+
+        registerDevice(new VecsReplayTransport(address, fileName, i, speed, loop), 0, &info);
+    }
+
+    setMessage(QString("Replay: %1 streams from %2").arg(streams.size()).arg(fileName));
+    return true;
+}
+
 void VecsController::setMessage(const QString &message)
 {
     m_message = message;
     emit messageChanged();
 }
 
-void VecsController::startSession()
+void VecsController::startRecording(const QString &fileName)
 {
-    for (const auto& dev : m_devices) {
-        switch (dev->role()) {
-        case VecsDevice::RoleUndefined:
-            dev->disconnectFromDevice();
-            break;
-        case VecsDevice::RoleDoctor:
-            if (dev->connectionState() == VecsDevice::StateDisconnected)
-                dev->connectToDevice();
-            else if (dev->connectionState() == VecsDevice::StateConnected)
-                if (dev->mpuState())
-                    dev->mpuStop();
-            break;
-        case VecsDevice::RolePatientHand:
-        case VecsDevice::RolePatientBack:
-            if (dev->connectionState() == VecsDevice::StateConnected) {
-                dev->mpuStart();
-            } else if (dev->connectionState() == VecsDevice::StateDisconnected) {
-                dev->connectToDevice(); // MPU запуститься автоматически, т.к. выставлена роль
-            }
-            break;
-        }
+    QString path = fileName;
+    if (path.isEmpty()) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+        path = QDir(dir).filePath(QString("vecs-%1.vecs").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
     }
+
+    bool ok = false;
+    QMetaObject::invokeMethod(m_recorder, "start", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(bool, ok), Q_ARG(QString, path));
+    if (!ok)
+        return;
+
+    m_recording = true;
+    emit recordingChanged();
+    setMessage(QString("Recording to %1").arg(QDir::toNativeSeparators(path)));
 }
 
-QString VecsController::message() const
+void VecsController::stopRecording()
 {
-    return m_message;
+    if (!m_recording)
+        return;
+
+    QMetaObject::invokeMethod(m_recorder, "stop", Qt::BlockingQueuedConnection);
+
+    m_recording = false;
+    emit recordingChanged();
+    setMessage("Recording stopped");
 }
 
-QVariant VecsController::model() const
+bool VecsController::recording() const
 {
-    QObjectList objects;
+    return m_recording;
+}
 
-    for (const auto& i : m_devices)
-        objects.append(i);
+VecsSessionRecorder::StreamInfo VecsController::streamInfo(VecsDevice *dev) const
+{
+    VecsSessionRecorder::StreamInfo info;
+    info.address = dev->address();
+    info.role = dev->role();
+    info.accelRange = dev->accelRange();
+    info.gyroRange = dev->gyroRange();
+    info.mpuRate = dev->mpuRate();
+    return info;
+}
 
-    return QVariant::fromValue(objects);
+void VecsController::updateRecorderStream()
+{
+    VecsDevice *dev = qobject_cast<VecsDevice *>(sender());
+    if (dev != nullptr)
+        m_recorder->updateStream(dev->samples(), streamInfo(dev));
+}
+
+void VecsController::updateServerStream()
+{
+    VecsDevice *dev = qobject_cast<VecsDevice *>(sender());
+    if (dev != nullptr && m_server != nullptr)
+        m_server->updateStream(dev->samples(), streamInfo(dev));
+}
+
+void VecsController::updateShmStream()
+{
+    VecsDevice *dev = qobject_cast<VecsDevice *>(sender());
+    if (dev != nullptr && m_shm != nullptr)
+        m_shm->updateStream(dev->samples(), streamInfo(dev));
+}
+
+void VecsController::updateAlignerStream()
+{
+    VecsDevice *dev = qobject_cast<VecsDevice *>(sender());
+    if (dev != nullptr)
+        m_aligner->updateStream(dev->samples(), dev->mpuRate());
+}
+
+void VecsController::updateFusionStream()
+{
+    VecsDevice *dev = qobject_cast<VecsDevice *>(sender());
+    if (dev != nullptr)
+        m_fusion->setStreamRanges(m_aligner->streamIndex(dev->samples()), dev->accelRange(), dev->gyroRange());
+}
+
+VecsStreamAligner *VecsController::aligner() const
+{
+    return m_aligner;
+}
+
+VecsFusionEngine *VecsController::fusion() const
+{
+    return m_fusion;
+}
+
+VecsStreamServer *VecsController::streamServer() const
+{
+    return m_server;
+}
+
+VecsShmPublisher *VecsController::shmPublisher() const
+{
+    return m_shm;
+}
+
+VecsScheduler *VecsController::scheduler() const
+{
+    return m_scheduler;
+}
+
+VecsMetricsExporter *VecsController::metricsExporter() const
+{
+    return m_exporter;
+}
+
+void VecsController::startSession()
+{
+    setMessage("Starting session...");
+    m_starter->start(m_model->devices());
+}
+
+void VecsController::sessionStarted(int elapsed)
+{
+    setMessage(QString("Session ready in %1 ms (%2 of %3 devices)")
+               .arg(elapsed).arg(m_starter->ready()).arg(m_starter->total()));
+}
+
+VecsSessionStarter *VecsController::session() const
+{
+    return m_starter;
+}
+
+QString VecsController::message() const
+{
+    return m_message;
+}
+
+VecsDeviceModel *VecsController::model() const
+{
+    return m_model;
 }
 
 QList<VecsDevice *> VecsController::devices() const
 {
-    return m_devices;
+    return m_model->devices();
 }
 
 bool VecsController::discovering() const
@@ -98,33 +456,138 @@ void VecsController::addDevice(const QBluetoothDeviceInfo &device)
     if (device.coreConfigurations() & QBluetoothDeviceInfo::LowEnergyCoreConfiguration &&
         device.name().contains("VE Control Sensor")) {
 
-        VecsDevice *vecs = new VecsDevice(device.address(), device.rssi(), this);                      
-        m_devices.append(vecs);
-        emit devicesUpdated();
-
-        m_settings->beginGroup(vecs->address());
-        vecs->setRole((VecsDevice::DeviceRole)m_settings->value("role", VecsDevice::RoleUndefined).toInt());
-        vecs->setAccelRange((VecsDevice::AccelRange)m_settings->value("accel_range", VecsDevice::ACC_2G).toInt());
-        vecs->setGyroRange((VecsDevice::GyroRange)m_settings->value("gyro_range", VecsDevice::GYRO_250DEGS).toInt());
-        vecs->setInterval(m_settings->value("interval", 5000).toInt());
-        vecs->setMaxReconnections(m_settings->value("reconnections", 3).toInt());
-        vecs->setMpuRate(m_settings->value("mpu_rate", 100).toInt());
-        m_settings->endGroup();
+        // Повторное обнаружение (в т.ч. обновление RSSI во время поиска) меняет только уровень сигнала
+        VecsDevice *known = m_model->device(device.address());
+        if (known != nullptr) {
+            m_seen.insert(device.address().toUInt64());
+            m_model->updateRssi(known, device.rssi());
+            return;
+        }
+
+        registerDevice(new VecsBleTransport(device.address()), device.rssi());
 
         setMessage(QString("Device found [%1]").arg(device.address().toString()));
     }
 }
 
+VecsDevice *VecsController::registerDevice(VecsTransport *transport, qint16 rssi,
+                                           const VecsSessionRecorder::StreamInfo *recorded)
+{
+    m_seen.insert(transport->address().toUInt64());
+
+    VecsDevice *known = m_model->device(transport->address());
+    if (known != nullptr) {
+        delete transport;
+        return known;
+    }
+
+    VecsDevice *vecs = new VecsDevice(transport, rssi, acquisitionThread(), this);
+
+    m_settings->beginGroup(vecs->address());
+    vecs->setRole((VecsDevice::DeviceRole)m_settings->value("role", VecsDevice::RoleUndefined).toInt());
+    vecs->setAccelRange((VecsDevice::AccelRange)m_settings->value("accel_range", VecsDevice::ACC_2G).toInt());
+    vecs->setGyroRange((VecsDevice::GyroRange)m_settings->value("gyro_range", VecsDevice::GYRO_250DEGS).toInt());
+    vecs->setInterval(m_settings->value("interval", 5000).toInt());
+    vecs->setMaxReconnections(m_settings->value("reconnections", 3).toInt());
+    vecs->setMpuRate(m_settings->value("mpu_rate", 100).toInt());
+    vecs->setRestRate(m_settings->value("rest_rate", 25).toInt());
+    vecs->setAdaptiveRate(m_settings->value("adaptive_rate", false).toBool());
+    vecs->setMaxInterpolatedGap(m_settings->value("interpolate_gap", 0).toInt());
+    m_settings->endGroup();
+
+    if (recorded != nullptr) {
+        vecs->setRole((VecsDevice::DeviceRole)recorded->role);
+        vecs->setAccelRange((VecsDevice::AccelRange)recorded->accelRange);
+        vecs->setGyroRange((VecsDevice::GyroRange)recorded->gyroRange);
+        // Частоту записанного потока изменить нельзя
+        vecs->setAdaptiveRate(false);
+        vecs->setMpuRate(recorded->mpuRate);
+    }
+
+    m_settings->beginGroup("reconnect");
+    vecs->setReconnectBackoff(m_settings->value("base_delay", 250).toInt(),
+                              m_settings->value("max_delay", 8000).toInt());
+    m_settings->endGroup();
+
+    m_settings->beginGroup("watchdog");
+    vecs->setWatchdog(m_settings->value("stall_timeout", 1000).toInt(),
+                      m_settings->value("period", 500).toInt());
+    m_settings->endGroup();
+    vecs->setScheduler(m_scheduler);
+
+    m_settings->beginGroup("activity");
+    vecs->setActivityThresholds(m_settings->value("gyro_threshold", 5.0).toFloat(),
+                                m_settings->value("accel_threshold", 0.03).toFloat(),
+                                m_settings->value("rest_delay", 3000).toInt());
+    m_settings->endGroup();
+
+    m_settings->beginGroup("features");
+    vecs->features()->setWindow(m_settings->value("window", 2.0).toDouble());
+    vecs->features()->setHop(m_settings->value("hop", 250).toInt());
+    vecs->features()->setTremorBand(m_settings->value("tremor_low", 4.0).toDouble(),
+                                    m_settings->value("tremor_high", 12.0).toDouble());
+    m_settings->endGroup();
+
+    // Настройки устройства попадают в заголовок его потока в файле сессии
+    m_recorder->addStream(vecs->samples(), streamInfo(vecs));
+    connect(vecs, &VecsDevice::roleChanged, this, &VecsController::updateRecorderStream);
+    connect(vecs, &VecsDevice::accelRangeChanged, this, &VecsController::updateRecorderStream);
+    connect(vecs, &VecsDevice::gyroRangeChanged, this, &VecsController::updateRecorderStream);
+    connect(vecs, &VecsDevice::mpuRateChanged, this, &VecsController::updateRecorderStream);
+
+    if (m_server != nullptr) {
+        m_server->addStream(vecs->samples(), streamInfo(vecs));
+        connect(vecs, &VecsDevice::roleChanged, this, &VecsController::updateServerStream);
+        connect(vecs, &VecsDevice::accelRangeChanged, this, &VecsController::updateServerStream);
+        connect(vecs, &VecsDevice::gyroRangeChanged, this, &VecsController::updateServerStream);
+        connect(vecs, &VecsDevice::mpuRateChanged, this, &VecsController::updateServerStream);
+        const QString address = vecs->address();
+        connect(vecs, &VecsDevice::keyPressed, m_server, [=](VecsDevice::ButtonClick type) {
+            m_server->sendKey(address, type);
+        });
+    }
+
+    if (m_shm != nullptr) {
+        m_shm->addStream(vecs->samples(), streamInfo(vecs));
+        connect(vecs, &VecsDevice::roleChanged, this, &VecsController::updateShmStream);
+        connect(vecs, &VecsDevice::accelRangeChanged, this, &VecsController::updateShmStream);
+        connect(vecs, &VecsDevice::gyroRangeChanged, this, &VecsController::updateShmStream);
+        connect(vecs, &VecsDevice::mpuRateChanged, this, &VecsController::updateShmStream);
+    }
+
+    const int stream = m_aligner->addStream(vecs->samples(), vecs->mpuRate());
+    m_fusion->setStreamRanges(stream, vecs->accelRange(), vecs->gyroRange());
+    connect(vecs, &VecsDevice::mpuRateChanged, this, &VecsController::updateAlignerStream);
+    connect(vecs, &VecsDevice::accelRangeChanged, this, &VecsController::updateFusionStream);
+    connect(vecs, &VecsDevice::gyroRangeChanged, this, &VecsController::updateFusionStream);
+
+    // В модель попадает уже настроенное устройство
+    m_model->append(vecs);
+    return vecs;
+}
+
+QThread *VecsController::acquisitionThread()
+{
+    if (m_threads.isEmpty())
+        return nullptr;
+
+    QThread *thread = m_threads.at(m_nextThread);
+    m_nextThread = (m_nextThread + 1) % m_threads.size();
+    return thread;
+}
+
 void VecsController::saveSettings()
 {
-    for (const auto& dev : m_devices) {
+    for (const auto& dev : m_model->devices()) {
         m_settings->beginGroup(dev->address());
         m_settings->setValue("role", dev->role());
         m_settings->setValue("accel_range", dev->accelRange());
         m_settings->setValue("gyro_range", dev->gyroRange());
         m_settings->setValue("interval", dev->interval());
         m_settings->setValue("reconnections", dev->maxReconnections());
-        m_settings->setValue("mpu_rate", dev->mpuRate());
+        // При адаптивной частоте mpuRate может быть частотой покоя
+        m_settings->setValue("mpu_rate", dev->targetRate());
+        m_settings->setValue("interpolate_gap", dev->maxInterpolatedGap());
         m_settings->endGroup();
     }
     m_settings->sync();
@@ -132,18 +595,29 @@ void VecsController::saveSettings()
 
 void VecsController::scanFinished()
 {    
-    emit devicesUpdated();
+    pruneDevices();
 
     m_discovering = false;
     emit stateChanged();
 
-    if (m_devices.isEmpty()) {
+    if (m_model->count() == 0) {
         setMessage("Scan finished: no devices found");
     } else {
-        setMessage(QString("Scan finished: found %1 devices").arg(m_devices.size()));
+        setMessage(QString("Scan finished: found %1 devices").arg(m_model->count()));
     }    
 }
 
+void VecsController::publishFrame()
+{
+    VECS_TRACE_SCOPE("qml", "publishFrame", m_model->count());
+    VecsOrientation orientation;
+    for (const auto& dev : m_model->devices()) {
+        dev->publishFrame();
+        if (m_fusion->orientation(m_aligner->streamIndex(dev->samples()), &orientation))
+            dev->setOrientation(orientation);
+    }
+}
+
 void VecsController::deviceScanError(QBluetoothDeviceDiscoveryAgent::Error error)
 {
     if (error == QBluetoothDeviceDiscoveryAgent::PoweredOffError)
@@ -5,25 +5,55 @@
 #include <QAbstractListModel>
 #include <QBluetoothDeviceDiscoveryAgent>
 #include <QBluetoothDeviceInfo>
+#include <QSet>
 #include <QSettings>
+#include <QThread>
+#include <QTimer>
 #include "vecsdevice.h"
+#include "vecsdevicemodel.h"
+#include "vecssessionrecorder.h"
+#include "vecsstreamserver.h"
+#include "vecsshmpublisher.h"
+#include "vecsstreamaligner.h"
+#include "vecsfusion.h"
+#include "vecssessionstarter.h"
+#include "vecsscheduler.h"
+#include "vecsmetricsexporter.h"
 
 class VecsController : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(QString message READ message NOTIFY messageChanged)
-    Q_PROPERTY(QVariant model READ model NOTIFY devicesUpdated)
+    Q_PROPERTY(VecsDeviceModel *model READ model CONSTANT)
     Q_PROPERTY(bool discovering READ discovering NOTIFY stateChanged)
+    Q_PROPERTY(bool recording READ recording NOTIFY recordingChanged)
+    Q_PROPERTY(VecsSessionStarter *session READ session CONSTANT)
 
 public:
     VecsController(QObject *parent = 0);
+    // Настройки из заданного источника (например, файла конфигурации); контроллер становится владельцем
+    VecsController(QSettings *settings, QObject *parent = 0);
     ~VecsController();
 
     bool discovering() const;
+    bool recording() const;
     QString message() const;
 
-    QVariant model() const;
+    VecsDeviceModel *model() const;
     QList<VecsDevice *> devices() const;
+    VecsSessionStarter *session() const;
+    // Выровненные по времени кадры всех устройств (сигнал frameReady, поток выравнивания)
+    VecsStreamAligner *aligner() const;
+    // Ориентация всех датчиков (сигнал orientationFrame, поток выравнивания)
+    VecsFusionEngine *fusion() const;
+    // Сервер потоков для внешних приложений (nullptr, если отключен настройкой stream/enabled)
+    VecsStreamServer *streamServer() const;
+    // Публикация потоков в разделяемую память (nullptr, если отключена настройкой shm/enabled)
+    VecsShmPublisher *shmPublisher() const;
+    // Периодические задачи всех устройств (поток GUI)
+    VecsScheduler *scheduler() const;
+    // Выгрузка метрик устройств в файл (nullptr, если не задана настройка metrics/file)
+    VecsMetricsExporter *metricsExporter() const;
 
 
 public slots:
@@ -32,23 +62,81 @@ public slots:
     void startSession();
     void saveSettings();
 
+    // Устройства без оборудования: имитация датчиков и воспроизведение записанной сессии.
+    // Адреса имитации постоянны (02:00:00:00:00:01..count), уже созданные устройства остаются
+    void addSimulatedDevices(int count);
+    bool openReplay(const QString &fileName, double speed = 1.0, bool loop = false);
+
+    // Запись всех потоков MPU в файл; без имени файл создается в папке документов
+    void startRecording(const QString &fileName = QString());
+    void stopRecording();
+
+    // Выгрузка трассировки (настройка trace/enabled) в формате Chrome trace;
+    // без имени - в файл из настройки trace/file
+    bool dumpTrace(const QString &fileName = QString());
+
 private slots:
     void addDevice(const QBluetoothDeviceInfo&device);
     void scanFinished();
     void deviceScanError(QBluetoothDeviceDiscoveryAgent::Error error);
+    void publishFrame();
+    void updateRecorderStream();
+    void updateServerStream();
+    void updateShmStream();
+    void updateAlignerStream();
+    void updateFusionStream();
+    void sessionStarted(int elapsed);
+
+private:
+    // Устройство с уже известным адресом не создается заново, транспорт удаляется.
+    // recorded - параметры записанного потока (воспроизведение), они заменяют
+    // сохраненные настройки до того, как устройство попадет в модель
+    VecsDevice *registerDevice(VecsTransport *transport, qint16 rssi = 0,
+                               const VecsSessionRecorder::StreamInfo *recorded = nullptr);
+    void removeDevice(VecsDevice *dev);
+    // Удаляет отключенные устройства, которые не нашлись при последнем поиске
+    void pruneDevices();
+    QThread *acquisitionThread();
+    VecsSessionRecorder::StreamInfo streamInfo(VecsDevice *dev) const;
 
 signals:
     void messageChanged();
-    void devicesUpdated();
     void stateChanged();
+    void recordingChanged();
 
 private:
     bool m_discovering;   
     QString m_message;
 
-    QList<VecsDevice *> m_devices;
+    VecsDeviceModel *m_model;
+    // Адреса устройств, найденных при текущем поиске
+    QSet<quint64> m_seen;
     QBluetoothDeviceDiscoveryAgent *m_agent;
     QSettings *m_settings;
+
+    // Потоки сбора данных, устройства распределяются по ним по очереди
+    QList<QThread *> m_threads;
+    int m_nextThread;
+
+    // Кадровый таймер: данные MPU попадают в QML не чаще одного раза за кадр
+    QTimer *m_frameTimer;
+
+    bool m_recording;
+    QThread *m_recorderThread;
+    VecsSessionRecorder *m_recorder;
+
+    QThread *m_serverThread;
+    VecsStreamServer *m_server;
+    QThread *m_shmThread;
+    VecsShmPublisher *m_shm;
+
+    QThread *m_alignerThread;
+    VecsStreamAligner *m_aligner;
+    VecsFusionEngine *m_fusion;
+
+    VecsSessionStarter *m_starter;
+    VecsScheduler *m_scheduler;
+    VecsMetricsExporter *m_exporter;
 };
 
 #endif // VECSCONTROLLER_H
@@ -1,114 +1,146 @@
 #include "vecsdevice.h"
+#include "vecstransport.h"
+#include "vecsunits.h"
+#include "vecsscheduler.h"
 #include <QDebug>
-#include <QDataStream>
-#include <QCoreApplication>
+#include <QThread>
+#include <QMetaMethod>
 
 VecsDevice::VecsDevice(QObject *parent) :
-    QObject(parent)
+    VecsDevice(nullptr, 0, nullptr, parent)
 {
     qDebug() << "Instance of VecsDevice is created";
 }
 
-VecsDevice::VecsDevice(const QBluetoothAddress &address, qint16 rssi, QObject *parent) :
+VecsDevice::VecsDevice(VecsTransport *transport, qint16 rssi, QThread *thread, QObject *parent) :
     QObject(parent),
-    m_address(address),
+    m_address(transport != nullptr ? transport->address() : QBluetoothAddress()),
     m_rssi(rssi),    
     m_batteryLevel(100),
     m_mpuRate(100),
+    m_targetRate(100),
+    m_adaptiveRate(false),
+    m_restRate(25),
+    m_rateStepTime(0),
     m_gyroRange(VecsDevice::GYRO_250DEGS),
     m_accelRange(VecsDevice::ACC_2G),
     m_connectionState(StateDisconnected),
+    m_mpuState(false),
     m_singleClickCount(0),
     m_doubleClickCount(0),
     m_longClickCount(0),
+    m_window(new VecsSampleWindow(this)),
+    m_features(new VecsFeatureEngine(this)),
+    m_metrics(new VecsDeviceMetrics(this)),
+    m_startupTime(0),
+    m_reconnectTime(0),
+    m_outageTime(0),
+    m_connectionInterval(0),
+    m_connectionLatency(0),
+    m_supervisionTimeout(0),
+    m_linkStatsTime(0),
+    m_linkStatsExpected(0),
+    m_maxInterpolatedGap(0),
     m_role(VecsDevice::RoleUndefined),
-    m_normalDisconnect(true),
     m_maxReconnections(3),
-    m_reconnections(0),
-    m_timer(nullptr),
-    m_controller(nullptr),
-    m_batteryService(nullptr),
-    m_keyService(nullptr),
-    m_mpuService(nullptr)
+    m_interval(5000),
+    m_scheduler(nullptr),
+    m_batteryJob(0),
+    m_watchdogJob(0),
+    m_watchdogPeriod(500),
+    m_stallTimeout(1000000000LL),
+    m_lastSampleTime(0),
+    m_stalled(false),
+    m_stallCount(0),
+    m_transport(transport)
 {
     m_accelX = m_accelY = m_accelZ = 0;
     m_gyroX = m_gyroY = m_gyroZ = 0;
+    m_packetIndex = 0;
 
+    m_reader.attach(&m_samples);
 
-    m_controller = new QLowEnergyController(m_address, this);
-    connect(m_controller, &QLowEnergyController::connected, this, &VecsDevice::deviceConnected);
-    connect(m_controller, &QLowEnergyController::disconnected, this, &VecsDevice::deviceDisconnected);
-    connect(m_controller, SIGNAL(error(QLowEnergyController::Error)), this, SLOT(controllerError(QLowEnergyController::Error)));
-    connect(m_controller, &QLowEnergyController::discoveryFinished, this, &VecsDevice::serviceDiscoveryDone);
+    m_features->setRate(m_mpuRate);
+    connect(this, &VecsDevice::mpuBlockReceived, m_features, &VecsFeatureEngine::addBlock);
 
-    m_timer = new QTimer(this);
-    m_timer->setInterval(5000);
-    connect(m_timer, &QTimer::timeout, this, &VecsDevice::timerJob);
-}
+    if (m_transport == nullptr)
+        return;
 
-VecsDevice::~VecsDevice()
-{
-    disconnectFromDevice();
-}
+    // Транспорт работает в потоке сбора данных (или в потоке GUI, если поток не задан)
+    m_transport->setRing(&m_samples);
+    m_metrics->setCounters(m_transport->counters());
+    if (thread != nullptr)
+        m_transport->moveToThread(thread);
 
-void VecsDevice::connectToDevice()
-{   
-    m_controller->connectToDevice();
-    m_connectionState = StateConnecting;
-    emit stateChanged();    
+    connect(m_transport, &VecsTransport::connected, this, &VecsDevice::transportConnected);
+    connect(m_transport, &VecsTransport::connectionStateChanged, this, &VecsDevice::transportStateChanged);
+    connect(m_transport, &VecsTransport::batteryLevelChanged, this, &VecsDevice::transportBatteryLevelChanged);
+    connect(m_transport, &VecsTransport::keyPressed, this, &VecsDevice::transportKeyPressed);
+    connect(m_transport, &VecsTransport::mpuStateChanged, this, &VecsDevice::transportMpuStateChanged);
+    connect(m_transport, &VecsTransport::mpuFirstSample, this, &VecsDevice::transportMpuFirstSample);
+    connect(m_transport, &VecsTransport::reconnected, this, &VecsDevice::transportReconnected);
+    connect(m_transport, &VecsTransport::connectionParametersChanged, this, &VecsDevice::transportConnectionParametersChanged);
+    connect(m_transport, &VecsTransport::samplesAvailable, this, &VecsDevice::drainSamples);
+
+    QMetaObject::invokeMethod(m_transport, "open");
 }
 
-void VecsDevice::disconnectFromDevice()
+VecsDevice::~VecsDevice()
 {
-    m_normalDisconnect = true;
-    m_timer->stop();
-    m_controller->disconnectFromDevice();    
+    if (m_transport == nullptr)
+        return;
 
-    // Все объекты удаляются при disconnectFromDevice() автоматически
-    m_batteryService = nullptr;
-    m_keyService = nullptr;
-    m_mpuService = nullptr;
+    close();
+
+    // Транспорт удаляется в своем потоке; если поток уже остановлен - сразу
+    QThread *thread = m_transport->thread();
+    if (thread != QThread::currentThread() && thread->isRunning())
+        m_transport->deleteLater();
+    else
+        delete m_transport;
 }
 
-void VecsDevice::deviceConnected()
+void VecsDevice::close()
 {
-    qDebug() << "device [" << m_address.toString() << "] connected";    
+    if (m_transport == nullptr)
+        return;
 
-    // Сброс данных для переподключения при обрыве связи
-    m_normalDisconnect = false;
-    m_reconnections = 0;
+    // Транспорт пишет в m_samples из своего потока: до возврата он должен
+    // остановиться и забыть буфер, иначе запоздавшие уведомления и таймеры
+    // имитации писали бы в освобожденную память
+    disconnect(m_transport, nullptr, this, nullptr);
+    QThread *thread = m_transport->thread();
+    if (thread != QThread::currentThread() && thread->isRunning())
+        QMetaObject::invokeMethod(m_transport, "close", Qt::BlockingQueuedConnection);
+    else
+        m_transport->close();
+}
 
-    // Очищаем счетчики нажатий
-    m_singleClickCount = m_doubleClickCount = m_longClickCount = 0;
+void VecsDevice::connectToDevice()
+{   
+    if (m_transport == nullptr)
+        return;
 
-    // Запускаем обнаружение сервисов
-    m_controller->discoverServices();
+    updateMpuConfig();
+    QMetaObject::invokeMethod(m_transport, "connectToDevice");
+    m_connectionState = StateConnecting;
+    emit stateChanged();    
 }
 
-void VecsDevice::deviceDisconnected()
-{    
-    m_connectionState = StateDisconnected;
-    emit stateChanged();
+void VecsDevice::disconnectFromDevice()
+{
+    if (m_transport == nullptr)
+        return;
 
-    if (!m_normalDisconnect) {
-        if (m_reconnections < m_maxReconnections) {
-            m_reconnections++;
-            qDebug() << "recon: " << m_reconnections << " of max: " << m_maxReconnections;
-            qDebug() << "Connection to [" << m_address.toString() << "] lost.. trying to reconnect after 0.5sec";
-            QTimer::singleShot(500, this, SLOT(connectToDevice()));
-        }
-    } else {
-        qDebug() << "device [" << m_address.toString() << "] disconnected";
-    }
+    QMetaObject::invokeMethod(m_transport, "disconnectFromDevice");
 }
 
-
 void VecsDevice::keyRequest(quint8 delay)
 {
     if (m_connectionState != StateConnected)
         return;
 
-    writeCharacteristic(m_keyService, QBluetoothUuid((quint16)VecsDevice::CharKeyRequest), delay);
+    QMetaObject::invokeMethod(m_transport, "keyRequest", Q_ARG(int, delay));
 }
 
 void VecsDevice::mpuStart()
@@ -116,21 +148,8 @@ void VecsDevice::mpuStart()
     if (m_connectionState != StateConnected)
         return;
 
-    // Останавлиаваем MPU (если перезапуск с новыми параметрами)
-    mpuStop();
-
-    // Пробуждение MPU, настройка частоты передачи данных и запуск
-    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsDevice::CharMpuControl), (quint8)m_mpuRate);
-
-    // Задаем диапазоны измерений гироскопа и акселерометра
-    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsDevice::CharAccelRange), (quint8)m_accelRange);
-    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsDevice::CharGyroRange), (quint8)m_gyroRange);
-
-    // Включение приема данных от MPU
-    enableNotifications(m_mpuService, QBluetoothUuid((quint16)VecsDevice::CharMpuData), true);
-
-    m_mpuState = true;
-    emit mpuStateChanged();
+    updateMpuConfig();
+    QMetaObject::invokeMethod(m_transport, "mpuStart");
 }
 
 void VecsDevice::mpuStop()
@@ -138,109 +157,220 @@ void VecsDevice::mpuStop()
     if (m_connectionState != StateConnected)
         return;
 
-    // Отключаем отправку данных
-    enableNotifications(m_mpuService, QBluetoothUuid((quint16)VecsDevice::CharMpuData), false);
-    // Останавливаем MPU
-    writeCharacteristic(m_mpuService, QBluetoothUuid((quint16)VecsDevice::CharMpuControl), 0);
-
-    m_mpuState = false;
-    emit mpuStateChanged();
+    QMetaObject::invokeMethod(m_transport, "mpuStop");
 }
 
-void VecsDevice::controllerError(QLowEnergyController::Error error)
+void VecsDevice::updateMpuConfig()
 {
-    qDebug() << "device controller error: " << error;
+    QMetaObject::invokeMethod(m_transport, "setMpuConfig",
+                              Q_ARG(int, m_mpuRate), Q_ARG(int, m_accelRange), Q_ARG(int, m_gyroRange));
+    QMetaObject::invokeMethod(m_transport, "setAutoStart",
+                              Q_ARG(bool, m_role == RolePatientBack || m_role == RolePatientHand));
+    updateConnectionParameters();
 }
 
-void VecsDevice::timerJob()
+void VecsDevice::updateConnectionParameters()
 {
-    if (m_batteryService == nullptr)
-        return;
-    if (m_batteryService->state() != QLowEnergyService::ServiceDiscovered)
-        return;
+    double minInterval = 0;
+    double maxInterval = 0;
+    int latency = 0;
+    int supervisionTimeout = 0;
 
-    QLowEnergyCharacteristic batteryLevel = m_batteryService->characteristic(QBluetoothUuid::BatteryLevel);
-    m_batteryService->readCharacteristic(batteryLevel);
+    switch (m_role) {
+    case RolePatientHand:
+    case RolePatientBack:
+        // Поток MPU: несколько уведомлений за событие соединения, но задержка
+        // доставки не больше двух периодов отсчетов и не больше 20 мс
+        minInterval = 7.5;
+        maxInterval = qBound(7.5, 2000.0 / m_mpuRate, 20.0);
+        supervisionTimeout = 2000;
+        break;
+    case RoleDoctor:
+        // Только кнопка: длинный интервал освобождает эфир для датчиков пациента,
+        // а без данных датчик пропускает до 4 событий подряд
+        minInterval = 100;
+        maxInterval = 150;
+        latency = 4;
+        supervisionTimeout = 4000;
+        break;
+    default:
+        // Роль не задана - параметры выбирает стек
+        break;
+    }
+
+    QMetaObject::invokeMethod(m_transport, "setConnectionParameters",
+                              Q_ARG(double, minInterval), Q_ARG(double, maxInterval),
+                              Q_ARG(int, latency), Q_ARG(int, supervisionTimeout));
 }
 
-QLowEnergyService *VecsDevice::addService(const QBluetoothUuid &uuid)
+void VecsDevice::transportConnected()
 {
-    QLowEnergyService *service = m_controller->createServiceObject(uuid, this);
-    if (service == nullptr) {
-        qDebug() << "error: " << QString("0x%1").arg(uuid.toUInt16(), 4, 16, QLatin1Char('0')) << "service not found on the device";
-        return nullptr;
-    }
-
-    connect(service, &QLowEnergyService::stateChanged, this, &VecsDevice::serviceStateChanged);
-    connect(service, &QLowEnergyService::characteristicRead, this, &VecsDevice::characteristicRead);
-    connect(service, &QLowEnergyService::characteristicChanged, this, &VecsDevice::characteristicNotification);
-    connect(service, &QLowEnergyService::characteristicWritten, this, &VecsDevice::characteristicWritten);
-    connect(service, static_cast<void(QLowEnergyService::*)(QLowEnergyService::ServiceError)>(&QLowEnergyService::error),
-          [=](QLowEnergyService::ServiceError newError) {
-        m_charWriteFlag = true;
-        qDebug() << "service error: " << newError;
-    });
-    service->discoverDetails();
+    // Очищаем счетчики нажатий
+    m_singleClickCount = m_doubleClickCount = m_longClickCount = 0;
+}
 
-    return service;
+void VecsDevice::transportStateChanged(int state)
+{
+    m_connectionState = (ConnectionState)state;
+    if (m_connectionState != StateConnected && m_mpuState) {
+        m_mpuState = false;
+        emit mpuStateChanged();
+    }
+    // Обрыв связи - не остановка потока: о нем сообщает состояние соединения
+    if (m_connectionState != StateConnected && m_stalled) {
+        m_stalled = false;
+        emit stalledChanged();
+    }
+    if (m_connectionState == StateDisconnected && m_connectionInterval > 0) {
+        m_connectionInterval = 0;
+        m_connectionLatency = m_supervisionTimeout = 0;
+        emit connectionParametersChanged();
+    }
+    emit stateChanged();
 }
 
-bool VecsDevice::enableNotifications(QLowEnergyService *service, const QBluetoothUuid &uuid, bool enable)
+void VecsDevice::transportBatteryLevelChanged(int level)
 {
-    if (service == nullptr)
-        return false;
-    if (service->state() != QLowEnergyService::ServiceDiscovered)
-        return false;
+    m_batteryLevel = level;
+    emit batteryLevelChanged(m_batteryLevel);
+}
 
-    // Получаем характеристику
-    const QLowEnergyCharacteristic c = service->characteristic(uuid);
-    if (!c.isValid()) {
-        qDebug() << "error: characteristic (uuid: " << QString("0x%1").arg(uuid.toUInt16(), 4, 16, QLatin1Char('0')) << ") not found";
-        return false;
+void VecsDevice::transportKeyPressed(int type)
+{
+    switch (type) {
+    case SINGLE_CLICK:
+        m_singleClickCount++;
+        break;
+    case DOUBLE_CLICK:
+        m_doubleClickCount++;
+        break;
+    case LONG_CLICK:
+        m_longClickCount++;
+        break;
     }
 
-    // Получаем дескриптор настройки
-    const QLowEnergyDescriptor desc = c.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration);
-    if (!desc.isValid()) {
-        qDebug() << "error: characteristic (uuid: " << QString("0x%1").arg(uuid.toUInt16(), 4, 16, QLatin1Char('0')) << ") configuration descriptor not found";
-        return false;
+    emit keyPressed((VecsDevice::ButtonClick)type);
+}
+
+void VecsDevice::transportMpuStateChanged(bool state)
+{
+    if (state != m_mpuState) {
+        m_mpuState = state;
+        // Время до первого отсчета тоже контролируется сторожевым таймером
+        m_lastSampleTime = vecsTimestamp();
+        if (!m_mpuState && m_stalled) {
+            m_stalled = false;
+            emit stalledChanged();
+        }
+        // Новый поток: оценка покоя начинается заново, датчик считается движущимся
+        m_activity.reset();
+        if (m_adaptiveRate)
+            emit activityChanged();
+        emit mpuStateChanged();
     }
-    // Включаем уведомления по этой характеристике
-    if (enable)
-        service->writeDescriptor(desc, QByteArray::fromHex("0100"));
-    else
-        service->writeDescriptor(desc, QByteArray::fromHex("0000"));
+}
+
+void VecsDevice::transportMpuFirstSample(qint64 elapsed)
+{
+    m_startupTime = int(elapsed / 1000000);
+    qDebug() << "device [" << address() << "] first MPU sample after" << m_startupTime << "ms";
+    emit latencyChanged();
+    emit firstSampleReceived();
+}
 
-    return true;
+void VecsDevice::transportReconnected(qint64 reconnectTime, qint64 outageTime)
+{
+    m_reconnectTime = int(reconnectTime / 1000000);
+    m_outageTime = int(outageTime / 1000000);
+    qDebug() << "device [" << address() << "] stream resumed" << m_reconnectTime << "ms after reconnect,"
+             << m_outageTime << "ms after link loss";
+    emit reconnectStatsChanged();
 }
 
-bool VecsDevice::writeCharacteristic(QLowEnergyService *service, const QBluetoothUuid &uuid, quint8 value)
+void VecsDevice::transportConnectionParametersChanged(double interval, int latency, int supervisionTimeout)
 {
-    m_charWriteFlag = false;
+    m_connectionInterval = interval;
+    m_connectionLatency = latency;
+    m_supervisionTimeout = supervisionTimeout;
+    qDebug() << "device [" << address() << "] connection interval" << interval << "ms, latency" << latency
+             << ", supervision timeout" << supervisionTimeout << "ms";
+    emit connectionParametersChanged();
+}
 
-    if (service == nullptr)
-        return false;
-    if (service->state() != QLowEnergyService::ServiceDiscovered)
-        return false;
+void VecsDevice::drainSamples()
+{
+    // Снимаем флаг до чтения, чтобы не пропустить отсчеты, пришедшие во время обработки
+    m_transport->acknowledgeSamples();
 
-    const QLowEnergyCharacteristic c = service->characteristic(uuid);
-    if (!c.isValid()) {
-        qDebug() << "error: characteristic (uuid: " << QString("0x%1").arg(uuid.toUInt16(), 4, 16, QLatin1Char('0')) << ") not found";
-        return false;
+    const qint64 now = vecsTimestamp();
+    bool latencyUpdated = false;
+    m_metrics->addBacklog(int(m_samples.head() - m_reader.position()));
+    m_lastSampleTime = now;
+    if (m_stalled) {
+        m_stalled = false;
+        qDebug() << "device [" << address() << "] MPU stream resumed";
+        emit stalledChanged();
     }
 
-    service->writeCharacteristic(c, QByteArray::fromRawData((const char *)&value, 1));
-    while (!m_charWriteFlag) {
-        QCoreApplication::processEvents();
+    // Блок в физических единицах собирается, только если на него кто-то подписан
+    static const QMetaMethod blockSignal = QMetaMethod::fromSignal(&VecsDevice::mpuBlockReceived);
+    const bool convert = isSignalConnected(blockSignal);
+    m_block.clear();
+
+    bool activityUpdated = false;
+    if (m_adaptiveRate)
+        m_activity.setScales(VecsUnits::accelScale(m_accelRange), VecsUnits::gyroScale(m_gyroRange));
+
+    m_reader.drain([&](const VecsSample *data, int n) {
+        for (int i = 0; i < n; ++i) {
+            if (!(data[i].flags & VecsSample::FlagSynthetic)) {
+                latencyUpdated |= m_latency.addSample(data[i].packetIndex, data[i].timestamp, now, m_mpuRate);
+                if (m_adaptiveRate)
+                    activityUpdated |= m_activity.addSample(data[i]);
+            }
+            m_window->add(data[i]);
+            emit mpuSampleReceived(data[i]);
+        }
+        if (convert)
+            m_block.append(data, n);
+    });
+
+    if (convert && m_block.size() > 0) {
+        VecsUnits::convert(m_block, m_accelRange, m_gyroRange, &m_motion);
+        emit mpuBlockReceived(m_motion);
     }
 
-    return (service->error() == QLowEnergyService::NoError);
+    if (latencyUpdated)
+        emit latencyChanged();
+
+    if (m_adaptiveRate)
+        updateAdaptiveRate(activityUpdated);
 }
 
-void VecsDevice::parseMpuData(const QByteArray &data)
+void VecsDevice::updateAdaptiveRate(bool activityUpdated)
 {
-    QDataStream s(data);
-    s >> m_accelX >> m_accelY >> m_accelZ >> m_packetIndex >> m_gyroX >> m_gyroY >> m_gyroZ;
+    const qint64 now = vecsTimestamp();
+    if (activityUpdated) {
+        m_rateStepTime = now;
+        emit activityChanged();
+    }
+
+    // Движение - сразу заданная частота; покой - вдвое ниже каждые restDelay мс, до restRate
+    int rate = m_mpuRate;
+    if (m_activity.isMoving()) {
+        rate = m_targetRate;
+    } else if (m_mpuRate > m_restRate &&
+               (activityUpdated || now - m_rateStepTime >= qint64(m_activity.restDelay()) * 1000000)) {
+        rate = qMax(m_restRate, m_mpuRate / 2);
+        m_rateStepTime = now;
+    }
+
+    if (rate != m_mpuRate) {
+        qDebug() << "device [" << address() << "]" << (m_activity.isMoving() ? "moving" : "at rest")
+                 << ", MPU rate" << m_mpuRate << "->" << rate << "Hz";
+        applyMpuRate(rate);
+        emit mpuRateChanged();
+    }
 }
 
 int VecsDevice::maxReconnections() const
@@ -251,6 +381,14 @@ int VecsDevice::maxReconnections() const
 void VecsDevice::setMaxReconnections(int maxReconnections)
 {
     m_maxReconnections = maxReconnections;
+    if (m_transport != nullptr)
+        QMetaObject::invokeMethod(m_transport, "setMaxReconnections", Q_ARG(int, m_maxReconnections));
+}
+
+void VecsDevice::setReconnectBackoff(int baseDelay, int maxDelay)
+{
+    if (m_transport != nullptr)
+        QMetaObject::invokeMethod(m_transport, "setReconnectBackoff", Q_ARG(int, baseDelay), Q_ARG(int, maxDelay));
 }
 
 bool VecsDevice::mpuState() const
@@ -263,187 +401,232 @@ quint16 VecsDevice::packetIndex() const
     return m_packetIndex;
 }
 
-qint16 VecsDevice::gyroZ() const
+const VecsSampleRing *VecsDevice::samples() const
 {
-    return m_gyroZ;
+    return &m_samples;
 }
 
-qint16 VecsDevice::gyroY() const
+VecsSampleWindow *VecsDevice::mpuWindow() const
 {
-    return m_gyroY;
+    return m_window;
 }
 
-qint16 VecsDevice::gyroX() const
+VecsFeatureEngine *VecsDevice::features() const
 {
-    return m_gyroX;
+    return m_features;
 }
 
-qint16 VecsDevice::accelZ() const
+VecsDeviceMetrics *VecsDevice::metrics() const
 {
-    return m_accelZ;
+    return m_metrics;
 }
 
-qint16 VecsDevice::accelY() const
+void VecsDevice::publishFrame()
 {
-    return m_accelY;
+    // Статистику потерь обновляем не чаще раза в секунду и только при изменениях
+    if (m_transport != nullptr) {
+        const qint64 now = vecsTimestamp();
+        if (now - m_linkStatsTime >= 1000000000) {
+            m_linkStatsTime = now;
+            const quint64 expected = m_transport->sequence()->expected();
+            if (expected != m_linkStatsExpected) {
+                m_linkStatsExpected = expected;
+                emit linkStatsChanged();
+            }
+        }
+    }
+
+    if (!m_window->publish())
+        return;
+
+    // Свойства отражают последний отсчет
+    const VecsSample &s = m_window->lastSample();
+    m_accelX = s.accel[0];
+    m_accelY = s.accel[1];
+    m_accelZ = s.accel[2];
+    m_packetIndex = s.packetIndex;
+    m_gyroX = s.gyro[0];
+    m_gyroY = s.gyro[1];
+    m_gyroZ = s.gyro[2];
+
+    const float a = VecsUnits::accelScale(m_accelRange);
+    const float g = VecsUnits::gyroScale(m_gyroRange);
+    m_accel = QVariantList() << s.accel[0] * a << s.accel[1] * a << s.accel[2] * a;
+    m_gyro = QVariantList() << s.gyro[0] * g << s.gyro[1] * g << s.gyro[2] * g;
+
+    emit mpuDataRecieved();
 }
 
-qint16 VecsDevice::accelX() const
+int VecsDevice::notificationLatency() const
 {
-    return m_accelX;
+    return m_latency.notificationLatency();
 }
 
-VecsDevice::DeviceRole VecsDevice::role() const
+int VecsDevice::notificationLatencyMax() const
 {
-    return m_role;
+    return m_latency.notificationLatencyMax();
 }
 
-void VecsDevice::setRole(VecsDevice::DeviceRole role)
+int VecsDevice::deliveryLatency() const
 {
-    if (role != m_role) {
-        m_role = role;
-        emit roleChanged();
-    }
+    return m_latency.deliveryLatency();
 }
 
-void VecsDevice::serviceDiscoveryDone()
+int VecsDevice::startupTime() const
 {
-    m_batteryService = addService(QBluetoothUuid::BatteryService);
-    m_keyService = addService(QBluetoothUuid((quint16)VecsDevice::KeyService));
-    m_mpuService = addService(QBluetoothUuid((quint16)VecsDevice::MpuService));
+    return m_startupTime;
+}
 
-    // Сообщаем об изменении состояния после окончания обнаружения сервисов
-    m_connectionState = StateConnected;
-    emit stateChanged();
+int VecsDevice::reconnectTime() const
+{
+    return m_reconnectTime;
 }
 
-void VecsDevice::serviceStateChanged(QLowEnergyService::ServiceState state)
+int VecsDevice::outageTime() const
 {
-    // Игнорируем все состояния кроме ServiceDiscovered
-    if (state != QLowEnergyService::ServiceDiscovered)
-        return;
+    return m_outageTime;
+}
 
-    // Распознаем отправителя сигнала
-    QLowEnergyService *service = qobject_cast<QLowEnergyService *>(sender());
-    if (!service)
-        return;
+double VecsDevice::connectionInterval() const
+{
+    return m_connectionInterval;
+}
 
-//    qDebug() << "info: " << service->serviceName() << QString("0x%1").arg(service->serviceUuid().toUInt16(), 4, 16, QLatin1Char('0')) << "fully discovered";
+int VecsDevice::connectionLatency() const
+{
+    return m_connectionLatency;
+}
 
-    if (service == m_batteryService) {
-        const QLowEnergyCharacteristic batteryLevel = service->characteristic(QBluetoothUuid::BatteryLevel);
-        if (batteryLevel.isValid()) {
-            // Обновляем значение заряда
-            m_batteryLevel = batteryLevel.value().at(0);
-            emit batteryLevelChanged(m_batteryLevel);
+int VecsDevice::supervisionTimeout() const
+{
+    return m_supervisionTimeout;
+}
 
-            // Запускаем таймер на периодический опрос состояния батарейки            
-            m_timer->start();
-        } else {
-            qDebug() << "error: BatteryLevel characteristic not found";
-        }
-    } else if (service == m_keyService) {
-        // Включаем уведомления по характеристике KeyPressState
-        enableNotifications(service, QBluetoothUuid((quint16)VecsDevice::CharKeyPressState), true);
-    } else if (service == m_mpuService) {
-        // Останавливаем работу MPU если был запущен до этого
-        mpuStop();
-
-/* FIXME: Убрано, т.к. если пользователь настроил параметры до подключения,
- * то при подключении они внезапно меняются на те, которые остались на приборе
- * в прошлой сессии
- *
-        // Характеристика "Диапазон аксеелерометра"
-        const QLowEnergyCharacteristic accelRange = service->characteristic(QBluetoothUuid((quint16)VecsDevice::CharAccelRange));
-        if (accelRange.isValid()) {
-            m_accelRange = (VecsDevice::AccelRange)accelRange.value().at(0);
-            emit accelRangeChanged();
-        } else {
-            qDebug() << "error: AccelRange characteristic not found";
-        }
+double VecsDevice::lossRate() const
+{
+    return (m_transport != nullptr) ? m_transport->sequence()->lossRate() : 0.0;
+}
 
-        // Характеристика "Диапазон гироскопа"
-        const QLowEnergyCharacteristic gyroRange = service->characteristic(QBluetoothUuid((quint16)VecsDevice::CharGyroRange));
-        if (gyroRange.isValid()) {
-            m_gyroRange = (VecsDevice::GyroRange)gyroRange.value().at(0);
-            emit gyroRangeChanged();
-        } else {
-            qDebug() << "error: GyroRange characteristic not found";
-        }
-*/
+int VecsDevice::longestGap() const
+{
+    return (m_transport != nullptr) ? m_transport->sequence()->longestGap() : 0;
+}
 
-        // Автоматически запускаем прием данных для ролей пациента
-        if (m_role == RolePatientBack || m_role == RolePatientHand) {
-            mpuStart();
-        }
-    }
+quint64 VecsDevice::receivedPackets() const
+{
+    return (m_transport != nullptr) ? m_transport->sequence()->received() : 0;
 }
 
-void VecsDevice::characteristicNotification(const QLowEnergyCharacteristic &c, const QByteArray &v)
-{
-//    qDebug() <<  QString("[%1] notify %2 (uuid: 0x%3) value: [%4]")
-//                 .arg(this->address())
-//                 .arg(c.name())
-//                 .arg(c.uuid().toUInt16(), 4, 16, QLatin1Char('0'))
-//                 .arg(QString(v.toHex()));
-
-    switch (c.uuid().toUInt16()) {
-    case VecsDevice::CharKeyPressState:
-    {
-        VecsDevice::ButtonClick type = (VecsDevice::ButtonClick)v.at(0);
-
-        switch (type) {
-        case SINGLE_CLICK:
-            m_singleClickCount++;
-            break;
-        case DOUBLE_CLICK:
-            m_doubleClickCount++;
-            break;
-        case LONG_CLICK:
-            m_longClickCount++;
-            break;
-        }
+quint64 VecsDevice::expectedPackets() const
+{
+    return (m_transport != nullptr) ? m_transport->sequence()->expected() : 0;
+}
 
-        emit keyPressed(type);
-        break;
-    }
-    case VecsDevice::CharMpuData:
-    {        
-        parseMpuData(v);
-        emit mpuDataRecieved(v);
-        break;
-    }
+quint64 VecsDevice::duplicatePackets() const
+{
+    return (m_transport != nullptr) ? m_transport->sequence()->duplicates() : 0;
+}
+
+quint64 VecsDevice::reorderedPackets() const
+{
+    return (m_transport != nullptr) ? m_transport->sequence()->reordered() : 0;
+}
+
+quint64 VecsDevice::stalePackets() const
+{
+    return (m_transport != nullptr) ? m_transport->sequence()->stale() : 0;
+}
+
+int VecsDevice::maxInterpolatedGap() const
+{
+    return m_maxInterpolatedGap;
+}
+
+void VecsDevice::setMaxInterpolatedGap(int maxGap)
+{
+    maxGap = qMax(0, maxGap);
+    if (maxGap != m_maxInterpolatedGap) {
+        m_maxInterpolatedGap = maxGap;
+        if (m_transport != nullptr)
+            QMetaObject::invokeMethod(m_transport, "setMaxInterpolatedGap", Q_ARG(int, m_maxInterpolatedGap));
+        emit maxInterpolatedGapChanged();
     }
 }
 
-void VecsDevice::characteristicRead(const QLowEnergyCharacteristic &c, const QByteArray &v)
-{    
-//    qDebug() <<  QString("[%1] read %2 (uuid: 0x%3) value: %4")
-//                 .arg(this->address())
-//                 .arg(c.name())
-//                 .arg(c.uuid().toUInt16(), 4, 16, QLatin1Char('0'))
-//                 .arg(QString(v.toHex()));
+QVariantList VecsDevice::orientation() const
+{
+    return QVariantList() << m_orientation.w << m_orientation.x << m_orientation.y << m_orientation.z;
+}
 
-    switch (c.uuid().toUInt16()) {
-        case QBluetoothUuid::BatteryLevel:
-            if (v.at(0) != m_batteryLevel) {
-                m_batteryLevel = v.at(0);
-                emit batteryLevelChanged(m_batteryLevel);
-            }
-            break;
+QVariantList VecsDevice::eulerAngles() const
+{
+    float roll, pitch, yaw;
+    VecsFusionEngine::eulerAngles(m_orientation, &roll, &pitch, &yaw);
+    return QVariantList() << roll << pitch << yaw;
+}
+
+void VecsDevice::setOrientation(const VecsOrientation &orientation)
+{
+    if (orientation.w != m_orientation.w || orientation.x != m_orientation.x
+            || orientation.y != m_orientation.y || orientation.z != m_orientation.z) {
+        m_orientation = orientation;
+        emit orientationChanged();
     }
 }
 
-void VecsDevice::characteristicWritten(const QLowEnergyCharacteristic &c, const QByteArray &v)
+QVariantList VecsDevice::accel() const
 {
-    Q_UNUSED(v)
+    return m_accel;
+}
 
-    qDebug() <<  QString("[%1] written %2 (uuid: 0x%3)")
-                 .arg(this->address())
-                 .arg(c.name())
-                 .arg(c.uuid().toUInt16(), 4, 16, QLatin1Char('0'));
+QVariantList VecsDevice::gyro() const
+{
+    return m_gyro;
+}
 
-    m_charWriteFlag = true;
+qint16 VecsDevice::gyroZ() const
+{
+    return m_gyroZ;
+}
+
+qint16 VecsDevice::gyroY() const
+{
+    return m_gyroY;
+}
+
+qint16 VecsDevice::gyroX() const
+{
+    return m_gyroX;
+}
+
+qint16 VecsDevice::accelZ() const
+{
+    return m_accelZ;
+}
+
+qint16 VecsDevice::accelY() const
+{
+    return m_accelY;
+}
+
+qint16 VecsDevice::accelX() const
+{
+    return m_accelX;
+}
+
+VecsDevice::DeviceRole VecsDevice::role() const
+{
+    return m_role;
+}
+
+void VecsDevice::setRole(VecsDevice::DeviceRole role)
+{
+    if (role != m_role) {
+        m_role = role;
+        if (m_transport != nullptr)
+            updateMpuConfig();
+        emit roleChanged();
+    }
 }
 
 VecsDevice::AccelRange VecsDevice::accelRange() const
@@ -484,12 +667,77 @@ void VecsDevice::setMpuRate(int mpuRate)
     else if (mpuRate > 200)
         mpuRate = 200;
 
-    if (mpuRate != m_mpuRate) {
-        m_mpuRate = mpuRate;
+    if (mpuRate != m_targetRate) {
+        m_targetRate = mpuRate;
+        // В покое более высокая частота вступит в силу с началом движения
+        if (!m_adaptiveRate || m_activity.isMoving() || mpuRate < m_mpuRate)
+            applyMpuRate(mpuRate);
         emit mpuRateChanged();
     }
 }
 
+void VecsDevice::applyMpuRate(int rate)
+{
+    if (rate == m_mpuRate)
+        return;
+
+    m_mpuRate = rate;
+    m_features->setRate(m_mpuRate);
+    if (m_transport != nullptr) {
+        QMetaObject::invokeMethod(m_transport, "setMpuRate", Q_ARG(int, m_mpuRate));
+        updateConnectionParameters();
+    }
+}
+
+int VecsDevice::targetRate() const
+{
+    return m_targetRate;
+}
+
+bool VecsDevice::adaptiveRate() const
+{
+    return m_adaptiveRate;
+}
+
+void VecsDevice::setAdaptiveRate(bool adaptiveRate)
+{
+    if (adaptiveRate != m_adaptiveRate) {
+        m_adaptiveRate = adaptiveRate;
+        m_activity.reset();
+        if (!m_adaptiveRate && m_mpuRate != m_targetRate) {
+            applyMpuRate(m_targetRate);
+            emit mpuRateChanged();
+        }
+        emit adaptiveRateChanged();
+        emit activityChanged();
+    }
+}
+
+int VecsDevice::restRate() const
+{
+    return m_restRate;
+}
+
+void VecsDevice::setRestRate(int restRate)
+{
+    restRate = qBound(1, restRate, 200);
+    if (restRate != m_restRate) {
+        m_restRate = restRate;
+        emit adaptiveRateChanged();
+    }
+}
+
+bool VecsDevice::moving() const
+{
+    return !m_adaptiveRate || m_activity.isMoving();
+}
+
+void VecsDevice::setActivityThresholds(float gyro, float accel, int restDelay)
+{
+    m_activity.setThresholds(gyro, accel);
+    m_activity.setRestDelay(restDelay);
+}
+
 VecsDevice::ConnectionState VecsDevice::connectionState() const
 {
     return m_connectionState;
@@ -505,11 +753,24 @@ qint16 VecsDevice::rssi() const
     return m_rssi;
 }
 
+void VecsDevice::setRssi(qint16 rssi)
+{
+    if (rssi != m_rssi) {
+        m_rssi = rssi;
+        emit stateChanged();
+    }
+}
+
 QString VecsDevice::address() const
 {
     return m_address.toString();
 }
 
+QBluetoothAddress VecsDevice::bluetoothAddress() const
+{
+    return m_address;
+}
+
 quint32 VecsDevice::longClickCount() const
 {
     return m_longClickCount;
@@ -527,10 +788,66 @@ quint32 VecsDevice::singleClickCount() const
 
 int VecsDevice::interval() const
 {
-    return m_timer->interval();
+    return m_interval;
 }
 
 void VecsDevice::setInterval(int interval)
 {
-    m_timer->setInterval((interval < 1000) ? 1000 : interval);
+    m_interval = (interval < 1000) ? 1000 : interval;
+    if (m_scheduler != nullptr)
+        m_scheduler->setPeriod(m_batteryJob, m_interval);
+}
+
+void VecsDevice::setScheduler(VecsScheduler *scheduler)
+{
+    if (m_scheduler != nullptr)
+        m_scheduler->removeJobs(this);
+
+    m_scheduler = scheduler;
+    if (m_scheduler == nullptr || m_transport == nullptr)
+        return;
+
+    m_batteryJob = m_scheduler->addJob(this, m_interval, [=] { refreshBattery(); });
+    m_watchdogJob = m_scheduler->addJob(this, m_watchdogPeriod, [=] { checkStream(); });
+    m_scheduler->addJob(this, 1000, [=] { m_metrics->update(); });
+}
+
+void VecsDevice::setWatchdog(int stallTimeout, int period)
+{
+    m_stallTimeout = qint64(qMax(1, stallTimeout)) * 1000000;
+    m_watchdogPeriod = qMax(1, period);
+    if (m_scheduler != nullptr)
+        m_scheduler->setPeriod(m_watchdogJob, m_watchdogPeriod);
+}
+
+bool VecsDevice::stalled() const
+{
+    return m_stalled;
+}
+
+quint32 VecsDevice::stallCount() const
+{
+    return m_stallCount;
+}
+
+void VecsDevice::refreshBattery()
+{
+    if (m_connectionState == StateConnected)
+        QMetaObject::invokeMethod(m_transport, "refreshBattery");
+}
+
+void VecsDevice::checkStream()
+{
+    if (m_stalled || !m_mpuState || m_connectionState != StateConnected)
+        return;
+
+    // Отсчеты приходят пачками раз в интервал соединения, поэтому порог не меньше 10 периодов
+    const qint64 timeout = qMax(m_stallTimeout, qint64(10) * 1000000000 / m_mpuRate);
+    const qint64 silence = vecsTimestamp() - m_lastSampleTime;
+    if (silence > timeout) {
+        m_stalled = true;
+        m_stallCount++;
+        qDebug() << "device [" << address() << "] MPU stream stalled, no samples for" << silence / 1000000 << "ms";
+        emit stalledChanged();
+    }
 }
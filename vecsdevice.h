@@ -3,9 +3,18 @@
 
 #include <QObject>
 #include <QBluetoothAddress>
-#include <QLowEnergyController>
-#include <QLowEnergyService>
-#include <QTimer>
+#include "vecssamplering.h"
+#include "vecslatencyprobe.h"
+#include "vecssamplewindow.h"
+#include "vecssampleblock.h"
+#include "vecsfusion.h"
+#include "vecsfeatures.h"
+#include "vecsactivity.h"
+#include "vecsmetrics.h"
+
+class QThread;
+class VecsTransport;
+class VecsScheduler;
 
 class VecsDevice : public QObject
 {
@@ -21,6 +30,12 @@ class VecsDevice : public QObject
     Q_PROPERTY(bool mpuState READ mpuState NOTIFY mpuStateChanged)
 
     Q_PROPERTY(int mpuRate READ mpuRate WRITE setMpuRate NOTIFY mpuRateChanged)
+    // Адаптивная частота: в покое mpuRate ступенями снижается до restRate,
+    // с началом движения сразу возвращается к заданной targetRate
+    Q_PROPERTY(int targetRate READ targetRate NOTIFY mpuRateChanged)
+    Q_PROPERTY(bool adaptiveRate READ adaptiveRate WRITE setAdaptiveRate NOTIFY adaptiveRateChanged)
+    Q_PROPERTY(int restRate READ restRate WRITE setRestRate NOTIFY adaptiveRateChanged)
+    Q_PROPERTY(bool moving READ moving NOTIFY activityChanged)
     Q_PROPERTY(VecsDevice::GyroRange gyroRange READ gyroRange WRITE setGyroRange NOTIFY gyroRangeChanged)
     Q_PROPERTY(VecsDevice::AccelRange accelRange READ accelRange WRITE setAccelRange NOTIFY accelRangeChanged)
     Q_PROPERTY(VecsDevice::DeviceRole role READ role WRITE setRole NOTIFY roleChanged)
@@ -35,6 +50,50 @@ class VecsDevice : public QObject
 
     Q_PROPERTY(quint16 packetIndex READ packetIndex NOTIFY mpuDataRecieved)
 
+    // Последний отсчет в физических единицах: [x, y, z] в g и °/s
+    Q_PROPERTY(QVariantList accel READ accel NOTIFY mpuDataRecieved)
+    Q_PROPERTY(QVariantList gyro READ gyro NOTIFY mpuDataRecieved)
+
+    // Ориентация по данным VecsFusionEngine: кватернион [w, x, y, z] и углы [крен, тангаж, рыскание] в градусах
+    Q_PROPERTY(QVariantList orientation READ orientation NOTIFY orientationChanged)
+    Q_PROPERTY(QVariantList eulerAngles READ eulerAngles NOTIFY orientationChanged)
+
+    // Статистика потерь пакетов MPU, обновляется раз в секунду
+    Q_PROPERTY(double lossRate READ lossRate NOTIFY linkStatsChanged)
+    Q_PROPERTY(int longestGap READ longestGap NOTIFY linkStatsChanged)
+    Q_PROPERTY(quint64 receivedPackets READ receivedPackets NOTIFY linkStatsChanged)
+    Q_PROPERTY(quint64 expectedPackets READ expectedPackets NOTIFY linkStatsChanged)
+    Q_PROPERTY(quint64 duplicatePackets READ duplicatePackets NOTIFY linkStatsChanged)
+    Q_PROPERTY(quint64 reorderedPackets READ reorderedPackets NOTIFY linkStatsChanged)
+    Q_PROPERTY(quint64 stalePackets READ stalePackets NOTIFY linkStatsChanged)
+    Q_PROPERTY(int maxInterpolatedGap READ maxInterpolatedGap WRITE setMaxInterpolatedGap NOTIFY maxInterpolatedGapChanged)
+
+    // Агрегаты (последнее, минимум, максимум, среднее) за последний кадр
+    Q_PROPERTY(VecsSampleWindow *mpuWindow READ mpuWindow CONSTANT)
+    // Признаки движения по скользящему окну (RMS, размах, мощность тремора)
+    Q_PROPERTY(VecsFeatureEngine *features READ features CONSTANT)
+    // Счетчики и гистограммы канала связи, обновляются раз в секунду
+    Q_PROPERTY(VecsDeviceMetrics *metrics READ metrics CONSTANT)
+
+    // Задержки потока MPU в микросекундах, обновляются раз в секунду
+    Q_PROPERTY(int notificationLatency READ notificationLatency NOTIFY latencyChanged)
+    Q_PROPERTY(int notificationLatencyMax READ notificationLatencyMax NOTIFY latencyChanged)
+    Q_PROPERTY(int deliveryLatency READ deliveryLatency NOTIFY latencyChanged)
+    // Время от запуска MPU до первого пакета, мс
+    Q_PROPERTY(int startupTime READ startupTime NOTIFY latencyChanged)
+    // Последнее восстановление после обрыва связи, мс: от попытки переподключения
+    // и от момента обрыва до первого пакета MPU
+    Q_PROPERTY(int reconnectTime READ reconnectTime NOTIFY reconnectStatsChanged)
+    Q_PROPERTY(int outageTime READ outageTime NOTIFY reconnectStatsChanged)
+    // Согласованные параметры соединения BLE (0 - неизвестны): интервал, мс;
+    // число событий, которые датчик может пропустить; таймаут разрыва, мс
+    Q_PROPERTY(double connectionInterval READ connectionInterval NOTIFY connectionParametersChanged)
+    Q_PROPERTY(int connectionLatency READ connectionLatency NOTIFY connectionParametersChanged)
+    Q_PROPERTY(int supervisionTimeout READ supervisionTimeout NOTIFY connectionParametersChanged)
+    // Сторожевой таймер: MPU запущен, но отсчетов нет дольше stallTimeout
+    Q_PROPERTY(bool stalled READ stalled NOTIFY stalledChanged)
+    Q_PROPERTY(quint32 stallCount READ stallCount NOTIFY stalledChanged)
+
 public:        
     enum ConnectionState {
         StateDisconnected = 0,
@@ -75,15 +134,30 @@ public:
     Q_ENUM(DeviceRole)
 
     VecsDevice(QObject *parent = 0);
-    VecsDevice(const QBluetoothAddress &address, qint16 rssi = 0, QObject *parent = 0);
+    // Устройство становится владельцем транспорта
+    VecsDevice(VecsTransport *transport, qint16 rssi = 0, QThread *thread = nullptr, QObject *parent = 0);
     ~VecsDevice();
 
+    // Отключает транспорт и отсоединяет его от буфера отсчетов (вызывается и из деструктора);
+    // после возврата в samples() ничего не пишется
+    void close();
+
     QString address() const;
+    QBluetoothAddress bluetoothAddress() const;
     qint16 rssi() const;
+    // Уровень сигнала из повторного обнаружения при поиске
+    void setRssi(qint16 rssi);
     ConnectionState connectionState() const;
     int batteryLevel() const;
 
+    // Текущая частота потока (при адаптивной частоте может быть ниже заданной)
     int mpuRate() const;
+    int targetRate() const;
+    bool adaptiveRate() const;
+    int restRate() const;
+    bool moving() const;
+    // Пороги покоя: угловая скорость, °/s; ускорение без гравитации, g; время без движения, мс
+    void setActivityThresholds(float gyro, float accel, int restDelay);
     bool mpuState() const;
     GyroRange gyroRange() const;
     AccelRange accelRange() const;    
@@ -103,9 +177,48 @@ public:
     qint16 gyroY() const;
     qint16 gyroZ() const;
     quint16 packetIndex() const;    
+    QVariantList accel() const;
+    QVariantList gyro() const;
+    QVariantList orientation() const;
+    QVariantList eulerAngles() const;
+
+    // Полный поток декодированных пакетов MPU
+    const VecsSampleRing *samples() const;
+    VecsSampleWindow *mpuWindow() const;
+    VecsFeatureEngine *features() const;
+    VecsDeviceMetrics *metrics() const;
+
+    int notificationLatency() const;
+    int notificationLatencyMax() const;
+    int deliveryLatency() const;
+    int startupTime() const;
+    int reconnectTime() const;
+    int outageTime() const;
+
+    double connectionInterval() const;
+    int connectionLatency() const;
+    int supervisionTimeout() const;
+
+    double lossRate() const;
+    int longestGap() const;
+    quint64 receivedPackets() const;
+    quint64 expectedPackets() const;
+    quint64 duplicatePackets() const;
+    quint64 reorderedPackets() const;
+    quint64 stalePackets() const;
+    int maxInterpolatedGap() const;
 
     int maxReconnections() const;
 
+    // Периодические задачи устройства (опрос батареи, сторожевой таймер) выполняет общий
+    // планировщик; без него они не запускаются
+    void setScheduler(VecsScheduler *scheduler);
+    bool stalled() const;
+    quint32 stallCount() const;
+    // Минимальное время без отсчетов до срабатывания сторожевого таймера, мс
+    // (не меньше 10 периодов MPU) и период проверки, мс
+    void setWatchdog(int stallTimeout, int period);
+
 public slots:
     void connectToDevice();
     void disconnectFromDevice();
@@ -114,7 +227,10 @@ public slots:
     void mpuStart();
     void mpuStop();
 
+    // Задает частоту; работающий поток переключается без перезапуска, если датчик это умеет
     void setMpuRate(int mpuRate);
+    void setAdaptiveRate(bool adaptiveRate);
+    void setRestRate(int restRate);
     void setGyroRange(VecsDevice::GyroRange gyroRange);
     void setAccelRange(VecsDevice::AccelRange accelRange);
 
@@ -122,59 +238,71 @@ public slots:
     void setRole(VecsDevice::DeviceRole role);
 
     void setMaxReconnections(int maxReconnections);
+    void setReconnectBackoff(int baseDelay, int maxDelay);
+    void setMaxInterpolatedGap(int maxGap);
+
+    // Публикует накопленные за кадр данные MPU в свойства (вызывается VecsController раз в кадр)
+    void publishFrame();
+    void setOrientation(const VecsOrientation &orientation);
 
 signals:
     void stateChanged();
     void batteryLevelChanged(int level);
     void keyPressed(VecsDevice::ButtonClick type);
     void mpuStateChanged();
-    void mpuDataRecieved(const QByteArray &data);
+    // Новые данные MPU, не чаще одного раза за кадр
+    void mpuDataRecieved();
+    // Каждый принятый отсчет, для потребителей на C++
+    void mpuSampleReceived(const VecsSample &sample);
+    // Отсчеты одного пробуждения в физических единицах (g, °/s), для потребителей на C++
+    void mpuBlockReceived(const VecsMotionBlock &block);
     void mpuRateChanged();
+    void adaptiveRateChanged();
+    void activityChanged();
     void gyroRangeChanged();
     void accelRangeChanged();
     void roleChanged();
+    void latencyChanged();
+    // Первый отсчет MPU после запуска
+    void firstSampleReceived();
+    void reconnectStatsChanged();
+    void connectionParametersChanged();
+    void linkStatsChanged();
+    void maxInterpolatedGapChanged();
+    void orientationChanged();
+    void stalledChanged();
 
 private slots:
-    void deviceConnected();
-    void deviceDisconnected();
-    void serviceDiscoveryDone();
-    void controllerError(QLowEnergyController::Error error);
-
-    void timerJob();
-
-    void serviceStateChanged(QLowEnergyService::ServiceState state);
-    void characteristicNotification(const QLowEnergyCharacteristic &c, const QByteArray &v);
-    void characteristicRead(const QLowEnergyCharacteristic &c, const QByteArray &v);
-    void characteristicWritten(const QLowEnergyCharacteristic &c, const QByteArray &v);
+    void transportConnected();
+    void transportStateChanged(int state);
+    void transportBatteryLevelChanged(int level);
+    void transportKeyPressed(int type);
+    void transportMpuStateChanged(bool state);
+    void transportMpuFirstSample(qint64 elapsed);
+    void transportReconnected(qint64 reconnectTime, qint64 outageTime);
+    void transportConnectionParametersChanged(double interval, int latency, int supervisionTimeout);
+    void drainSamples();
 
 private:
-    QLowEnergyService *addService(const QBluetoothUuid &uuid);
-    bool enableNotifications(QLowEnergyService *service, const QBluetoothUuid &uuid, bool enable);
-    bool writeCharacteristic(QLowEnergyService *service, const QBluetoothUuid &uuid, quint8 value);
-    void parseMpuData(const QByteArray &data);
+    void updateMpuConfig();
+    void updateConnectionParameters();
+    void applyMpuRate(int rate);
+    void refreshBattery();
+    void checkStream();
+    void updateAdaptiveRate(bool activityUpdated);
 
 private:
-    // UUID наших проприетарных сервисов и характеристик, которые не входят в список стандартных сервисов Bluetooth
-    enum ServiceUuid {
-        // Сервис кнопки
-        KeyService          = 0xffe0,
-        CharKeyPressState   = 0xffe1,
-        CharKeyRequest      = 0xffe2,
-        // Сервис MPU (Motion Processor Unit)
-        MpuService          = 0xfff0,
-        CharAccelRange      = 0xfff1,
-        CharGyroRange       = 0xfff2,
-        CharMpuControl      = 0xfff3,
-        CharMpuData         = 0xfff4,
-        CharMpuTemp         = 0xfff5
-    };
-
     QBluetoothAddress m_address;
     qint16 m_rssi;        
 
     int m_batteryLevel;
 
     int m_mpuRate;
+    int m_targetRate;
+    bool m_adaptiveRate;
+    int m_restRate;
+    VecsActivityDetector m_activity;
+    qint64 m_rateStepTime;
     GyroRange m_gyroRange;
     AccelRange m_accelRange;
 
@@ -193,19 +321,42 @@ private:
     qint16 m_gyroZ;
     quint16 m_packetIndex;
 
+    VecsSampleRing m_samples;
+    VecsSampleReader m_reader;
+    VecsSampleWindow *m_window;
+    VecsFeatureEngine *m_features;
+    VecsDeviceMetrics *m_metrics;
+    VecsLatencyProbe m_latency;
+    VecsSampleBlock m_block;
+    VecsMotionBlock m_motion;
+    QVariantList m_accel;
+    QVariantList m_gyro;
+    VecsOrientation m_orientation;
+    int m_startupTime;
+    int m_reconnectTime;
+    int m_outageTime;
+    double m_connectionInterval;
+    int m_connectionLatency;
+    int m_supervisionTimeout;
+    qint64 m_linkStatsTime;
+    quint64 m_linkStatsExpected;
+    int m_maxInterpolatedGap;
+
     DeviceRole m_role;
 
-    bool m_normalDisconnect;
     int m_maxReconnections;
-    int m_reconnections;
-
-    QTimer *m_timer;
-    QLowEnergyController *m_controller;
-    QLowEnergyService *m_batteryService;
-    QLowEnergyService *m_keyService;
-    QLowEnergyService *m_mpuService;
-
-    bool m_charWriteFlag;
+    int m_interval;
+
+    VecsScheduler *m_scheduler;
+    int m_batteryJob;
+    int m_watchdogJob;
+    int m_watchdogPeriod;
+    qint64 m_stallTimeout;
+    qint64 m_lastSampleTime;
+    bool m_stalled;
+    quint32 m_stallCount;
+
+    VecsTransport *m_transport;
 };
 
 #endif // VECSDEVICE_H
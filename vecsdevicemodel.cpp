@@ -0,0 +1,97 @@
+#include "vecsdevicemodel.h"
+
+VecsDeviceModel::VecsDeviceModel(QObject *parent) :
+    QAbstractListModel(parent)
+{
+}
+
+int VecsDeviceModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_devices.size();
+}
+
+QVariant VecsDeviceModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_devices.size())
+        return QVariant();
+
+    VecsDevice *dev = m_devices.at(index.row());
+    switch (role) {
+    case DeviceRole:
+        return QVariant::fromValue<QObject *>(dev);
+    case Qt::DisplayRole:
+    case AddressRole:
+        return dev->address();
+    case RssiRole:
+        return dev->rssi();
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> VecsDeviceModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[DeviceRole] = "device";
+    roles[AddressRole] = "address";
+    roles[RssiRole] = "rssi";
+    return roles;
+}
+
+int VecsDeviceModel::count() const
+{
+    return m_devices.size();
+}
+
+QList<VecsDevice *> VecsDeviceModel::devices() const
+{
+    return m_devices;
+}
+
+VecsDevice *VecsDeviceModel::device(const QBluetoothAddress &address) const
+{
+    const int row = m_rows.value(address.toUInt64(), -1);
+    return (row >= 0) ? m_devices.at(row) : nullptr;
+}
+
+void VecsDeviceModel::append(VecsDevice *device)
+{
+    const quint64 key = device->bluetoothAddress().toUInt64();
+    if (m_rows.contains(key))
+        return;
+
+    const int row = m_devices.size();
+    beginInsertRows(QModelIndex(), row, row);
+    m_devices.append(device);
+    m_rows.insert(key, row);
+    endInsertRows();
+    emit countChanged();
+}
+
+void VecsDeviceModel::remove(VecsDevice *device)
+{
+    const int row = m_devices.indexOf(device);
+    if (row < 0)
+        return;
+
+    beginRemoveRows(QModelIndex(), row, row);
+    m_devices.removeAt(row);
+    m_rows.remove(device->bluetoothAddress().toUInt64());
+    // Строки ниже удаленной сдвигаются на одну вверх
+    for (int i = row; i < m_devices.size(); ++i)
+        m_rows[m_devices.at(i)->bluetoothAddress().toUInt64()] = i;
+    endRemoveRows();
+    emit countChanged();
+}
+
+void VecsDeviceModel::updateRssi(VecsDevice *device, qint16 rssi)
+{
+    const int row = m_devices.indexOf(device);
+    if (row < 0 || device->rssi() == rssi)
+        return;
+
+    device->setRssi(rssi);
+    const QModelIndex idx = index(row);
+    emit dataChanged(idx, idx, QVector<int>() << RssiRole);
+}
@@ -0,0 +1,50 @@
+#ifndef VECSDEVICEMODEL_H
+#define VECSDEVICEMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include "vecsdevice.h"
+
+/*
+ * Список устройств для QML. Строки добавляются, удаляются и обновляются
+ * по одной, поэтому ListView пересоздает только делегаты измененных строк.
+ * Устройство ищется по адресу через хэш, порядок строк - порядок добавления.
+ * Модель не владеет устройствами.
+ */
+class VecsDeviceModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum Roles {
+        DeviceRole = Qt::UserRole + 1,
+        AddressRole,
+        RssiRole
+    };
+
+    explicit VecsDeviceModel(QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const;
+    QList<VecsDevice *> devices() const;
+    VecsDevice *device(const QBluetoothAddress &address) const;
+
+    void append(VecsDevice *device);
+    void remove(VecsDevice *device);
+    // Обновляет уровень сигнала на месте, без пересоздания строки
+    void updateRssi(VecsDevice *device, qint16 rssi);
+
+signals:
+    void countChanged();
+
+private:
+    QList<VecsDevice *> m_devices;
+    // Адрес -> номер строки
+    QHash<quint64, int> m_rows;
+};
+
+#endif // VECSDEVICEMODEL_H
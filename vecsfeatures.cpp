@@ -0,0 +1,321 @@
+#include "vecsfeatures.h"
+#include <cmath>
+#include <cstring>
+
+static const float RadiansToDegrees = 180.0f / 3.14159265358979323846f;
+// Раз в столько шагов скользящие суммы пересчитываются по окну точно
+static const int ResyncHops = 16;
+
+VecsFeatureEngine::VecsFeatureEngine(QObject *parent) :
+    QObject(parent),
+    m_rate(100),
+    m_window(2.0),
+    m_hop(250),
+    m_bandLow(4.0),
+    m_bandHigh(12.0)
+{
+    qRegisterMetaType<VecsFeatures>();
+    configure();
+}
+
+int VecsFeatureEngine::rate() const
+{
+    return m_rate;
+}
+
+void VecsFeatureEngine::setRate(int rate)
+{
+    rate = qMax(1, rate);
+    if (rate != m_rate) {
+        const int oldRate = m_rate;
+        m_rate = rate;
+        // Адаптивная частота меняется на каждом переходе покой/движение:
+        // сброс окна оставил бы начало движения без признаков
+        resample(oldRate);
+    }
+}
+
+double VecsFeatureEngine::window() const
+{
+    return m_window;
+}
+
+void VecsFeatureEngine::setWindow(double window)
+{
+    window = qBound(0.1, window, 60.0);
+    if (window != m_window) {
+        m_window = window;
+        configure();
+        emit configChanged();
+    }
+}
+
+int VecsFeatureEngine::hop() const
+{
+    return m_hop;
+}
+
+void VecsFeatureEngine::setHop(int hop)
+{
+    hop = qMax(1, hop);
+    if (hop != m_hop) {
+        m_hop = hop;
+        m_hopSamples = qMax(1, m_rate * m_hop / 1000);
+        emit configChanged();
+    }
+}
+
+void VecsFeatureEngine::setTremorBand(double low, double high)
+{
+    m_bandLow = low;
+    m_bandHigh = qMax(low, high);
+}
+
+const VecsFeatures &VecsFeatureEngine::features() const
+{
+    return m_features;
+}
+
+void VecsFeatureEngine::configure()
+{
+    // Окно совпадает с размером БПФ, чтобы спектр считался без дополнения нулями
+    m_size = 16;
+    while (m_size < m_window * m_rate)
+        m_size <<= 1;
+    m_mask = quint64(m_size - 1);
+    m_hopSamples = qMax(1, m_rate * m_hop / 1000);
+
+    if (m_fft.size() != m_size)
+        m_fft = VecsFft(m_size);
+
+    for (int c = 0; c < ChannelCount; ++c) {
+        m_history[c].fill(0.0f, m_size);
+        m_min[c].positions.resize(m_size);
+        m_max[c].positions.resize(m_size);
+    }
+    m_frame.resize(m_size);
+    m_power.resize(m_size / 2 + 1);
+
+    reset();
+}
+
+void VecsFeatureEngine::reset()
+{
+    m_position = 0;
+    m_sinceHop = 0;
+    m_hopsSinceResync = 0;
+    m_lastTimestamp = 0;
+    for (int c = 0; c < ChannelCount; ++c) {
+        m_sum[c] = m_sumSquares[c] = 0.0;
+        m_min[c].head = m_min[c].count = 0;
+        m_max[c].head = m_max[c].count = 0;
+    }
+    memset(&m_features, 0, sizeof(m_features));
+}
+
+void VecsFeatureEngine::resample(int oldRate)
+{
+    // Окно в хронологическом порядке на прежней частоте
+    const int count = int(qMin(m_position, quint64(m_size)));
+    const int first = int((m_position - quint64(count)) & m_mask);
+    QVector<float> kept[ChannelCount];
+    for (int c = 0; c < ChannelCount; ++c) {
+        kept[c].resize(count);
+        for (int i = 0; i < count; ++i)
+            kept[c][i] = m_history[c].at((first + i) & int(m_mask));
+    }
+    const qint64 lastTimestamp = m_lastTimestamp;
+    const VecsFeatures features = m_features;
+
+    configure();
+    m_features = features;
+    if (count == 0)
+        return;
+
+    // Тот же отрезок времени на новой частоте, выровненный по последнему отсчету
+    const double step = double(oldRate) / m_rate;
+    const int resampled = qMin(m_size, int((count - 1) / step) + 1);
+    float values[ChannelCount];
+    for (int j = 0; j < resampled; ++j) {
+        const double x = (count - 1) - (resampled - 1 - j) * step;
+        const int i = qBound(0, int(x), count - 1);
+        const int next = qMin(i + 1, count - 1);
+        const float f = float(x - i);
+        for (int c = 0; c < ChannelCount; ++c)
+            values[c] = kept[c].at(i) + (kept[c].at(next) - kept[c].at(i)) * f;
+        pushSample(values);
+    }
+    m_lastTimestamp = lastTimestamp;
+}
+
+void VecsFeatureEngine::addBlock(const VecsMotionBlock &block)
+{
+    float values[ChannelCount];
+    for (int k = 0; k < block.size(); ++k) {
+        values[0] = block.accel[0].at(k);
+        values[1] = block.accel[1].at(k);
+        values[2] = block.accel[2].at(k);
+        values[3] = block.gyro[0].at(k);
+        values[4] = block.gyro[1].at(k);
+        values[5] = block.gyro[2].at(k);
+
+        // Наклон по направлению тяжести
+        values[6] = std::atan2(values[1], values[2]) * RadiansToDegrees;
+        values[7] = std::atan2(-values[0], std::sqrt(values[1] * values[1] + values[2] * values[2])) * RadiansToDegrees;
+
+        addSample(values, block.timestamp.at(k));
+    }
+}
+
+void VecsFeatureEngine::addSample(const float *values, qint64 timestamp)
+{
+    pushSample(values);
+    m_lastTimestamp = timestamp;
+
+    if (++m_sinceHop >= m_hopSamples && m_position >= quint64(m_size)) {
+        m_sinceHop = 0;
+        computeFeatures();
+    }
+}
+
+void VecsFeatureEngine::pushSample(const float *values)
+{
+    const quint64 slot = m_position & m_mask;
+    const bool full = m_position >= quint64(m_size);
+
+    for (int c = 0; c < ChannelCount; ++c) {
+        float *history = m_history[c].data();
+        const float v = values[c];
+
+        // Отсчет, выходящий из окна, вычитается из сумм
+        if (full) {
+            const float old = history[slot];
+            m_sum[c] -= old;
+            m_sumSquares[c] -= double(old) * old;
+        }
+        m_sum[c] += v;
+        m_sumSquares[c] += double(v) * v;
+
+        pushExtremum(&m_min[c], history, v, false);
+        pushExtremum(&m_max[c], history, v, true);
+        history[slot] = v;
+    }
+
+    m_position++;
+}
+
+void VecsFeatureEngine::pushExtremum(Extremum *queue, const float *history, float value, bool maximum)
+{
+    quint64 *positions = queue->positions.data();
+
+    // Позиция, выходящая из окна, может быть только в начале очереди
+    if (queue->count > 0 && positions[queue->head] + quint64(m_size) <= m_position) {
+        queue->head = (queue->head + 1) & int(m_mask);
+        queue->count--;
+    }
+
+    // Отсчеты, которые уже никогда не станут экстремумом, удаляются с конца
+    while (queue->count > 0) {
+        const int tail = (queue->head + queue->count - 1) & int(m_mask);
+        const float v = history[positions[tail] & m_mask];
+        if (maximum ? v > value : v < value)
+            break;
+        queue->count--;
+    }
+
+    positions[(queue->head + queue->count) & int(m_mask)] = m_position;
+    queue->count++;
+}
+
+void VecsFeatureEngine::computeFeatures()
+{
+    m_features.timestamp = m_lastTimestamp;
+
+    const int first = int((m_position - quint64(m_size)) & m_mask);
+    const double resolution = double(m_rate) / m_size;
+    const int bandLow = qMax(1, int(std::ceil(m_bandLow / resolution)));
+    const int bandHigh = qMin(m_size / 2, int(std::floor(m_bandHigh / resolution)));
+
+    // Вычитание из сумм накапливает ошибку округления: изредка пересчитываем их точно
+    const bool resync = ++m_hopsSinceResync >= ResyncHops;
+    if (resync)
+        m_hopsSinceResync = 0;
+
+    for (int c = 0; c < ChannelCount; ++c) {
+        const float *history = m_history[c].constData();
+        const float low = history[m_min[c].positions.at(m_min[c].head) & m_mask];
+        const float high = history[m_max[c].positions.at(m_max[c].head) & m_mask];
+
+        if (resync) {
+            double sum = 0.0, sumSquares = 0.0;
+            for (int i = 0; i < m_size; ++i) {
+                const float v = history[i];
+                sum += v;
+                sumSquares += double(v) * v;
+            }
+            m_sum[c] = sum;
+            m_sumSquares[c] = sumSquares;
+        }
+
+        if (c >= VecsFeatures::AxisCount) {
+            m_features.rangeOfMotion[c - VecsFeatures::AxisCount] = high - low;
+            continue;
+        }
+
+        m_features.rms[c] = float(std::sqrt(qMax(0.0, m_sumSquares[c]) / m_size));
+        m_features.range[c] = high - low;
+
+        // Окно в хронологическом порядке для БПФ; постоянная составляющая
+        // (тяжесть, смещение нуля гироскопа) в спектр не попадает
+        const float mean = float(m_sum[c] / m_size);
+        for (int i = 0; i < m_size; ++i)
+            m_frame[i] = history[(first + i) & int(m_mask)] - mean;
+        m_fft.powerSpectrum(m_frame.constData(), m_power.data());
+
+        float power = 0.0f;
+        int peak = bandLow;
+        for (int k = bandLow; k <= bandHigh; ++k) {
+            power += m_power.at(k);
+            if (m_power.at(k) > m_power.at(peak))
+                peak = k;
+        }
+        m_features.tremorPower[c] = power;
+        m_features.tremorFrequency[c] = (bandHigh >= bandLow) ? float(peak * resolution) : 0.0f;
+    }
+
+    emit featuresUpdated(m_features);
+    emit updated();
+}
+
+static QVariantList toList(const float *values, int count)
+{
+    QVariantList list;
+    for (int i = 0; i < count; ++i)
+        list << values[i];
+    return list;
+}
+
+QVariantList VecsFeatureEngine::rms() const
+{
+    return toList(m_features.rms, VecsFeatures::AxisCount);
+}
+
+QVariantList VecsFeatureEngine::range() const
+{
+    return toList(m_features.range, VecsFeatures::AxisCount);
+}
+
+QVariantList VecsFeatureEngine::rangeOfMotion() const
+{
+    return toList(m_features.rangeOfMotion, 2);
+}
+
+QVariantList VecsFeatureEngine::tremorPower() const
+{
+    return toList(m_features.tremorPower, VecsFeatures::AxisCount);
+}
+
+QVariantList VecsFeatureEngine::tremorFrequency() const
+{
+    return toList(m_features.tremorFrequency, VecsFeatures::AxisCount);
+}
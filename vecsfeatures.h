@@ -0,0 +1,126 @@
+#ifndef VECSFEATURES_H
+#define VECSFEATURES_H
+
+#include <QObject>
+#include <QVariantList>
+#include <QVector>
+#include "vecssampleblock.h"
+#include "vecsfft.h"
+
+// Признаки движения за одно окно (физические единицы: g, °/s, градусы)
+struct VecsFeatures
+{
+    enum { AxisCount = 6 };     // accelX, accelY, accelZ, gyroX, gyroY, gyroZ
+
+    qint64 timestamp;                   // Время последнего отсчета окна, нс
+    float rms[AxisCount];
+    float range[AxisCount];             // Размах (максимум - минимум)
+    float rangeOfMotion[2];             // Размах наклона по акселерометру: крен, тангаж
+    float tremorPower[AxisCount];       // Средний квадрат в полосе тремора
+    float tremorFrequency[AxisCount];   // Частота максимума спектра в полосе тремора, Гц
+};
+
+Q_DECLARE_METATYPE(VecsFeatures)
+
+/*
+ * Признаки движения по скользящему окну для одного устройства.
+ * Суммы и экстремумы окна обновляются за O(1) на отсчет (суммы со сдвигом,
+ * монотонные очереди для минимума и максимума); RMS и среднее берутся из сумм.
+ * Раз в hop отсчетов через общий план БПФ проходят только оси (мощность в полосе
+ * тремора), а раз в несколько шагов суммы пересчитываются по окну точно, чтобы
+ * не накапливалась ошибка округления.
+ */
+class VecsFeatureEngine : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QVariantList rms READ rms NOTIFY updated)
+    Q_PROPERTY(QVariantList range READ range NOTIFY updated)
+    Q_PROPERTY(QVariantList rangeOfMotion READ rangeOfMotion NOTIFY updated)
+    Q_PROPERTY(QVariantList tremorPower READ tremorPower NOTIFY updated)
+    Q_PROPERTY(QVariantList tremorFrequency READ tremorFrequency NOTIFY updated)
+    Q_PROPERTY(double window READ window WRITE setWindow NOTIFY configChanged)
+    Q_PROPERTY(int hop READ hop WRITE setHop NOTIFY configChanged)
+
+public:
+    explicit VecsFeatureEngine(QObject *parent = 0);
+
+    // Частота отсчетов, Гц; при смене частоты накопленное окно пересчитывается
+    // на новую частоту (линейная интерполяция), а не начинается заново
+    int rate() const;
+    void setRate(int rate);
+    // Длина окна, с (округляется вверх до степени двойки отсчетов)
+    double window() const;
+    void setWindow(double window);
+    // Шаг обновления признаков, мс
+    int hop() const;
+    void setHop(int hop);
+    // Полоса тремора, Гц
+    void setTremorBand(double low, double high);
+
+    const VecsFeatures &features() const;
+
+    QVariantList rms() const;
+    QVariantList range() const;
+    QVariantList rangeOfMotion() const;
+    QVariantList tremorPower() const;
+    QVariantList tremorFrequency() const;
+
+public slots:
+    void addBlock(const VecsMotionBlock &block);
+    void reset();
+
+signals:
+    void featuresUpdated(const VecsFeatures &features);
+    void updated();
+    void configChanged();
+
+private:
+    // Каналы: 6 осей и наклон (крен, тангаж)
+    enum { ChannelCount = VecsFeatures::AxisCount + 2 };
+
+    // Монотонная очередь позиций отсчетов для экстремума окна
+    struct Extremum {
+        QVector<quint64> positions;
+        int head;
+        int count;
+    };
+
+    void configure();
+    void resample(int oldRate);
+    void addSample(const float *values, qint64 timestamp);
+    void pushSample(const float *values);
+    void pushExtremum(Extremum *queue, const float *history, float value, bool maximum);
+    void computeFeatures();
+
+private:
+    int m_rate;
+    double m_window;
+    int m_hop;
+    double m_bandLow;
+    double m_bandHigh;
+
+    int m_size;
+    quint64 m_mask;
+    int m_hopSamples;
+    VecsFft m_fft;
+
+    quint64 m_position;
+    int m_sinceHop;
+    int m_hopsSinceResync;
+    qint64 m_lastTimestamp;
+
+    // История каналов (кольцевые буферы размера окна) и суммы окна
+    QVector<float> m_history[ChannelCount];
+    double m_sum[ChannelCount];
+    double m_sumSquares[ChannelCount];
+    Extremum m_min[ChannelCount];
+    Extremum m_max[ChannelCount];
+
+    QVector<float> m_frame;
+    QVector<float> m_power;
+
+    VecsFeatures m_features;
+};
+
+#endif // VECSFEATURES_H
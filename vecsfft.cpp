@@ -0,0 +1,78 @@
+#include "vecsfft.h"
+#include <cmath>
+
+static const double Pi = 3.14159265358979323846;
+
+VecsFft::VecsFft(int size)
+{
+    m_size = 2;
+    while (m_size < size)
+        m_size <<= 1;
+
+    int bits = 0;
+    while ((1 << bits) < m_size)
+        bits++;
+
+    m_reverse.resize(m_size);
+    for (int i = 0; i < m_size; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        m_reverse[i] = r;
+    }
+
+    m_twiddle.resize(m_size / 2);
+    for (int k = 0; k < m_size / 2; ++k)
+        m_twiddle[k] = std::polar(1.0f, float(-2.0 * Pi * k / m_size));
+
+    double energy = 0.0;
+    m_window.resize(m_size);
+    for (int i = 0; i < m_size; ++i) {
+        m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * Pi * i / m_size));
+        energy += double(m_window[i]) * m_window[i];
+    }
+    // По теореме Парсеваля с поправкой на энергию окна
+    m_norm = float(1.0 / (m_size * energy));
+
+    m_buffer.resize(m_size);
+}
+
+int VecsFft::size() const
+{
+    return m_size;
+}
+
+void VecsFft::powerSpectrum(const float *input, float *power)
+{
+    std::complex<float> *buffer = m_buffer.data();
+    for (int i = 0; i < m_size; ++i)
+        buffer[m_reverse.at(i)] = std::complex<float>(input[i] * m_window.at(i), 0.0f);
+
+    transform();
+
+    const int half = m_size / 2;
+    for (int k = 0; k <= half; ++k) {
+        // Отрицательные частоты складываются с положительными
+        const float scale = (k == 0 || k == half) ? m_norm : 2.0f * m_norm;
+        power[k] = std::norm(buffer[k]) * scale;
+    }
+}
+
+void VecsFft::transform()
+{
+    // Итеративный алгоритм Кули-Тьюки по основанию 2, вход уже переставлен
+    std::complex<float> *buffer = m_buffer.data();
+    const std::complex<float> *twiddle = m_twiddle.constData();
+
+    for (int len = 2; len <= m_size; len <<= 1) {
+        const int half = len >> 1;
+        const int step = m_size / len;
+        for (int start = 0; start < m_size; start += len) {
+            for (int j = 0; j < half; ++j) {
+                const std::complex<float> t = twiddle[j * step] * buffer[start + j + half];
+                buffer[start + j + half] = buffer[start + j] - t;
+                buffer[start + j] += t;
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef VECSFFT_H
+#define VECSFFT_H
+
+#include <QVector>
+#include <complex>
+
+/*
+ * План БПФ фиксированного размера (степень двойки) для спектра вещественного сигнала.
+ * Таблицы перестановки, поворотные множители и окно Ханна вычисляются один раз
+ * в конструкторе, рабочий буфер переиспользуется: повторные вызовы не выделяют память.
+ */
+class VecsFft
+{
+public:
+    explicit VecsFft(int size = 256);
+
+    int size() const;
+
+    // Односторонний спектр мощности сигнала из size() отсчетов с окном Ханна:
+    // power[k], k = 0..size()/2, нормирован так, что сумма равна среднему квадрату сигнала
+    void powerSpectrum(const float *input, float *power);
+
+private:
+    void transform();
+
+private:
+    int m_size;
+    QVector<int> m_reverse;
+    QVector<std::complex<float> > m_twiddle;
+    QVector<float> m_window;
+    float m_norm;
+    QVector<std::complex<float> > m_buffer;
+};
+
+#endif // VECSFFT_H
@@ -0,0 +1,284 @@
+#include "vecsfusion.h"
+#include "vecsunits.h"
+#include <QMutexLocker>
+#include <cmath>
+
+// После паузы длиннее этой (с) ориентация заново оценивается по акселерометру
+static const float MaxStep = 0.1f;
+static const float RadiansToDegrees = 180.0f / 3.14159265358979323846f;
+
+VecsOrientation::VecsOrientation() :
+    w(1.0f),
+    x(0.0f),
+    y(0.0f),
+    z(0.0f)
+{
+}
+
+VecsOrientationFrame::VecsOrientationFrame() :
+    timestamp(0),
+    validMask(0)
+{
+}
+
+VecsFusionEngine::VecsFusionEngine(QObject *parent) :
+    QObject(parent),
+    m_beta(0.1f),
+    m_publishedMask(0),
+    m_resetMask(0),
+    m_initialized(0)
+{
+    qRegisterMetaType<VecsAlignedFrame>();
+    qRegisterMetaType<VecsOrientationFrame>();
+}
+
+void VecsFusionEngine::setStreamRanges(int stream, int accelRange, int gyroRange)
+{
+    if (stream < 0 || stream >= VecsStreamAligner::MaxStreams)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+
+    if (m_accelScale.size() <= stream) {
+        m_accelScale.resize(stream + 1);
+        m_gyroScale.resize(stream + 1);
+    }
+    // Модуль ускорения нормируется фильтром, важна только цена разряда гироскопа
+    m_accelScale[stream] = VecsUnits::accelScale(accelRange);
+    m_gyroScale[stream] = VecsUnits::gyroScale(gyroRange, VecsUnits::RadiansPerSecond);
+}
+
+void VecsFusionEngine::removeStream(int stream)
+{
+    if (stream < 0 || stream >= VecsStreamAligner::MaxStreams)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+
+    // Состояние фильтра принадлежит потоку выравнивания и сбрасывается там;
+    // до этого отсчеты потока (из уже собранных кадров) ориентацию не меняют
+    m_resetMask |= 1u << stream;
+    m_publishedMask &= ~(1u << stream);
+    if (stream < m_accelScale.size())
+        m_accelScale[stream] = m_gyroScale[stream] = 0.0f;
+}
+
+bool VecsFusionEngine::orientation(int stream, VecsOrientation *orientation) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (stream < 0 || stream >= m_published.size() || !(m_publishedMask & (1u << stream)))
+        return false;
+
+    *orientation = m_published.at(stream);
+    return true;
+}
+
+float VecsFusionEngine::beta() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_beta;
+}
+
+void VecsFusionEngine::setBeta(float beta)
+{
+    QMutexLocker locker(&m_mutex);
+    m_beta = qMax(0.0f, beta);
+}
+
+void VecsFusionEngine::eulerAngles(const VecsOrientation &q, float *roll, float *pitch, float *yaw)
+{
+    *roll = std::atan2(2.0f * (q.w * q.x + q.y * q.z), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * RadiansToDegrees;
+    *pitch = std::asin(qBound(-1.0f, 2.0f * (q.w * q.y - q.z * q.x), 1.0f)) * RadiansToDegrees;
+    *yaw = std::atan2(2.0f * (q.w * q.z + q.x * q.y), 1.0f - 2.0f * (q.y * q.y + q.z * q.z)) * RadiansToDegrees;
+}
+
+void VecsFusionEngine::processFrame(const VecsAlignedFrame &frame)
+{
+    const int count = frame.samples.size();
+    if (count == 0)
+        return;
+    resize(count);
+
+    float beta;
+    {
+        QMutexLocker locker(&m_mutex);
+        beta = m_beta;
+
+        // Удаленные потоки: номер может быть уже занят новым датчиком
+        if (m_resetMask != 0) {
+            for (int i = 0; i < m_q0.size(); ++i) {
+                if (m_resetMask & (1u << i)) {
+                    m_q0[i] = 1.0f;
+                    m_q1[i] = m_q2[i] = m_q3[i] = 0.0f;
+                    m_lastTime[i] = 0;
+                }
+            }
+            m_initialized &= ~m_resetMask;
+            m_resetMask = 0;
+        }
+
+        // Перевод в физические единицы с ценой разряда каждого потока
+        for (int i = 0; i < count; ++i) {
+            const VecsSample &s = frame.samples.at(i);
+            const bool valid = (frame.validMask & (1u << i)) && i < m_accelScale.size();
+            const float a = valid ? m_accelScale.at(i) : 0.0f;
+            const float g = valid ? m_gyroScale.at(i) : 0.0f;
+
+            m_ax[i] = s.accel[0] * a;
+            m_ay[i] = s.accel[1] * a;
+            m_az[i] = s.accel[2] * a;
+            m_gx[i] = s.gyro[0] * g;
+            m_gy[i] = s.gyro[1] * g;
+            m_gz[i] = s.gyro[2] * g;
+
+            if (!valid) {
+                m_dt[i] = 0.0f;
+                continue;
+            }
+
+            // Новый датчик или долгая пауза: начальная ориентация по вектору тяжести
+            const float dt = float(s.timestamp - m_lastTime.at(i)) * 1e-9f;
+            m_lastTime[i] = s.timestamp;
+            if (!(m_initialized & (1u << i)) || dt <= 0.0f || dt > MaxStep) {
+                initialize(i);
+                m_dt[i] = 0.0f;
+            } else {
+                m_dt[i] = dt;
+            }
+        }
+    }
+
+    update(count, beta);
+
+    VecsOrientationFrame result;
+    result.timestamp = frame.timestamp;
+    result.validMask = frame.validMask & m_initialized;
+    result.orientation.resize(count);
+    for (int i = 0; i < count; ++i) {
+        VecsOrientation &q = result.orientation[i];
+        q.w = m_q0.at(i);
+        q.x = m_q1.at(i);
+        q.y = m_q2.at(i);
+        q.z = m_q3.at(i);
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_published.size() < count)
+            m_published.resize(count);
+        for (int i = 0; i < count; ++i) {
+            if (result.validMask & (1u << i))
+                m_published[i] = result.orientation.at(i);
+        }
+        m_publishedMask |= result.validMask;
+    }
+
+    emit orientationFrame(result);
+}
+
+void VecsFusionEngine::resize(int count)
+{
+    if (m_q0.size() >= count)
+        return;
+
+    const int old = m_q0.size();
+    m_q0.resize(count);
+    m_q1.resize(count);
+    m_q2.resize(count);
+    m_q3.resize(count);
+    m_lastTime.resize(count);
+    m_ax.resize(count);
+    m_ay.resize(count);
+    m_az.resize(count);
+    m_gx.resize(count);
+    m_gy.resize(count);
+    m_gz.resize(count);
+    m_dt.resize(count);
+
+    for (int i = old; i < count; ++i) {
+        m_q0[i] = 1.0f;
+        m_q1[i] = m_q2[i] = m_q3[i] = 0.0f;
+        m_lastTime[i] = 0;
+    }
+}
+
+void VecsFusionEngine::initialize(int i)
+{
+    const float ax = m_ax.at(i);
+    const float ay = m_ay.at(i);
+    const float az = m_az.at(i);
+    if (ax == 0.0f && ay == 0.0f && az == 0.0f)
+        return;
+
+    // Крен и тангаж по направлению тяжести, рыскание неизвестно и принимается нулевым
+    const float roll = std::atan2(ay, az);
+    const float pitch = std::atan2(-ax, std::sqrt(ay * ay + az * az));
+    const float cr = std::cos(roll * 0.5f), sr = std::sin(roll * 0.5f);
+    const float cp = std::cos(pitch * 0.5f), sp = std::sin(pitch * 0.5f);
+
+    m_q0[i] = cr * cp;
+    m_q1[i] = sr * cp;
+    m_q2[i] = cr * sp;
+    m_q3[i] = -sr * sp;
+    m_initialized |= 1u << i;
+}
+
+void VecsFusionEngine::update(int count, float beta)
+{
+    float *q0 = m_q0.data();
+    float *q1 = m_q1.data();
+    float *q2 = m_q2.data();
+    float *q3 = m_q3.data();
+    const float *ax = m_ax.constData();
+    const float *ay = m_ay.constData();
+    const float *az = m_az.constData();
+    const float *gx = m_gx.constData();
+    const float *gy = m_gy.constData();
+    const float *gz = m_gz.constData();
+    const float *dt = m_dt.constData();
+
+    // Шаг фильтра Маджвика (вариант IMU) для всех датчиков сразу; условия записаны
+    // выбором значения, чтобы компилятор мог векторизовать цикл
+    for (int i = 0; i < count; ++i) {
+        const float w = q0[i], x = q1[i], y = q2[i], z = q3[i];
+
+        // Производная кватерниона по показаниям гироскопа
+        float dw = 0.5f * (-x * gx[i] - y * gy[i] - z * gz[i]);
+        float dx = 0.5f * (w * gx[i] + y * gz[i] - z * gy[i]);
+        float dy = 0.5f * (w * gy[i] - x * gz[i] + z * gx[i]);
+        float dz = 0.5f * (w * gz[i] + x * gy[i] - y * gx[i]);
+
+        // Нормированный вектор ускорения (нулевой, если данных нет)
+        const float an = ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i];
+        const float ar = an > 0.0f ? 1.0f / std::sqrt(an) : 0.0f;
+        const float nx = ax[i] * ar, ny = ay[i] * ar, nz = az[i] * ar;
+
+        // Градиент целевой функции (отклонение предсказанной тяжести от измеренной)
+        const float ww = w * w, xx = x * x, yy = y * y, zz = z * z;
+        float s0 = 4.0f * w * yy + 2.0f * y * nx + 4.0f * w * xx - 2.0f * x * ny;
+        float s1 = 4.0f * x * zz - 2.0f * z * nx + 4.0f * ww * x - 2.0f * w * ny - 4.0f * x
+                 + 8.0f * x * xx + 8.0f * x * yy + 4.0f * x * nz;
+        float s2 = 4.0f * ww * y + 2.0f * w * nx + 4.0f * y * zz - 2.0f * z * ny - 4.0f * y
+                 + 8.0f * y * xx + 8.0f * y * yy + 4.0f * y * nz;
+        float s3 = 4.0f * xx * z - 2.0f * x * nx + 4.0f * yy * z - 2.0f * y * ny;
+
+        const float sn = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        const float step = (an > 0.0f && sn > 0.0f) ? beta / std::sqrt(sn) : 0.0f;
+        dw -= step * s0;
+        dx -= step * s1;
+        dy -= step * s2;
+        dz -= step * s3;
+
+        const float nw = w + dw * dt[i];
+        const float nx1 = x + dx * dt[i];
+        const float ny1 = y + dy * dt[i];
+        const float nz1 = z + dz * dt[i];
+
+        const float qr = 1.0f / std::sqrt(nw * nw + nx1 * nx1 + ny1 * ny1 + nz1 * nz1);
+        q0[i] = nw * qr;
+        q1[i] = nx1 * qr;
+        q2[i] = ny1 * qr;
+        q3[i] = nz1 * qr;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef VECSFUSION_H
+#define VECSFUSION_H
+
+#include <QObject>
+#include <QMutex>
+#include <QVector>
+#include "vecsstreamaligner.h"
+
+// Ориентация датчика: единичный кватернион (поворот из системы датчика в мировую)
+struct VecsOrientation
+{
+    VecsOrientation();
+
+    float w;
+    float x;
+    float y;
+    float z;
+};
+
+Q_DECLARE_TYPEINFO(VecsOrientation, Q_PRIMITIVE_TYPE);
+
+// Ориентации всех потоков на момент кадра выравнивания
+struct VecsOrientationFrame
+{
+    VecsOrientationFrame();
+
+    qint64 timestamp;
+    quint32 validMask;                          // Бит i установлен, если ориентация потока i обновлена
+    QVector<VecsOrientation> orientation;       // Индекс - номер потока VecsStreamAligner
+};
+
+Q_DECLARE_METATYPE(VecsOrientationFrame)
+
+/*
+ * Оценка ориентации всех датчиков фильтром Маджвика (акселерометр + гироскоп).
+ * Вход - выровненные кадры VecsStreamAligner, поэтому один проход обновляет все датчики.
+ * Состояние хранится в виде структуры массивов (по массиву на компоненту кватерниона),
+ * а цикл обновления не содержит ветвлений: отсутствующие в кадре датчики обрабатываются
+ * с нулевым шагом времени. Объект работает в потоке выравнивания.
+ *
+ * Из каждого потока в кадр попадает один отсчет, поэтому фильтр видит поток,
+ * прореженный до частоты кадров выравнивания; частота кадров по умолчанию
+ * (alignment/fps = 200) равна максимальной частоте MPU.
+ */
+class VecsFusionEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VecsFusionEngine(QObject *parent = 0);
+
+    // Потокобезопасны; stream - номер потока VecsStreamAligner
+    void setStreamRanges(int stream, int accelRange, int gyroRange);
+    // Вызывается вместе с VecsStreamAligner::removeStream(): номер потока может
+    // достаться другому датчику, который начнет оценку ориентации заново
+    void removeStream(int stream);
+    bool orientation(int stream, VecsOrientation *orientation) const;
+
+    // Коэффициент коррекции по акселерометру (больше - быстрее, но шумнее)
+    float beta() const;
+    void setBeta(float beta);
+
+    // Углы Эйлера (крен, тангаж, рыскание) в градусах
+    static void eulerAngles(const VecsOrientation &q, float *roll, float *pitch, float *yaw);
+
+public slots:
+    void processFrame(const VecsAlignedFrame &frame);
+
+signals:
+    // Ориентации после каждого кадра, для потребителей на C++
+    void orientationFrame(const VecsOrientationFrame &frame);
+
+private:
+    void resize(int count);
+    void initialize(int i);
+    void update(int count, float beta);
+
+private:
+    mutable QMutex m_mutex;
+    QVector<float> m_accelScale;
+    QVector<float> m_gyroScale;
+    float m_beta;
+    // Последние ориентации для чтения из других потоков
+    QVector<VecsOrientation> m_published;
+    quint32 m_publishedMask;
+    // Потоки, состояние которых сбрасывается в начале следующего кадра
+    quint32 m_resetMask;
+
+    // Состояние фильтра (только поток выравнивания)
+    QVector<float> m_q0;
+    QVector<float> m_q1;
+    QVector<float> m_q2;
+    QVector<float> m_q3;
+    QVector<qint64> m_lastTime;
+    quint32 m_initialized;
+
+    // Входы текущего прохода
+    QVector<float> m_ax;
+    QVector<float> m_ay;
+    QVector<float> m_az;
+    QVector<float> m_gx;
+    QVector<float> m_gy;
+    QVector<float> m_gz;
+    QVector<float> m_dt;
+};
+
+#endif // VECSFUSION_H
@@ -0,0 +1,37 @@
+#include "vecsgattcache.h"
+#include <QMutexLocker>
+
+VecsGattCache::VecsGattCache()
+{
+}
+
+VecsGattCache *VecsGattCache::instance()
+{
+    static VecsGattCache cache;
+    return &cache;
+}
+
+QList<QBluetoothUuid> VecsGattCache::services(const QBluetoothAddress &address) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_layouts.value(address.toUInt64()).keys();
+}
+
+QList<QBluetoothUuid> VecsGattCache::characteristics(const QBluetoothAddress &address, const QBluetoothUuid &service) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_layouts.value(address.toUInt64()).value(service);
+}
+
+void VecsGattCache::store(const QBluetoothAddress &address, const QBluetoothUuid &service,
+                          const QList<QBluetoothUuid> &characteristics)
+{
+    QMutexLocker locker(&m_mutex);
+    m_layouts[address.toUInt64()].insert(service, characteristics);
+}
+
+void VecsGattCache::invalidate(const QBluetoothAddress &address)
+{
+    QMutexLocker locker(&m_mutex);
+    m_layouts.remove(address.toUInt64());
+}
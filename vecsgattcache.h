@@ -0,0 +1,42 @@
+#ifndef VECSGATTCACHE_H
+#define VECSGATTCACHE_H
+
+#include <QBluetoothAddress>
+#include <QBluetoothUuid>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+/*
+ * Кэш структуры GATT устройств (сервисы и их характеристики) по адресу.
+ * Общий для всех потоков сбора данных. Qt не позволяет подставить сохраненные
+ * дескрипторы ATT в QLowEnergyController, поэтому кэш используется как знание
+ * о том, какие сервисы есть на устройстве: при переподключении объекты сервисов
+ * создаются и запрашивают детали сразу по мере обнаружения, не дожидаясь конца
+ * полного обхода сервисов.
+ */
+class VecsGattCache
+{
+public:
+    static VecsGattCache *instance();
+
+    // Сервисы, для которых известна полная структура
+    QList<QBluetoothUuid> services(const QBluetoothAddress &address) const;
+    QList<QBluetoothUuid> characteristics(const QBluetoothAddress &address, const QBluetoothUuid &service) const;
+
+    void store(const QBluetoothAddress &address, const QBluetoothUuid &service,
+               const QList<QBluetoothUuid> &characteristics);
+    // Структура устройства изменилась (например, после обновления прошивки)
+    void invalidate(const QBluetoothAddress &address);
+
+private:
+    VecsGattCache();
+    Q_DISABLE_COPY(VecsGattCache)
+
+    typedef QHash<QBluetoothUuid, QList<QBluetoothUuid> > Layout;
+
+    mutable QMutex m_mutex;
+    QHash<quint64, Layout> m_layouts;
+};
+
+#endif // VECSGATTCACHE_H
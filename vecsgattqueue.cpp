@@ -0,0 +1,242 @@
+#include "vecsgattqueue.h"
+#include "vecssamplering.h"
+#include "vecstrace.h"
+#include <QDebug>
+
+// Имена типов команд (CommandType) для сообщений и трассировки
+static const char *const CommandNames[] = { "write", "write descriptor", "read" };
+
+VecsGattQueue::VecsGattQueue(QObject *parent) :
+    QObject(parent),
+    m_busy(false),
+    m_timer(new QTimer(this)),
+    m_counters(nullptr),
+    m_sentTime(0)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(2000);
+    connect(m_timer, &QTimer::timeout, this, &VecsGattQueue::commandTimeout);
+}
+
+VecsGattQueue::~VecsGattQueue()
+{
+    clear();
+}
+
+void VecsGattQueue::attach(QLowEnergyService *service)
+{
+    connect(service, &QLowEnergyService::characteristicWritten, this, &VecsGattQueue::characteristicWritten);
+    connect(service, &QLowEnergyService::descriptorWritten, this, &VecsGattQueue::descriptorWritten);
+    connect(service, &QLowEnergyService::characteristicRead, this, &VecsGattQueue::characteristicRead);
+    connect(service, static_cast<void(QLowEnergyService::*)(QLowEnergyService::ServiceError)>(&QLowEnergyService::error),
+            this, &VecsGattQueue::serviceError);
+}
+
+void VecsGattQueue::write(QLowEnergyService *service, const QBluetoothUuid &uuid, const QByteArray &value,
+                          const Callback &callback)
+{
+    enqueue({ WriteCharacteristic, service, uuid, value, callback });
+}
+
+void VecsGattQueue::writeDescriptor(QLowEnergyService *service, const QBluetoothUuid &uuid, const QByteArray &value,
+                                    const Callback &callback)
+{
+    enqueue({ WriteDescriptor, service, uuid, value, callback });
+}
+
+void VecsGattQueue::read(QLowEnergyService *service, const QBluetoothUuid &uuid, const Callback &callback)
+{
+    enqueue({ ReadCharacteristic, service, uuid, QByteArray(), callback });
+}
+
+void VecsGattQueue::clear()
+{
+    m_timer->stop();
+    m_busy = false;
+
+    // Обработчики могут добавлять новые команды, поэтому забираем очередь целиком
+    QQueue<Command> queue;
+    queue.swap(m_queue);
+    for (const auto& command : queue) {
+        if (command.callback)
+            command.callback(false, QByteArray());
+    }
+    updateDepth();
+}
+
+int VecsGattQueue::timeout() const
+{
+    return m_timer->interval();
+}
+
+void VecsGattQueue::setTimeout(int timeout)
+{
+    m_timer->setInterval(timeout);
+}
+
+int VecsGattQueue::pending() const
+{
+    return m_queue.size();
+}
+
+void VecsGattQueue::setCounters(VecsLinkCounters *counters)
+{
+    m_counters = counters;
+}
+
+void VecsGattQueue::updateDepth()
+{
+    if (m_counters == nullptr)
+        return;
+
+    m_counters->gattQueueDepth.store(m_queue.size());
+    if (m_queue.size() > m_counters->gattQueueMax.load())
+        m_counters->gattQueueMax.store(m_queue.size());
+}
+
+void VecsGattQueue::enqueue(const Command &command)
+{
+    m_queue.enqueue(command);
+    updateDepth();
+    if (!m_busy)
+        next();
+}
+
+void VecsGattQueue::next()
+{
+    while (!m_busy && !m_queue.isEmpty()) {
+        const Command &command = m_queue.head();
+
+        if (command.service == nullptr || command.service->state() != QLowEnergyService::ServiceDiscovered) {
+            emit commandFailed(describe(command) + ": service is not ready");
+            finish(false);
+            continue;
+        }
+
+        const QLowEnergyCharacteristic c = command.service->characteristic(command.uuid);
+        if (!c.isValid()) {
+            emit commandFailed(describe(command) + ": characteristic not found");
+            finish(false);
+            continue;
+        }
+
+        switch (command.type) {
+        case WriteCharacteristic:
+            // Запись без подтверждения не ждет ответа от устройства
+            if (c.properties() & QLowEnergyCharacteristic::WriteNoResponse) {
+                command.service->writeCharacteristic(c, command.value, QLowEnergyService::WriteWithoutResponse);
+                finish(true, command.value);
+                continue;
+            }
+            command.service->writeCharacteristic(c, command.value);
+            break;
+        case WriteDescriptor:
+        {
+            const QLowEnergyDescriptor desc = c.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration);
+            if (!desc.isValid()) {
+                emit commandFailed(describe(command) + ": configuration descriptor not found");
+                finish(false);
+                continue;
+            }
+            command.service->writeDescriptor(desc, command.value);
+            break;
+        }
+        case ReadCharacteristic:
+            command.service->readCharacteristic(c);
+            break;
+        }
+
+        // Одновременно в работе одна команда очереди, поэтому ее идентификатор - адрес очереди
+        VECS_TRACE_ASYNC_BEGIN("gatt", CommandNames[command.type], quintptr(this), command.uuid.toUInt16());
+        m_busy = true;
+        m_sentTime = vecsTimestamp();
+        m_timer->start();
+    }
+}
+
+void VecsGattQueue::finish(bool ok, QByteArray value)
+{
+    if (m_busy)
+        VECS_TRACE_ASYNC_END("gatt", CommandNames[m_queue.head().type], quintptr(this));
+
+    // Время ответа считается только для отправленных команд
+    if (m_counters != nullptr) {
+        m_counters->gattCommands.fetchAndAddRelaxed(1);
+        if (!ok)
+            m_counters->gattFailures.fetchAndAddRelaxed(1);
+        else if (m_busy)
+            m_counters->gattRoundTrip.add(quint64((vecsTimestamp() - m_sentTime) / 1000));
+    }
+
+    m_timer->stop();
+    m_busy = false;
+
+    const Command command = m_queue.dequeue();
+    updateDepth();
+    if (command.callback)
+        command.callback(ok, value);
+}
+
+bool VecsGattQueue::isCurrent(QLowEnergyService *service, CommandType type, const QBluetoothUuid &uuid) const
+{
+    if (!m_busy || m_queue.isEmpty())
+        return false;
+
+    const Command &command = m_queue.head();
+    return command.service == service && command.type == type && command.uuid == uuid;
+}
+
+QString VecsGattQueue::describe(const Command &command) const
+{
+    return QString("%1 (uuid: 0x%2)")
+            .arg(CommandNames[command.type])
+            .arg(command.uuid.toUInt16(), 4, 16, QLatin1Char('0'));
+}
+
+void VecsGattQueue::characteristicWritten(const QLowEnergyCharacteristic &c, const QByteArray &v)
+{
+    if (isCurrent(qobject_cast<QLowEnergyService *>(sender()), WriteCharacteristic, c.uuid())) {
+        finish(true, v);
+        next();
+    }
+}
+
+void VecsGattQueue::descriptorWritten(const QLowEnergyDescriptor &d, const QByteArray &v)
+{
+    Q_UNUSED(d)
+
+    // Дескриптор не знает свою характеристику, поэтому сверяем только сервис и тип команды
+    if (m_busy && !m_queue.isEmpty() && m_queue.head().type == WriteDescriptor
+            && m_queue.head().service == qobject_cast<QLowEnergyService *>(sender())) {
+        finish(true, v);
+        next();
+    }
+}
+
+void VecsGattQueue::characteristicRead(const QLowEnergyCharacteristic &c, const QByteArray &v)
+{
+    if (isCurrent(qobject_cast<QLowEnergyService *>(sender()), ReadCharacteristic, c.uuid())) {
+        finish(true, v);
+        next();
+    }
+}
+
+void VecsGattQueue::serviceError(QLowEnergyService::ServiceError error)
+{
+    if (!m_busy || m_queue.isEmpty() || m_queue.head().service != qobject_cast<QLowEnergyService *>(sender()))
+        return;
+
+    emit commandFailed(QString("%1: service error %2").arg(describe(m_queue.head())).arg(error));
+    finish(false);
+    next();
+}
+
+void VecsGattQueue::commandTimeout()
+{
+    if (!m_busy || m_queue.isEmpty())
+        return;
+
+    emit commandFailed(describe(m_queue.head()) + ": timeout");
+    finish(false);
+    next();
+}
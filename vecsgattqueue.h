@@ -0,0 +1,89 @@
+#ifndef VECSGATTQUEUE_H
+#define VECSGATTQUEUE_H
+
+#include <QObject>
+#include <QQueue>
+#include <QPointer>
+#include <QTimer>
+#include <QLowEnergyService>
+#include <functional>
+#include "vecsmetrics.h"
+
+/*
+ * Асинхронная очередь GATT-команд одного устройства.
+ * BLE допускает только один неподтвержденный запрос на соединение, поэтому команды
+ * выполняются строго по порядку, но без ожидания в цикле событий: следующая команда
+ * отправляется из обработчика завершения предыдущей. Для каждой команды можно задать
+ * обработчик завершения, который получит результат или ошибку (в т.ч. по таймауту).
+ */
+class VecsGattQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void(bool ok, const QByteArray &value)> Callback;
+
+    explicit VecsGattQueue(QObject *parent = 0);
+    ~VecsGattQueue();
+
+    // Подключает сигналы сервиса к очереди; вызывается сразу после createServiceObject()
+    void attach(QLowEnergyService *service);
+
+    void write(QLowEnergyService *service, const QBluetoothUuid &uuid, const QByteArray &value,
+               const Callback &callback = Callback());
+    void writeDescriptor(QLowEnergyService *service, const QBluetoothUuid &uuid, const QByteArray &value,
+                         const Callback &callback = Callback());
+    void read(QLowEnergyService *service, const QBluetoothUuid &uuid, const Callback &callback = Callback());
+
+    // Завершает все ожидающие команды с ошибкой (например, при разрыве связи)
+    void clear();
+
+    int timeout() const;
+    void setTimeout(int timeout);
+
+    int pending() const;
+
+    // Время ответа, ошибки и глубина очереди учитываются в counters
+    void setCounters(VecsLinkCounters *counters);
+
+signals:
+    void commandFailed(const QString &description);
+
+private slots:
+    void characteristicWritten(const QLowEnergyCharacteristic &c, const QByteArray &v);
+    void descriptorWritten(const QLowEnergyDescriptor &d, const QByteArray &v);
+    void characteristicRead(const QLowEnergyCharacteristic &c, const QByteArray &v);
+    void serviceError(QLowEnergyService::ServiceError error);
+    void commandTimeout();
+
+private:
+    enum CommandType {
+        WriteCharacteristic,
+        WriteDescriptor,
+        ReadCharacteristic
+    };
+
+    struct Command {
+        CommandType type;
+        QPointer<QLowEnergyService> service;
+        QBluetoothUuid uuid;
+        QByteArray value;
+        Callback callback;
+    };
+
+    void enqueue(const Command &command);
+    void next();
+    void finish(bool ok, QByteArray value = QByteArray());
+    void updateDepth();
+    bool isCurrent(QLowEnergyService *service, CommandType type, const QBluetoothUuid &uuid) const;
+    QString describe(const Command &command) const;
+
+private:
+    QQueue<Command> m_queue;
+    bool m_busy;
+    QTimer *m_timer;
+    VecsLinkCounters *m_counters;
+    qint64 m_sentTime;
+};
+
+#endif // VECSGATTQUEUE_H
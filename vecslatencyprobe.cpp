@@ -0,0 +1,101 @@
+#include "vecslatencyprobe.h"
+
+VecsLatencyProbe::VecsLatencyProbe() :
+    m_window(1000000000),
+    m_notificationLatency(0),
+    m_notificationLatencyMax(0),
+    m_deliveryLatency(0),
+    m_deliveryLatencyMax(0)
+{
+    reset();
+}
+
+void VecsLatencyProbe::reset()
+{
+    m_windowStart = -1;
+    m_rate = 0;
+    m_lastIndex = 0;
+    m_index = 0;
+    m_offsets.clear();
+    m_deliverySum = 0;
+    m_deliveryMax = 0;
+}
+
+void VecsLatencyProbe::setWindow(qint64 window)
+{
+    m_window = window;
+}
+
+bool VecsLatencyProbe::addSample(quint16 packetIndex, qint64 timestamp, qint64 consumedAt, int rate)
+{
+    if (rate <= 0)
+        return false;
+
+    // Смена частоты делает накопленные смещения несравнимыми
+    if (rate != m_rate || m_windowStart < 0) {
+        reset();
+        m_rate = rate;
+        m_windowStart = timestamp;
+        m_lastIndex = packetIndex;
+    }
+
+    // Разворачиваем 16-битный счетчик пакетов
+    m_index += quint16(packetIndex - m_lastIndex);
+    m_lastIndex = packetIndex;
+
+    const qint64 period = 1000000000 / m_rate;
+    m_offsets.append(timestamp - m_index * period);
+
+    const qint64 delivery = consumedAt - timestamp;
+    m_deliverySum += delivery;
+    m_deliveryMax = qMax(m_deliveryMax, delivery);
+
+    if (timestamp - m_windowStart < m_window)
+        return false;
+
+    qint64 minOffset = m_offsets.first();
+    for (qint64 offset : m_offsets)
+        minOffset = qMin(minOffset, offset);
+
+    qint64 sum = 0;
+    qint64 max = 0;
+    for (qint64 offset : m_offsets) {
+        sum += offset - minOffset;
+        max = qMax(max, offset - minOffset);
+    }
+
+    const int count = m_offsets.size();
+    m_notificationLatency = int(sum / count / 1000);
+    m_notificationLatencyMax = int(max / 1000);
+    m_deliveryLatency = int(m_deliverySum / count / 1000);
+    m_deliveryLatencyMax = int(m_deliveryMax / 1000);
+
+    // Новое окно начинается с текущего пакета
+    m_offsets.clear();
+    m_deliverySum = 0;
+    m_deliveryMax = 0;
+    m_index = 0;
+    m_windowStart = timestamp;
+
+    return true;
+}
+
+int VecsLatencyProbe::notificationLatency() const
+{
+    return m_notificationLatency;
+}
+
+int VecsLatencyProbe::notificationLatencyMax() const
+{
+    return m_notificationLatencyMax;
+}
+
+int VecsLatencyProbe::deliveryLatency() const
+{
+    return m_deliveryLatency;
+}
+
+int VecsLatencyProbe::deliveryLatencyMax() const
+{
+    return m_deliveryLatencyMax;
+}
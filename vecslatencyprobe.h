@@ -0,0 +1,52 @@
+#ifndef VECSLATENCYPROBE_H
+#define VECSLATENCYPROBE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+/*
+ * Оценка задержек потока MPU.
+ *
+ * Задержка обработки уведомлений: датчик отправляет пакеты строго с периодом 1/mpuRate,
+ * поэтому для пакета k величина (t_k - k * T) постоянна с точностью до задержек на
+ * стороне хоста. Минимум этой величины за окно принимается за нулевую задержку,
+ * отклонение от него - за время, которое уведомление ждало своей обработки.
+ *
+ * Задержка доставки: время от декодирования пакета до его чтения потребителем.
+ */
+class VecsLatencyProbe
+{
+public:
+    VecsLatencyProbe();
+
+    void reset();
+    void setWindow(qint64 window);
+
+    // Возвращает true, если окно закрыто и статистика обновлена
+    bool addSample(quint16 packetIndex, qint64 timestamp, qint64 consumedAt, int rate);
+
+    // Все значения в микросекундах
+    int notificationLatency() const;
+    int notificationLatencyMax() const;
+    int deliveryLatency() const;
+    int deliveryLatencyMax() const;
+
+private:
+    qint64 m_window;
+    qint64 m_windowStart;
+
+    int m_rate;
+    quint16 m_lastIndex;
+    qint64 m_index;
+    QVector<qint64> m_offsets;
+
+    qint64 m_deliverySum;
+    qint64 m_deliveryMax;
+
+    int m_notificationLatency;
+    int m_notificationLatencyMax;
+    int m_deliveryLatency;
+    int m_deliveryLatencyMax;
+};
+
+#endif // VECSLATENCYPROBE_H
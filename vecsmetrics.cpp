@@ -0,0 +1,304 @@
+#include "vecsmetrics.h"
+#include "vecssamplering.h"
+#include <cmath>
+
+VecsHistogram::VecsHistogram() :
+    m_sum(0)
+{
+}
+
+void VecsHistogram::add(quint64 value)
+{
+    // Номер корзины - число значащих бит значения
+    int bucket = 0;
+    while (value >> bucket && bucket < BucketCount - 1)
+        bucket++;
+
+    m_buckets[bucket].fetchAndAddRelaxed(1);
+    m_sum.fetchAndAddRelaxed(value);
+}
+
+VecsHistogram::Snapshot VecsHistogram::snapshot() const
+{
+    Snapshot s;
+    for (int i = 0; i < BucketCount; ++i)
+        s.buckets[i] = m_buckets[i].load();
+    s.sum = m_sum.load();
+    return s;
+}
+
+quint64 VecsHistogram::bucketLimit(int bucket)
+{
+    return (bucket <= 0) ? 0 : (quint64(1) << bucket) - 1;
+}
+
+quint64 VecsHistogram::Snapshot::count() const
+{
+    quint64 n = 0;
+    for (int i = 0; i < BucketCount; ++i)
+        n += buckets[i];
+    return n;
+}
+
+double VecsHistogram::Snapshot::mean() const
+{
+    const quint64 n = count();
+    return (n > 0) ? double(sum) / n : 0.0;
+}
+
+quint64 VecsHistogram::Snapshot::percentile(double q) const
+{
+    const quint64 n = count();
+    if (n == 0)
+        return 0;
+
+    const quint64 rank = quint64(std::ceil(q * n));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return bucketLimit(i);
+    }
+    return bucketLimit(BucketCount - 1);
+}
+
+VecsHistogram::Snapshot VecsHistogram::Snapshot::since(const Snapshot &previous) const
+{
+    Snapshot s;
+    for (int i = 0; i < BucketCount; ++i)
+        s.buckets[i] = buckets[i] - previous.buckets[i];
+    s.sum = sum - previous.sum;
+    return s;
+}
+
+VecsLinkCounters::VecsLinkCounters() :
+    notifications(0),
+    bytesReceived(0),
+    jitter(0),
+    gattCommands(0),
+    gattFailures(0),
+    gattQueueDepth(0),
+    gattQueueMax(0),
+    reconnects(0),
+    outageMax(0),
+    m_lastNotification(-1),
+    m_lastInterval(-1)
+{
+}
+
+void VecsLinkCounters::addNotification(int bytes, qint64 timestamp)
+{
+    notifications.fetchAndAddRelaxed(1);
+    bytesReceived.fetchAndAddRelaxed(quint64(bytes));
+
+    if (m_lastNotification >= 0) {
+        const qint64 interval = (timestamp - m_lastNotification) / 1000;
+        interArrival.add(quint64(qMax<qint64>(0, interval)));
+
+        // Разброс по RFC 3550: J += (|D| - J) / 16, пишет только этот поток
+        if (m_lastInterval >= 0) {
+            const int j = jitter.load();
+            jitter.store(j + int((qAbs(interval - m_lastInterval) - j) / 16));
+        }
+        m_lastInterval = interval;
+    }
+    m_lastNotification = timestamp;
+}
+
+VecsDeviceMetrics::VecsDeviceMetrics(QObject *parent) :
+    QObject(parent),
+    m_counters(nullptr),
+    m_lastUpdate(0),
+    m_lastNotifications(0),
+    m_lastBytes(0),
+    m_notificationRate(0),
+    m_byteRate(0),
+    m_bytesReceived(0),
+    m_interArrival(0),
+    m_interArrivalP99(0),
+    m_jitter(0),
+    m_gattRoundTrip(0),
+    m_gattRoundTripP99(0),
+    m_gattFailures(0),
+    m_gattQueueDepth(0),
+    m_gattQueueMax(0),
+    m_backlogMax(0),
+    m_ringBacklog(0),
+    m_reconnects(0),
+    m_outageMean(0),
+    m_outageMax(0)
+{
+    m_lastInterArrival = VecsHistogram().snapshot();
+    m_lastRoundTrip = m_lastInterArrival;
+}
+
+void VecsDeviceMetrics::setCounters(const VecsLinkCounters *counters)
+{
+    m_counters = counters;
+    m_lastUpdate = vecsTimestamp();
+    if (m_counters != nullptr) {
+        m_lastNotifications = m_counters->notifications.load();
+        m_lastBytes = m_counters->bytesReceived.load();
+        m_lastInterArrival = m_counters->interArrival.snapshot();
+        m_lastRoundTrip = m_counters->gattRoundTrip.snapshot();
+    }
+}
+
+void VecsDeviceMetrics::addBacklog(int backlog)
+{
+    if (backlog > m_backlogMax)
+        m_backlogMax = backlog;
+}
+
+void VecsDeviceMetrics::update()
+{
+    m_ringBacklog = m_backlogMax;
+    m_backlogMax = 0;
+
+    if (m_counters == nullptr) {
+        emit updated();
+        return;
+    }
+
+    const qint64 now = vecsTimestamp();
+    const double elapsed = qMax<qint64>(1, now - m_lastUpdate) / 1e9;
+    m_lastUpdate = now;
+
+    const quint64 notifications = m_counters->notifications.load();
+    const quint64 bytes = m_counters->bytesReceived.load();
+    m_notificationRate = (notifications - m_lastNotifications) / elapsed;
+    m_byteRate = (bytes - m_lastBytes) / elapsed;
+    m_bytesReceived = bytes;
+    m_lastNotifications = notifications;
+    m_lastBytes = bytes;
+
+    // Квантили - по значениям за интервал, в мс
+    const VecsHistogram::Snapshot interArrival = m_counters->interArrival.snapshot();
+    const VecsHistogram::Snapshot arrivals = interArrival.since(m_lastInterArrival);
+    m_lastInterArrival = interArrival;
+    m_interArrival = arrivals.mean() / 1000.0;
+    m_interArrivalP99 = arrivals.percentile(0.99) / 1000.0;
+    m_jitter = m_counters->jitter.load() / 1000.0;
+
+    const VecsHistogram::Snapshot roundTrip = m_counters->gattRoundTrip.snapshot();
+    const VecsHistogram::Snapshot commands = roundTrip.since(m_lastRoundTrip);
+    m_lastRoundTrip = roundTrip;
+    if (commands.count() > 0) {
+        m_gattRoundTrip = commands.mean() / 1000.0;
+        m_gattRoundTripP99 = commands.percentile(0.99) / 1000.0;
+    }
+    m_gattFailures = m_counters->gattFailures.load();
+    m_gattQueueDepth = m_counters->gattQueueDepth.load();
+    m_gattQueueMax = m_counters->gattQueueMax.load();
+
+    m_reconnects = m_counters->reconnects.load();
+    m_outageMean = m_counters->outage.snapshot().mean();
+    m_outageMax = m_counters->outageMax.load();
+
+    emit updated();
+}
+
+double VecsDeviceMetrics::notificationRate() const
+{
+    return m_notificationRate;
+}
+
+double VecsDeviceMetrics::byteRate() const
+{
+    return m_byteRate;
+}
+
+quint64 VecsDeviceMetrics::bytesReceived() const
+{
+    return m_bytesReceived;
+}
+
+double VecsDeviceMetrics::interArrival() const
+{
+    return m_interArrival;
+}
+
+double VecsDeviceMetrics::interArrivalP99() const
+{
+    return m_interArrivalP99;
+}
+
+double VecsDeviceMetrics::jitter() const
+{
+    return m_jitter;
+}
+
+double VecsDeviceMetrics::gattRoundTrip() const
+{
+    return m_gattRoundTrip;
+}
+
+double VecsDeviceMetrics::gattRoundTripP99() const
+{
+    return m_gattRoundTripP99;
+}
+
+quint64 VecsDeviceMetrics::gattFailures() const
+{
+    return m_gattFailures;
+}
+
+int VecsDeviceMetrics::gattQueueDepth() const
+{
+    return m_gattQueueDepth;
+}
+
+int VecsDeviceMetrics::gattQueueMax() const
+{
+    return m_gattQueueMax;
+}
+
+int VecsDeviceMetrics::ringBacklog() const
+{
+    return m_ringBacklog;
+}
+
+int VecsDeviceMetrics::reconnects() const
+{
+    return m_reconnects;
+}
+
+double VecsDeviceMetrics::outageMean() const
+{
+    return m_outageMean;
+}
+
+double VecsDeviceMetrics::outageMax() const
+{
+    return m_outageMax;
+}
+
+QJsonObject VecsDeviceMetrics::toJson() const
+{
+    QJsonObject json;
+    json["notification_rate"] = m_notificationRate;
+    json["byte_rate"] = m_byteRate;
+    json["bytes_received"] = double(m_bytesReceived);
+    json["inter_arrival_ms"] = m_interArrival;
+    json["inter_arrival_p99_ms"] = m_interArrivalP99;
+    json["jitter_ms"] = m_jitter;
+    json["gatt_round_trip_ms"] = m_gattRoundTrip;
+    json["gatt_round_trip_p99_ms"] = m_gattRoundTripP99;
+    json["gatt_failures"] = double(m_gattFailures);
+    json["gatt_queue_depth"] = m_gattQueueDepth;
+    json["gatt_queue_max"] = m_gattQueueMax;
+    json["ring_backlog"] = m_ringBacklog;
+    json["reconnects"] = m_reconnects;
+    json["outage_mean_ms"] = m_outageMean;
+    json["outage_max_ms"] = m_outageMax;
+    return json;
+}
+
+QString VecsDeviceMetrics::toText(const QString &labels) const
+{
+    QString text;
+    const QJsonObject json = toJson();
+    for (auto it = json.constBegin(); it != json.constEnd(); ++it)
+        text += QString("vecs_%1{%2} %3\n").arg(it.key(), labels).arg(it.value().toDouble(), 0, 'g', 10);
+    return text;
+}
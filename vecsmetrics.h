@@ -0,0 +1,163 @@
+#ifndef VECSMETRICS_H
+#define VECSMETRICS_H
+
+#include <QObject>
+#include <QAtomicInteger>
+#include <QJsonObject>
+
+/*
+ * Гистограмма с корзинами по степеням двойки: корзина 0 - значение 0,
+ * корзина i - значения [2^(i-1), 2^i), последняя - все, что больше.
+ * add() - два атомарных сложения без блокировок; пишет один поток, читать можно из любого.
+ */
+class VecsHistogram
+{
+public:
+    enum { BucketCount = 28 };
+
+    struct Snapshot {
+        quint64 buckets[BucketCount];
+        quint64 sum;
+
+        quint64 count() const;
+        double mean() const;
+        // Верхняя граница корзины, в которую попадает квантиль q
+        quint64 percentile(double q) const;
+        // Значения, добавленные после previous
+        Snapshot since(const Snapshot &previous) const;
+    };
+
+    VecsHistogram();
+
+    void add(quint64 value);
+    Snapshot snapshot() const;
+
+    static quint64 bucketLimit(int bucket);
+
+private:
+    QAtomicInteger<quint64> m_buckets[BucketCount];
+    QAtomicInteger<quint64> m_sum;
+};
+
+/*
+ * Счетчики канала связи одного устройства. Пишет только транспорт в потоке сбора
+ * данных (несколько атомарных операций на уведомление), читать можно из любого потока.
+ * Все значения накапливаются за время жизни транспорта.
+ */
+struct VecsLinkCounters
+{
+    VecsLinkCounters();
+
+    // Учет уведомления; время - vecsTimestamp(), нс
+    void addNotification(int bytes, qint64 timestamp);
+
+    QAtomicInteger<quint64> notifications;
+    QAtomicInteger<quint64> bytesReceived;
+    VecsHistogram interArrival;         // Интервал между уведомлениями, мкс
+    QAtomicInt jitter;                  // Сглаженный разброс интервалов (RFC 3550), мкс
+
+    QAtomicInteger<quint64> gattCommands;
+    QAtomicInteger<quint64> gattFailures;
+    VecsHistogram gattRoundTrip;        // От отправки команды GATT до ответа, мкс
+    QAtomicInt gattQueueDepth;
+    QAtomicInt gattQueueMax;
+
+    QAtomicInt reconnects;              // Попытки переподключения
+    VecsHistogram outage;               // От обрыва связи до первого отсчета, мс
+    QAtomicInt outageMax;
+
+private:
+    qint64 m_lastNotification;
+    qint64 m_lastInterval;
+};
+
+/*
+ * Метрики устройства для QML и выгрузки: скорости и квантили за последний интервал
+ * update(), накопленные значения - с момента создания транспорта.
+ * Живет в потоке GUI; update() вызывается по расписанию VecsScheduler.
+ */
+class VecsDeviceMetrics : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(double notificationRate READ notificationRate NOTIFY updated)
+    Q_PROPERTY(double byteRate READ byteRate NOTIFY updated)
+    Q_PROPERTY(quint64 bytesReceived READ bytesReceived NOTIFY updated)
+    // Интервалы между уведомлениями и их разброс, мс
+    Q_PROPERTY(double interArrival READ interArrival NOTIFY updated)
+    Q_PROPERTY(double interArrivalP99 READ interArrivalP99 NOTIFY updated)
+    Q_PROPERTY(double jitter READ jitter NOTIFY updated)
+    // Время ответа на команды GATT, мс
+    Q_PROPERTY(double gattRoundTrip READ gattRoundTrip NOTIFY updated)
+    Q_PROPERTY(double gattRoundTripP99 READ gattRoundTripP99 NOTIFY updated)
+    Q_PROPERTY(quint64 gattFailures READ gattFailures NOTIFY updated)
+    Q_PROPERTY(int gattQueueDepth READ gattQueueDepth NOTIFY updated)
+    Q_PROPERTY(int gattQueueMax READ gattQueueMax NOTIFY updated)
+    // Наибольшее число непрочитанных отсчетов в буфере устройства за интервал
+    Q_PROPERTY(int ringBacklog READ ringBacklog NOTIFY updated)
+    Q_PROPERTY(int reconnects READ reconnects NOTIFY updated)
+    // Длительность перерывов связи, мс
+    Q_PROPERTY(double outageMean READ outageMean NOTIFY updated)
+    Q_PROPERTY(double outageMax READ outageMax NOTIFY updated)
+
+public:
+    explicit VecsDeviceMetrics(QObject *parent = 0);
+
+    void setCounters(const VecsLinkCounters *counters);
+    // Глубина очереди потребителя, вызывается перед чтением буфера
+    void addBacklog(int backlog);
+
+    double notificationRate() const;
+    double byteRate() const;
+    quint64 bytesReceived() const;
+    double interArrival() const;
+    double interArrivalP99() const;
+    double jitter() const;
+    double gattRoundTrip() const;
+    double gattRoundTripP99() const;
+    quint64 gattFailures() const;
+    int gattQueueDepth() const;
+    int gattQueueMax() const;
+    int ringBacklog() const;
+    int reconnects() const;
+    double outageMean() const;
+    double outageMax() const;
+
+    QJsonObject toJson() const;
+    // Строки "имя{labels} значение" в текстовом формате Prometheus
+    QString toText(const QString &labels) const;
+
+public slots:
+    void update();
+
+signals:
+    void updated();
+
+private:
+    const VecsLinkCounters *m_counters;
+    qint64 m_lastUpdate;
+
+    quint64 m_lastNotifications;
+    quint64 m_lastBytes;
+    VecsHistogram::Snapshot m_lastInterArrival;
+    VecsHistogram::Snapshot m_lastRoundTrip;
+
+    double m_notificationRate;
+    double m_byteRate;
+    quint64 m_bytesReceived;
+    double m_interArrival;
+    double m_interArrivalP99;
+    double m_jitter;
+    double m_gattRoundTrip;
+    double m_gattRoundTripP99;
+    quint64 m_gattFailures;
+    int m_gattQueueDepth;
+    int m_gattQueueMax;
+    int m_backlogMax;
+    int m_ringBacklog;
+    int m_reconnects;
+    double m_outageMean;
+    double m_outageMax;
+};
+
+#endif // VECSMETRICS_H
@@ -0,0 +1,104 @@
+#include "vecsmetricsexporter.h"
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+VecsMetricsExporter::VecsMetricsExporter(VecsDeviceModel *model, VecsScheduler *scheduler, QObject *parent) :
+    QObject(parent),
+    m_model(model),
+    m_scheduler(scheduler),
+    m_format(Json),
+    m_interval(5000),
+    m_job(0)
+{
+}
+
+void VecsMetricsExporter::setFileName(const QString &fileName)
+{
+    m_fileName = fileName;
+}
+
+void VecsMetricsExporter::setFormat(Format format)
+{
+    m_format = format;
+}
+
+void VecsMetricsExporter::setInterval(int interval)
+{
+    m_interval = qMax(100, interval);
+    if (m_job != 0)
+        m_scheduler->setPeriod(m_job, m_interval);
+}
+
+void VecsMetricsExporter::start()
+{
+    if (m_job == 0 && !m_fileName.isEmpty())
+        m_job = m_scheduler->addJob(this, m_interval, [=] { write(); });
+}
+
+void VecsMetricsExporter::stop()
+{
+    if (m_job != 0) {
+        m_scheduler->removeJob(m_job);
+        m_job = 0;
+    }
+}
+
+QByteArray VecsMetricsExporter::dump() const
+{
+    return (m_format == Json) ? dumpJson() : dumpText();
+}
+
+bool VecsMetricsExporter::write()
+{
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(dump()) < 0 || !file.commit()) {
+        emit error(QString("Can't write metrics to %1: %2").arg(m_fileName, file.errorString()));
+        return false;
+    }
+    return true;
+}
+
+QByteArray VecsMetricsExporter::dumpJson() const
+{
+    QJsonArray devices;
+    for (const auto& dev : m_model->devices()) {
+        QJsonObject json = dev->metrics()->toJson();
+        json["address"] = dev->address();
+        json["role"] = int(dev->role());
+        json["connection_state"] = int(dev->connectionState());
+        json["mpu_rate"] = dev->mpuRate();
+        json["loss_rate"] = dev->lossRate();
+        json["stalled"] = dev->stalled();
+        json["stall_count"] = double(dev->stallCount());
+        devices.append(json);
+    }
+
+    QJsonObject scheduler;
+    scheduler["jobs"] = m_scheduler->jobCount();
+    scheduler["deferred"] = double(m_scheduler->deferredJobs());
+
+    QJsonObject root;
+    root["timestamp"] = double(QDateTime::currentMSecsSinceEpoch());
+    root["devices"] = devices;
+    root["scheduler"] = scheduler;
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+QByteArray VecsMetricsExporter::dumpText() const
+{
+    QString text;
+    for (const auto& dev : m_model->devices()) {
+        const QString labels = QString("address=\"%1\"").arg(dev->address());
+        text += dev->metrics()->toText(labels);
+        text += QString("vecs_connection_state{%1} %2\n").arg(labels).arg(int(dev->connectionState()));
+        text += QString("vecs_mpu_rate{%1} %2\n").arg(labels).arg(dev->mpuRate());
+        text += QString("vecs_loss_rate{%1} %2\n").arg(labels).arg(dev->lossRate());
+        text += QString("vecs_stalled{%1} %2\n").arg(labels).arg(dev->stalled() ? 1 : 0);
+        text += QString("vecs_stall_count{%1} %2\n").arg(labels).arg(dev->stallCount());
+    }
+    text += QString("vecs_scheduler_jobs %1\n").arg(m_scheduler->jobCount());
+    text += QString("vecs_scheduler_deferred %1\n").arg(m_scheduler->deferredJobs());
+    return text.toUtf8();
+}
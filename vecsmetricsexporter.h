@@ -0,0 +1,55 @@
+#ifndef VECSMETRICSEXPORTER_H
+#define VECSMETRICSEXPORTER_H
+
+#include <QObject>
+#include "vecsdevicemodel.h"
+#include "vecsscheduler.h"
+
+/*
+ * Периодическая выгрузка метрик всех устройств в файл для локального сборщика:
+ * JSON или текстовый формат Prometheus. Файл заменяется целиком (QSaveFile),
+ * поэтому читатель никогда не видит его наполовину записанным.
+ * Запись выполняется по расписанию VecsScheduler в потоке GUI.
+ */
+class VecsMetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Json,
+        Text
+    };
+
+    VecsMetricsExporter(VecsDeviceModel *model, VecsScheduler *scheduler, QObject *parent = 0);
+
+    void setFileName(const QString &fileName);
+    void setFormat(Format format);
+    // Период выгрузки, мс
+    void setInterval(int interval);
+
+    // Текущее содержимое выгрузки
+    QByteArray dump() const;
+
+public slots:
+    void start();
+    void stop();
+    bool write();
+
+signals:
+    void error(const QString &message);
+
+private:
+    QByteArray dumpJson() const;
+    QByteArray dumpText() const;
+
+private:
+    VecsDeviceModel *m_model;
+    VecsScheduler *m_scheduler;
+    QString m_fileName;
+    Format m_format;
+    int m_interval;
+    int m_job;
+};
+
+#endif // VECSMETRICSEXPORTER_H
@@ -0,0 +1,142 @@
+#include "vecsreplaytransport.h"
+#include <QDebug>
+
+VecsReplayTransport::VecsReplayTransport(const QBluetoothAddress &address, const QString &fileName, int stream,
+                                         double speed, bool loop, QObject *parent) :
+    VecsTransport(address, parent),
+    m_fileName(fileName),
+    m_stream(stream),
+    m_speed(speed > 0.0 ? speed : 1.0),
+    m_loop(loop),
+    m_chunkIndex(0),
+    m_pending(false),
+    m_recordStart(0),
+    m_replayStart(0),
+    m_timer(nullptr)
+{
+    m_chunk.type = 0;
+    m_chunk.stream = -1;
+    m_chunk.data = nullptr;
+    m_chunk.size = 0;
+}
+
+void VecsReplayTransport::open()
+{
+    if (m_timer != nullptr)
+        return;
+
+    m_timer = new QTimer(this);
+    m_timer->setInterval(5);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &VecsReplayTransport::replayTick);
+}
+
+void VecsReplayTransport::connectToDevice()
+{
+    open();
+
+    if (!m_reader.open(m_fileName)) {
+        qDebug() << "replay [" << m_fileName << "] error:" << m_reader.errorString();
+        setConnectionState(StateDisconnected);
+        return;
+    }
+
+    emit connected();
+    setConnectionState(StateConnected);
+
+    if (m_autoStart)
+        mpuStart();
+}
+
+void VecsReplayTransport::disconnectFromDevice()
+{
+    if (m_timer == nullptr)
+        return;
+
+    mpuStop();
+    m_reader.close();
+    setConnectionState(StateDisconnected);
+}
+
+void VecsReplayTransport::keyRequest(int delay)
+{
+    Q_UNUSED(delay)
+}
+
+void VecsReplayTransport::mpuStart()
+{
+    if (m_connectionState != StateConnected)
+        return;
+
+    m_reader.rewind();
+    m_samples.clear();
+    m_chunkIndex = 0;
+    m_pending = nextSample(&m_next);
+    if (!m_pending)
+        return;
+
+    beginMpuStream();
+    m_recordStart = m_next.timestamp;
+    m_replayStart = vecsTimestamp();
+    m_timer->start();
+
+    emit mpuStateChanged(true);
+}
+
+void VecsReplayTransport::mpuStop()
+{
+    if (m_timer == nullptr || !m_timer->isActive())
+        return;
+
+    m_timer->stop();
+    endMpuStream();
+
+    emit mpuStateChanged(false);
+}
+
+void VecsReplayTransport::replayTick()
+{
+    // Позиция в записи, до которой уже пора отдать отсчеты
+    const qint64 now = vecsTimestamp();
+    const qint64 position = m_recordStart + qint64((now - m_replayStart) * m_speed);
+
+    while (m_pending && m_next.timestamp <= position) {
+        VecsSample s = m_next;
+        s.timestamp = now;
+        pushSample(s);
+
+        m_pending = nextSample(&m_next);
+        if (!m_pending && m_loop) {
+            m_reader.rewind();
+            m_samples.clear();
+            m_chunkIndex = 0;
+            m_pending = nextSample(&m_next);
+            if (m_pending) {
+                beginMpuStream();
+                m_recordStart = m_next.timestamp;
+                m_replayStart = now;
+                break;
+            }
+        }
+    }
+
+    if (!m_pending)
+        mpuStop();
+}
+
+bool VecsReplayTransport::nextSample(VecsSample *sample)
+{
+    // Блок своего потока распаковывается целиком: отсчеты в нем могут быть сжаты
+    while (m_chunkIndex >= m_samples.size()) {
+        if (!m_reader.readChunk(&m_chunk))
+            return false;
+        m_chunkIndex = 0;
+        if (m_chunk.stream == m_stream)
+            VecsSessionReader::readSamples(m_chunk, &m_samples);
+        else
+            m_samples.clear();
+    }
+
+    *sample = m_samples.at(m_chunkIndex++);
+    return true;
+}
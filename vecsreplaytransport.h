@@ -0,0 +1,55 @@
+#ifndef VECSREPLAYTRANSPORT_H
+#define VECSREPLAYTRANSPORT_H
+
+#include <QTimer>
+#include "vecstransport.h"
+#include "vecssessionreader.h"
+
+/*
+ * Воспроизведение одного потока из файла сессии (*.vecs) с сохранением
+ * исходных интервалов между отсчетами, в реальном времени или ускоренно.
+ */
+class VecsReplayTransport : public VecsTransport
+{
+    Q_OBJECT
+
+public:
+    VecsReplayTransport(const QBluetoothAddress &address, const QString &fileName, int stream,
+                        double speed = 1.0, bool loop = false, QObject *parent = 0);
+
+public slots:
+    void open() override;
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+
+    void keyRequest(int delay) override;
+    void mpuStart() override;
+    void mpuStop() override;
+
+private slots:
+    void replayTick();
+
+private:
+    bool nextSample(VecsSample *sample);
+
+private:
+    QString m_fileName;
+    int m_stream;
+    double m_speed;
+    bool m_loop;
+
+    VecsSessionReader m_reader;
+    VecsSessionReader::Chunk m_chunk;
+    QVector<VecsSample> m_samples;
+    int m_chunkIndex;
+
+    bool m_pending;
+    VecsSample m_next;
+    qint64 m_recordStart;
+    qint64 m_replayStart;
+
+    QTimer *m_timer;
+};
+
+#endif // VECSREPLAYTRANSPORT_H
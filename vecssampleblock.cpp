@@ -0,0 +1,69 @@
+#include "vecssampleblock.h"
+
+int VecsSampleBlock::size() const
+{
+    return timestamp.size();
+}
+
+void VecsSampleBlock::clear()
+{
+    // resize(0) сохраняет выделенную память, в отличие от QVector::clear()
+    timestamp.resize(0);
+    packetIndex.resize(0);
+    flags.resize(0);
+    for (int i = 0; i < 3; ++i) {
+        accel[i].resize(0);
+        gyro[i].resize(0);
+    }
+}
+
+void VecsSampleBlock::append(const VecsSample *samples, int count)
+{
+    const int offset = size();
+    const int total = offset + count;
+
+    timestamp.resize(total);
+    packetIndex.resize(total);
+    flags.resize(total);
+    for (int i = 0; i < 3; ++i) {
+        accel[i].resize(total);
+        gyro[i].resize(total);
+    }
+
+    qint64 *t = timestamp.data() + offset;
+    quint16 *index = packetIndex.data() + offset;
+    quint16 *f = flags.data() + offset;
+    qint16 *ax = accel[0].data() + offset;
+    qint16 *ay = accel[1].data() + offset;
+    qint16 *az = accel[2].data() + offset;
+    qint16 *gx = gyro[0].data() + offset;
+    qint16 *gy = gyro[1].data() + offset;
+    qint16 *gz = gyro[2].data() + offset;
+
+    for (int k = 0; k < count; ++k) {
+        const VecsSample &s = samples[k];
+        t[k] = s.timestamp;
+        index[k] = s.packetIndex;
+        f[k] = s.flags;
+        ax[k] = s.accel[0];
+        ay[k] = s.accel[1];
+        az[k] = s.accel[2];
+        gx[k] = s.gyro[0];
+        gy[k] = s.gyro[1];
+        gz[k] = s.gyro[2];
+    }
+}
+
+int VecsMotionBlock::size() const
+{
+    return timestamp.size();
+}
+
+void VecsMotionBlock::resize(int count)
+{
+    timestamp.resize(count);
+    for (int i = 0; i < 3; ++i) {
+        accel[i].resize(count);
+        gyro[i].resize(count);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef VECSSAMPLEBLOCK_H
+#define VECSSAMPLEBLOCK_H
+
+#include <QVector>
+#include <QMetaType>
+#include "vecssamplering.h"
+
+/*
+ * Блоки отсчетов MPU в виде структуры массивов: каждая ось хранится непрерывно,
+ * поэтому обработка блока сводится к проходам по плотным массивам одного типа
+ * (удобно для SIMD и кэша). Емкость блока не уменьшается при clear(), так что
+ * повторное заполнение не выделяет память.
+ */
+struct VecsSampleBlock
+{
+    int size() const;
+    void clear();
+    // Разворачивает массив отсчетов в конец блока
+    void append(const VecsSample *samples, int count);
+
+    QVector<qint64> timestamp;
+    QVector<quint16> packetIndex;
+    QVector<quint16> flags;
+    QVector<qint16> accel[3];
+    QVector<qint16> gyro[3];
+};
+
+// Отсчеты в физических единицах (см. VecsUnits)
+struct VecsMotionBlock
+{
+    int size() const;
+    void resize(int count);
+
+    QVector<qint64> timestamp;
+    QVector<float> accel[3];
+    QVector<float> gyro[3];
+};
+
+Q_DECLARE_METATYPE(VecsMotionBlock)
+
+#endif // VECSSAMPLEBLOCK_H
@@ -0,0 +1,322 @@
+#include "vecssamplecodec.h"
+#include <QtEndian>
+#include <QtAlgorithms>
+
+namespace {
+
+// Смещения полей заголовка блока
+enum {
+    OffsetCount = 0,
+    OffsetAccelRange = 2,
+    OffsetGyroRange = 3,
+    OffsetPacketIndex = 4,
+    OffsetFlags = 6,
+    OffsetTimestamp = 8,
+    OffsetAccel = 16,
+    OffsetGyro = 22,
+    OffsetWidth = 28,
+    OffsetVersion = 37
+};
+
+// Разности шире этого числа бит не помещаются в одно 64-битное чтение со сдвигом до 7 бит
+const int MaxPackedWidth = 56;
+
+inline quint64 zigzag(qint64 d)
+{
+    return (quint64(d) << 1) ^ quint64(d >> 63);
+}
+
+// Смещение кода ширины width: код = разность + bias
+inline quint64 bias(int width)
+{
+    return width > 0 ? quint64(1) << (width - 1) : 0;
+}
+
+inline int columnBytes(int width, int n)
+{
+    return int((qint64(width) * n + 7) / 8);
+}
+
+// Упаковка одного столбца: delta(prev, cur) возвращает разность со знаком,
+// ширина столбца - наименьшая, в которую помещаются все разности блока
+template <typename Delta>
+uchar *packColumn(const VecsSample *s, int count, Delta delta, uchar *width, uchar *out)
+{
+    // Старший бит zigzag-кода дает наименьшую w, при которой разность лежит в [-2^(w-1), 2^(w-1))
+    quint64 used = 0;
+    for (int i = 1; i < count; ++i)
+        used |= zigzag(delta(s[i - 1], s[i]));
+
+    int w = used == 0 ? 0 : 64 - int(qCountLeadingZeroBits(used));
+    if (w > MaxPackedWidth)
+        w = 64;
+    *width = uchar(w);
+    if (w == 0)
+        return out;
+
+    const quint64 mask = w >= 64 ? ~quint64(0) : (quint64(1) << w) - 1;
+    const quint64 offset = bias(w);
+    quint64 acc = 0;
+    int fill = 0;
+    for (int i = 1; i < count; ++i) {
+        const quint64 v = (quint64(delta(s[i - 1], s[i])) + offset) & mask;
+        acc |= v << fill;
+        if (fill + w >= 64) {
+            qToLittleEndian<quint64>(acc, out);
+            out += 8;
+            acc = fill > 0 ? v >> (64 - fill) : 0;
+            fill = fill + w - 64;
+        } else {
+            fill += w;
+        }
+    }
+    for (; fill > 0; fill -= 8) {
+        *out++ = uchar(acc);
+        acc >>= 8;
+    }
+    return out;
+}
+
+// Значение с номером Index в группе из 8 значений ширины Width
+template <int Width, int Index>
+inline quint64 groupValue(const uchar *p, quint64 mask)
+{
+    return (qFromLittleEndian<quint64>(p + (Index * Width >> 3)) >> ((Index * Width) & 7)) & mask;
+}
+
+// Шаг разностного декодирования: поле следующего отсчета (dst с шагом в один отсчет);
+// offset включает вычитание смещения кода
+template <typename T>
+inline void store(T *dst, int index, T *value, T offset, quint64 code)
+{
+    *value = T(*value + offset + T(code));
+    dst[index * int(sizeof(VecsSample) / sizeof(T))] = *value;
+}
+
+// Декодирование группами по 8 значений: при постоянной ширине смещения и сдвиги внутри
+// группы известны при компиляции, группа занимает ровно Width байт. Накопитель держится
+// в локальной переменной: запись поля того же типа в отсчет не дает компилятору
+// оставить в регистре значение, доступное по указателю
+template <typename T, int Width>
+void decodeGroups(const uchar *p, int groups, T *dst, T *value, T offset)
+{
+    const quint64 mask = Width >= 64 ? ~quint64(0) : (quint64(1) << (Width & 63)) - 1;
+    T v = *value;
+    for (int g = 0; g < groups; ++g, p += Width, dst += 8 * sizeof(VecsSample) / sizeof(T)) {
+        store(dst, 0, &v, offset, groupValue<Width, 0>(p, mask));
+        store(dst, 1, &v, offset, groupValue<Width, 1>(p, mask));
+        store(dst, 2, &v, offset, groupValue<Width, 2>(p, mask));
+        store(dst, 3, &v, offset, groupValue<Width, 3>(p, mask));
+        store(dst, 4, &v, offset, groupValue<Width, 4>(p, mask));
+        store(dst, 5, &v, offset, groupValue<Width, 5>(p, mask));
+        store(dst, 6, &v, offset, groupValue<Width, 6>(p, mask));
+        store(dst, 7, &v, offset, groupValue<Width, 7>(p, mask));
+    }
+    *value = v;
+}
+
+typedef void (*DecodeGroups16)(const uchar *p, int groups, quint16 *dst, quint16 *value, quint16 offset);
+typedef void (*DecodeGroups64)(const uchar *p, int groups, quint64 *dst, quint64 *value, quint64 offset);
+
+#define VECS_DECODE4(T, w) \
+    &decodeGroups<T, w>, &decodeGroups<T, w + 1>, &decodeGroups<T, w + 2>, &decodeGroups<T, w + 3>
+
+// Ширина 0 обрабатывается отдельно; время шире MaxPackedWidth бит хранится по 64 бита
+const DecodeGroups16 DecodeTable16[17] = {
+    nullptr, &decodeGroups<quint16, 1>, &decodeGroups<quint16, 2>, &decodeGroups<quint16, 3>,
+    VECS_DECODE4(quint16, 4), VECS_DECODE4(quint16, 8), VECS_DECODE4(quint16, 12),
+    &decodeGroups<quint16, 16>
+};
+
+const DecodeGroups64 DecodeTable64[65] = {
+    nullptr, &decodeGroups<quint64, 1>, &decodeGroups<quint64, 2>, &decodeGroups<quint64, 3>,
+    VECS_DECODE4(quint64, 4), VECS_DECODE4(quint64, 8), VECS_DECODE4(quint64, 12),
+    VECS_DECODE4(quint64, 16), VECS_DECODE4(quint64, 20), VECS_DECODE4(quint64, 24),
+    VECS_DECODE4(quint64, 28), VECS_DECODE4(quint64, 32), VECS_DECODE4(quint64, 36),
+    VECS_DECODE4(quint64, 40), VECS_DECODE4(quint64, 44), VECS_DECODE4(quint64, 48),
+    VECS_DECODE4(quint64, 52), &decodeGroups<quint64, 56>,
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+    &decodeGroups<quint64, 64>
+};
+
+#undef VECS_DECODE4
+
+inline void decodeGroups(int width, const uchar *p, int groups, quint16 *dst, quint16 *value, quint16 offset)
+{
+    DecodeTable16[width](p, groups, dst, value, offset);
+}
+
+inline void decodeGroups(int width, const uchar *p, int groups, quint64 *dst, quint64 *value, quint64 offset)
+{
+    DecodeTable64[width](p, groups, dst, value, offset);
+}
+
+// Декодирование столбца из n значений в поля dst отсчетов. Неполная последняя группа
+// декодируется по одному значению; значения, для которых 8-байтовое чтение вышло бы
+// за конец блока, читаются побайтно
+template <typename T>
+const uchar *decodeColumn(const uchar *p, const uchar *end, int width, int n, T *dst, T first, T offset)
+{
+    T value = first;
+    offset = T(offset - T(bias(width)));
+    if (width == 0) {
+        for (int i = 0; i < n; ++i)
+            store(dst, i, &value, offset, 0);
+        return p;
+    }
+
+    const qint64 avail = end - p;
+    const int reach = (7 * width >> 3) + 8;
+    const int groups = avail >= reach ? int(qMin<qint64>(n / 8, (avail - reach) / width + 1)) : 0;
+    decodeGroups(width, p, groups, dst, &value, offset);
+
+    const quint64 mask = width >= 64 ? ~quint64(0) : (quint64(1) << width) - 1;
+    for (int i = groups * 8; i < n; ++i) {
+        const qint64 bit = qint64(i) * width;
+        const uchar *q = p + (bit >> 3);
+        quint64 v = 0;
+        if (q + 8 <= end) {
+            v = qFromLittleEndian<quint64>(q);
+        } else {
+            for (int k = 0; q + k < end; ++k)
+                v |= quint64(q[k]) << (8 * k);
+        }
+        store(dst, i, &value, offset, (v >> (bit & 7)) & mask);
+    }
+
+    return p + columnBytes(width, n);
+}
+
+}
+
+namespace VecsSampleCodec {
+
+int maxEncodedSize(int count)
+{
+    // Время до 8 байт, остальные столбцы до 2 байт на отсчет, плюс выравнивание столбцов
+    return HeaderSize + qMax(0, count - 1) * (8 + 2 * (ColumnCount - 1)) + ColumnCount;
+}
+
+int encode(const VecsSample *samples, int count, int accelRange, int gyroRange, uchar *out)
+{
+    if (count <= 0 || count > MaxSamples)
+        return 0;
+
+    const VecsSample &first = samples[0];
+    qToLittleEndian<quint16>(quint16(count), out + OffsetCount);
+    out[OffsetAccelRange] = uchar(accelRange);
+    out[OffsetGyroRange] = uchar(gyroRange);
+    qToLittleEndian<quint16>(first.packetIndex, out + OffsetPacketIndex);
+    qToLittleEndian<quint16>(first.flags, out + OffsetFlags);
+    qToLittleEndian<qint64>(first.timestamp, out + OffsetTimestamp);
+    for (int a = 0; a < 3; ++a) {
+        qToLittleEndian<qint16>(first.accel[a], out + OffsetAccel + 2 * a);
+        qToLittleEndian<qint16>(first.gyro[a], out + OffsetGyro + 2 * a);
+    }
+    out[OffsetVersion] = Version;
+    qToLittleEndian<quint16>(0, out + OffsetVersion + 1);
+
+    uchar *width = out + OffsetWidth;
+    uchar *p = out + HeaderSize;
+
+    p = packColumn(samples, count, [](const VecsSample &prev, const VecsSample &cur) {
+        return qint64(quint64(cur.timestamp) - quint64(prev.timestamp));
+    }, width++, p);
+    p = packColumn(samples, count, [](const VecsSample &prev, const VecsSample &cur) {
+        return qint64(qint16(cur.packetIndex - prev.packetIndex - 1));
+    }, width++, p);
+    p = packColumn(samples, count, [](const VecsSample &prev, const VecsSample &cur) {
+        return qint64(qint16(cur.flags - prev.flags));
+    }, width++, p);
+    for (int a = 0; a < 3; ++a) {
+        p = packColumn(samples, count, [a](const VecsSample &prev, const VecsSample &cur) {
+            return qint64(qint16(cur.accel[a] - prev.accel[a]));
+        }, width++, p);
+    }
+    for (int a = 0; a < 3; ++a) {
+        p = packColumn(samples, count, [a](const VecsSample &prev, const VecsSample &cur) {
+            return qint64(qint16(cur.gyro[a] - prev.gyro[a]));
+        }, width++, p);
+    }
+
+    return int(p - out);
+}
+
+int sampleCount(const uchar *data, int size)
+{
+    if (blockSize(data, size) < 0)
+        return -1;
+    return qFromLittleEndian<quint16>(data + OffsetCount);
+}
+
+int blockSize(const uchar *data, int size)
+{
+    if (size < HeaderSize || data[OffsetVersion] != Version)
+        return -1;
+
+    const int count = qFromLittleEndian<quint16>(data + OffsetCount);
+    if (count == 0)
+        return -1;
+
+    int total = HeaderSize;
+    for (int c = 0; c < ColumnCount; ++c) {
+        const int width = data[OffsetWidth + c];
+        // Время: до MaxPackedWidth бит или 64; остальные столбцы 16-битные
+        const bool valid = c == 0 ? (width <= MaxPackedWidth || width == 64) : width <= 16;
+        if (!valid)
+            return -1;
+        total += columnBytes(width, count - 1);
+    }
+
+    return total <= size ? total : -1;
+}
+
+int accelRange(const uchar *data)
+{
+    return data[OffsetAccelRange];
+}
+
+int gyroRange(const uchar *data)
+{
+    return data[OffsetGyroRange];
+}
+
+int decode(const uchar *data, int size, VecsSample *out)
+{
+    const int total = blockSize(data, size);
+    if (total < 0)
+        return -1;
+
+    const int n = qFromLittleEndian<quint16>(data + OffsetCount) - 1;
+    const uchar *width = data + OffsetWidth;
+    const uchar *end = data + total;
+    const uchar *p = data + HeaderSize;
+
+    VecsSample &first = out[0];
+    first.timestamp = qFromLittleEndian<qint64>(data + OffsetTimestamp);
+    first.packetIndex = qFromLittleEndian<quint16>(data + OffsetPacketIndex);
+    first.flags = qFromLittleEndian<quint16>(data + OffsetFlags);
+    for (int a = 0; a < 3; ++a) {
+        first.accel[a] = qFromLittleEndian<qint16>(data + OffsetAccel + 2 * a);
+        first.gyro[a] = qFromLittleEndian<qint16>(data + OffsetGyro + 2 * a);
+    }
+
+    // Поля отсчетов пишутся через беззнаковые указатели того же размера
+    VecsSample *s = out + 1;
+    p = decodeColumn<quint64>(p, end, *width++, n, reinterpret_cast<quint64 *>(&s->timestamp),
+                              quint64(first.timestamp), 0);
+    p = decodeColumn<quint16>(p, end, *width++, n, &s->packetIndex, first.packetIndex, 1);
+    p = decodeColumn<quint16>(p, end, *width++, n, &s->flags, first.flags, 0);
+    for (int a = 0; a < 3; ++a) {
+        p = decodeColumn<quint16>(p, end, *width++, n, reinterpret_cast<quint16 *>(&s->accel[a]),
+                                  quint16(first.accel[a]), 0);
+    }
+    for (int a = 0; a < 3; ++a) {
+        p = decodeColumn<quint16>(p, end, *width++, n, reinterpret_cast<quint16 *>(&s->gyro[a]),
+                                  quint16(first.gyro[a]), 0);
+    }
+
+    return total;
+}
+
+}
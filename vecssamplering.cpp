@@ -0,0 +1,71 @@
+#include "vecssamplering.h"
+#include <QElapsedTimer>
+
+qint64 vecsTimestamp()
+{
+    // Инициализация статической переменной потокобезопасна (C++11)
+    static const QElapsedTimer clock = [] {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+
+    return clock.nsecsElapsed();
+}
+
+VecsSampleRing::VecsSampleRing(int capacity) :
+    m_head(0)
+{
+    // Размер буфера округляется вверх до степени двойки
+    int size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    m_buffer.resize(size);
+    m_mask = quint64(size - 1);
+}
+
+VecsSampleReader::VecsSampleReader(const VecsSampleRing *ring) :
+    m_ring(ring),
+    m_position(0),
+    m_lost(0)
+{
+    seekToHead();
+}
+
+void VecsSampleReader::attach(const VecsSampleRing *ring)
+{
+    m_ring = ring;
+    m_lost = 0;
+    seekToHead();
+}
+
+const VecsSampleRing *VecsSampleReader::ring() const
+{
+    return m_ring;
+}
+
+void VecsSampleReader::seekToHead()
+{
+    m_position = (m_ring != nullptr) ? m_ring->head() : 0;
+}
+
+quint64 VecsSampleReader::position() const
+{
+    return m_position;
+}
+
+int VecsSampleReader::available() const
+{
+    if (m_ring == nullptr)
+        return 0;
+
+    const quint64 head = m_ring->head();
+    const quint64 from = qMax(m_position, m_ring->oldestValid(head));
+    return int(head - from);
+}
+
+quint64 VecsSampleReader::lost() const
+{
+    return m_lost;
+}
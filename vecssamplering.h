@@ -0,0 +1,206 @@
+#ifndef VECSSAMPLERING_H
+#define VECSSAMPLERING_H
+
+#include <QtGlobal>
+#include <QAtomicInteger>
+#include <QVector>
+#include <QMetaType>
+#include <atomic>
+#include <cstring>
+
+// Декодированный пакет MPU
+struct VecsSample
+{
+    enum Flag {
+        FlagNone = 0x0,
+        FlagSynthetic = 0x1,    // Отсчет интерполирован на месте потерянного пакета
+        FlagRateChange = 0x2    // Первый отсчет после смены частоты MPU без перезапуска потока
+    };
+
+    qint64 timestamp;       // Время приема пакета хостом (нс, монотонные часы vecsTimestamp())
+    quint16 packetIndex;    // Счетчик пакетов устройства
+    quint16 flags;
+    qint16 accel[3];
+    qint16 gyro[3];
+};
+
+Q_DECLARE_TYPEINFO(VecsSample, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(VecsSample)
+
+// Монотонное время в наносекундах, общее для всех потоков приложения
+qint64 vecsTimestamp();
+
+/*
+ * Кольцевой буфер отсчетов фиксированного размера: один писатель, любое число читателей.
+ * Писатель никогда не ждет читателей и перезаписывает самые старые отсчеты.
+ * Читатели без блокировок копируют отсчеты небольшими блоками (в кэше L1) и, прежде чем
+ * отдать блок потребителю, проверяют, что писатель не успел перезаписать скопированное.
+ */
+class VecsSampleRing
+{
+public:
+    explicit VecsSampleRing(int capacity = 4096);
+
+    int capacity() const;
+
+    // Число отсчетов, записанных за все время (порядковый номер следующего отсчета)
+    quint64 head() const;
+
+    // Только для писателя
+    VecsSample *beginWrite();
+    void commitWrite();
+    void push(const VecsSample &sample);
+
+    // Последний записанный отсчет (валиден, только если head() > 0)
+    const VecsSample &newest() const;
+
+    // Отсчет с порядковым номером seq, без проверки на перезапись
+    const VecsSample &at(quint64 seq) const;
+
+    // Самый старый порядковый номер, который еще гарантированно не перезаписывается
+    quint64 oldestValid(quint64 head) const;
+
+private:
+    Q_DISABLE_COPY(VecsSampleRing)
+
+    QVector<VecsSample> m_buffer;
+    quint64 m_mask;
+    QAtomicInteger<quint64> m_head;
+};
+
+/*
+ * Курсор читателя. Каждый потребитель (запись, анализ, UI) владеет своим курсором
+ * и читает полный поток независимо от остальных.
+ */
+class VecsSampleReader
+{
+public:
+    enum { DrainChunk = 256 };
+
+    explicit VecsSampleReader(const VecsSampleRing *ring = nullptr);
+
+    void attach(const VecsSampleRing *ring);
+    const VecsSampleRing *ring() const;
+
+    // Перемещает курсор на конец потока (пропуская все накопленное)
+    void seekToHead();
+
+    quint64 position() const;
+    int available() const;
+    quint64 lost() const;
+
+    /*
+     * Передает все новые отсчеты в func(const VecsSample *data, int count) блоками
+     * до DrainChunk отсчетов; data указывает на копию, проверенную на перезапись,
+     * и действительна только во время вызова. Во время вызова position() - порядковый
+     * номер data[0]. Возвращает число переданных отсчетов. Если писатель обогнал
+     * читателя, пропущенные и перезаписанные отсчеты не передаются, а учитываются в lost().
+     */
+    template <typename Func>
+    int drain(Func func, int maxCount = -1);
+
+private:
+
+    const VecsSampleRing *m_ring;
+    quint64 m_position;
+    quint64 m_lost;
+};
+
+inline int VecsSampleRing::capacity() const
+{
+    return m_buffer.size();
+}
+
+inline quint64 VecsSampleRing::head() const
+{
+    return m_head.loadAcquire();
+}
+
+inline VecsSample *VecsSampleRing::beginWrite()
+{
+    // Предыдущий head (он уже объявляет эту ячейку перезаписываемой) должен стать
+    // виден раньше нового содержимого ячейки: барьер запись-запись, как в seqlock
+    std::atomic_thread_fence(std::memory_order_release);
+    return const_cast<VecsSample *>(m_buffer.constData()) + (m_head.load() & m_mask);
+}
+
+inline void VecsSampleRing::commitWrite()
+{
+    m_head.storeRelease(m_head.load() + 1);
+}
+
+inline void VecsSampleRing::push(const VecsSample &sample)
+{
+    *beginWrite() = sample;
+    commitWrite();
+}
+
+inline const VecsSample &VecsSampleRing::newest() const
+{
+    return at(head() - 1);
+}
+
+inline const VecsSample &VecsSampleRing::at(quint64 seq) const
+{
+    return m_buffer.constData()[seq & m_mask];
+}
+
+inline quint64 VecsSampleRing::oldestValid(quint64 head) const
+{
+    // Ячейку head писатель может заполнять прямо сейчас, она совпадает с head - capacity
+    const quint64 size = quint64(m_buffer.size()) - 1;
+    return (head > size) ? head - size : 0;
+}
+
+template <typename Func>
+int VecsSampleReader::drain(Func func, int maxCount)
+{
+    if (m_ring == nullptr)
+        return 0;
+
+    const quint64 head = m_ring->head();
+    const quint64 oldest = m_ring->oldestValid(head);
+    if (m_position < oldest) {
+        m_lost += oldest - m_position;
+        m_position = oldest;
+    }
+
+    quint64 end = head;
+    if (maxCount >= 0 && end - m_position > quint64(maxCount))
+        end = m_position + quint64(maxCount);
+
+    const quint64 mask = quint64(m_ring->capacity() - 1);
+    VecsSample copy[DrainChunk];
+    int total = 0;
+    while (m_position < end) {
+        const int count = int(qMin<quint64>(end - m_position, DrainChunk));
+        const int first = int(qMin<quint64>(quint64(count), mask + 1 - (m_position & mask)));
+        memcpy(copy, &m_ring->at(m_position), sizeof(VecsSample) * first);
+        memcpy(copy + first, &m_ring->at(m_position + quint64(first)), sizeof(VecsSample) * (count - first));
+
+        // Проверяем, не перезаписал ли писатель копируемые отсчеты;
+        // барьер не дает чтению head обогнать чтение отсчетов
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const quint64 oldestAfter = m_ring->oldestValid(m_ring->head());
+        const int torn = (oldestAfter > m_position) ? int(qMin<quint64>(oldestAfter - m_position, quint64(count))) : 0;
+        m_lost += quint64(torn);
+        m_position += quint64(torn);
+
+        if (torn < count) {
+            func(copy + torn, count - torn);
+            m_position += quint64(count - torn);
+            total += count - torn;
+        }
+
+        // Писатель обогнал читателя дальше этого блока: перезаписанное не копируется
+        if (oldestAfter > m_position) {
+            const quint64 skip = qMin(oldestAfter, end) - m_position;
+            m_lost += skip;
+            m_position += skip;
+        }
+    }
+
+    return total;
+}
+
+#endif // VECSSAMPLERING_H
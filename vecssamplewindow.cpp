@@ -0,0 +1,96 @@
+#include "vecssamplewindow.h"
+
+VecsSampleWindow::VecsSampleWindow(QObject *parent) :
+    QObject(parent),
+    m_publishedCount(0)
+{
+    m_last = VecsSample();
+    for (int i = 0; i < AxisCount; ++i) {
+        m_publishedLast.append(0);
+        m_publishedMin.append(0);
+        m_publishedMax.append(0);
+        m_publishedMean.append(0.0);
+    }
+    reset();
+}
+
+void VecsSampleWindow::add(const VecsSample &sample)
+{
+    const qint16 values[AxisCount] = {
+        sample.accel[0], sample.accel[1], sample.accel[2],
+        sample.gyro[0], sample.gyro[1], sample.gyro[2]
+    };
+
+    for (int i = 0; i < AxisCount; ++i) {
+        m_min[i] = qMin(m_min[i], values[i]);
+        m_max[i] = qMax(m_max[i], values[i]);
+        m_sum[i] += values[i];
+    }
+
+    m_last = sample;
+    m_count++;
+}
+
+bool VecsSampleWindow::publish()
+{
+    if (m_count == 0)
+        return false;
+
+    const qint16 last[AxisCount] = {
+        m_last.accel[0], m_last.accel[1], m_last.accel[2],
+        m_last.gyro[0], m_last.gyro[1], m_last.gyro[2]
+    };
+
+    for (int i = 0; i < AxisCount; ++i) {
+        m_publishedLast[i] = last[i];
+        m_publishedMin[i] = m_min[i];
+        m_publishedMax[i] = m_max[i];
+        m_publishedMean[i] = double(m_sum[i]) / m_count;
+    }
+    m_publishedCount = m_count;
+
+    reset();
+    emit updated();
+
+    return true;
+}
+
+void VecsSampleWindow::reset()
+{
+    m_count = 0;
+    for (int i = 0; i < AxisCount; ++i) {
+        m_min[i] = 32767;
+        m_max[i] = -32768;
+        m_sum[i] = 0;
+    }
+}
+
+const VecsSample &VecsSampleWindow::lastSample() const
+{
+    return m_last;
+}
+
+int VecsSampleWindow::count() const
+{
+    return m_publishedCount;
+}
+
+QVariantList VecsSampleWindow::last() const
+{
+    return m_publishedLast;
+}
+
+QVariantList VecsSampleWindow::min() const
+{
+    return m_publishedMin;
+}
+
+QVariantList VecsSampleWindow::max() const
+{
+    return m_publishedMax;
+}
+
+QVariantList VecsSampleWindow::mean() const
+{
+    return m_publishedMean;
+}
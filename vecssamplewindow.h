@@ -0,0 +1,64 @@
+#ifndef VECSSAMPLEWINDOW_H
+#define VECSSAMPLEWINDOW_H
+
+#include <QObject>
+#include <QVariantList>
+#include "vecssamplering.h"
+
+/*
+ * Агрегаты отсчетов MPU за один кадр отображения. Отсчеты накапливаются с полной
+ * частотой, а QML получает одно обновление за кадр: последнее значение, минимум,
+ * максимум и среднее по каждой оси (accelX, accelY, accelZ, gyroX, gyroY, gyroZ),
+ * поэтому короткие пики не теряются между кадрами.
+ */
+class VecsSampleWindow : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int count READ count NOTIFY updated)
+    Q_PROPERTY(QVariantList last READ last NOTIFY updated)
+    Q_PROPERTY(QVariantList min READ min NOTIFY updated)
+    Q_PROPERTY(QVariantList max READ max NOTIFY updated)
+    Q_PROPERTY(QVariantList mean READ mean NOTIFY updated)
+
+public:
+    enum { AxisCount = 6 };
+
+    explicit VecsSampleWindow(QObject *parent = 0);
+
+    void add(const VecsSample &sample);
+
+    // Публикует накопленное окно; возвращает false, если новых отсчетов не было
+    bool publish();
+
+    const VecsSample &lastSample() const;
+
+    int count() const;
+    QVariantList last() const;
+    QVariantList min() const;
+    QVariantList max() const;
+    QVariantList mean() const;
+
+signals:
+    void updated();
+
+private:
+    void reset();
+
+private:
+    // Накопление текущего окна
+    int m_count;
+    qint16 m_min[AxisCount];
+    qint16 m_max[AxisCount];
+    qint64 m_sum[AxisCount];
+    VecsSample m_last;
+
+    // Опубликованное окно
+    int m_publishedCount;
+    QVariantList m_publishedLast;
+    QVariantList m_publishedMin;
+    QVariantList m_publishedMax;
+    QVariantList m_publishedMean;
+};
+
+#endif // VECSSAMPLEWINDOW_H
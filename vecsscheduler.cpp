@@ -0,0 +1,177 @@
+#include "vecsscheduler.h"
+#include <QTimer>
+
+VecsScheduler::VecsScheduler(QObject *parent) :
+    QObject(parent),
+    m_timer(new QTimer(this)),
+    m_tick(50),
+    m_maxJobsPerTick(8),
+    m_wheel(WheelSize),
+    m_current(0),
+    m_nextId(1),
+    m_deferred(0)
+{
+    m_timer->setInterval(m_tick);
+    connect(m_timer, &QTimer::timeout, this, &VecsScheduler::advance);
+}
+
+VecsScheduler::~VecsScheduler()
+{
+    qDeleteAll(m_jobs);
+}
+
+int VecsScheduler::tick() const
+{
+    return m_tick;
+}
+
+void VecsScheduler::setTick(int tick)
+{
+    m_tick = qMax(1, tick);
+    m_timer->setInterval(m_tick);
+}
+
+void VecsScheduler::setMaxJobsPerTick(int count)
+{
+    m_maxJobsPerTick = qMax(1, count);
+}
+
+int VecsScheduler::ticks(int period) const
+{
+    return qMax(1, (period + m_tick / 2) / m_tick);
+}
+
+int VecsScheduler::addJob(QObject *owner, int period, const Job &job)
+{
+    Entry *entry = new Entry;
+    entry->id = m_nextId++;
+    entry->owner = owner;
+    entry->job = job;
+    entry->period = ticks(period);
+    m_jobs.insert(entry->id, entry);
+
+    // Фаза - наименее загруженная ячейка в пределах первого периода
+    const int span = qMin<int>(entry->period, WheelSize);
+    int delay = 1;
+    for (int d = 2; d <= span; ++d) {
+        if (m_wheel.at((m_current + d) % WheelSize).size() < m_wheel.at((m_current + delay) % WheelSize).size())
+            delay = d;
+    }
+    insert(entry, delay);
+
+    if (owner != nullptr)
+        connect(owner, &QObject::destroyed, this, &VecsScheduler::ownerDestroyed, Qt::UniqueConnection);
+    if (!m_timer->isActive())
+        m_timer->start();
+    return entry->id;
+}
+
+void VecsScheduler::setPeriod(int id, int period)
+{
+    Entry *entry = m_jobs.value(id);
+    if (entry == nullptr)
+        return;
+
+    entry->period = ticks(period);
+    unlink(entry);
+    insert(entry, entry->period);
+}
+
+void VecsScheduler::removeJob(int id)
+{
+    Entry *entry = m_jobs.take(id);
+    if (entry == nullptr)
+        return;
+
+    unlink(entry);
+    delete entry;
+    if (m_jobs.isEmpty())
+        m_timer->stop();
+}
+
+void VecsScheduler::removeJobs(QObject *owner)
+{
+    QVector<int> ids;
+    for (const auto& entry : m_jobs) {
+        if (entry->owner == owner)
+            ids.append(entry->id);
+    }
+    for (int id : ids)
+        removeJob(id);
+}
+
+int VecsScheduler::jobCount() const
+{
+    return m_jobs.size();
+}
+
+quint64 VecsScheduler::deferredJobs() const
+{
+    return m_deferred;
+}
+
+void VecsScheduler::insert(Entry *entry, int delay)
+{
+    entry->slot = (m_current + delay) % WheelSize;
+    entry->rounds = (delay - 1) / WheelSize;
+    m_wheel[entry->slot].append(entry);
+}
+
+void VecsScheduler::unlink(Entry *entry)
+{
+    if (entry->slot >= 0)
+        m_wheel[entry->slot].removeOne(entry);
+    entry->slot = -1;
+}
+
+void VecsScheduler::advance()
+{
+    m_current = (m_current + 1) % WheelSize;
+
+    // Ячейка разбирается целиком: задачи этого шага, задачи следующих оборотов
+    QVector<Entry *> slot;
+    slot.swap(m_wheel[m_current]);
+
+    QVector<int> due;
+    for (Entry *entry : slot) {
+        if (entry->rounds > 0) {
+            entry->rounds--;
+            m_wheel[m_current].append(entry);
+        } else {
+            // Задача вне колеса, пока не будет вставлена снова
+            entry->slot = -1;
+            due.append(entry->id);
+        }
+    }
+
+    // Задача может удалить себя или другие задачи, поэтому они ищутся по идентификатору
+    int executed = 0;
+    for (int id : due) {
+        Entry *entry = m_jobs.value(id);
+        if (entry == nullptr)
+            continue;
+
+        // setPeriod() из задачи, выполненной раньше на этом шаге, уже вернул ее в колесо:
+        // повторная вставка выполняла бы ее дважды за период
+        const bool linked = entry->slot >= 0;
+
+        if (executed >= m_maxJobsPerTick) {
+            if (!linked) {
+                insert(entry, 1);
+                m_deferred++;
+            }
+            continue;
+        }
+
+        if (!linked)
+            insert(entry, entry->period);
+        executed++;
+        const Job job = entry->job;
+        job();
+    }
+}
+
+void VecsScheduler::ownerDestroyed(QObject *owner)
+{
+    removeJobs(owner);
+}
@@ -0,0 +1,83 @@
+#ifndef VECSSCHEDULER_H
+#define VECSSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <functional>
+
+class QTimer;
+
+/*
+ * Общий планировщик периодических задач устройств (опрос батареи, сторожевой
+ * таймер потока) вместо отдельного таймера в каждом устройстве.
+ * Хешированное колесо таймеров: один таймер с шагом tick мс, задача лежит в ячейке
+ * своего срока с числом оставшихся оборотов колеса, поэтому добавление, удаление
+ * и шаг колеса не зависят от общего числа задач.
+ * Новая задача получает фазу в наименее загруженной ячейке своего периода, так что
+ * одинаковые задачи разных устройств разнесены во времени и не попадают в эфир
+ * разом. За шаг выполняется не больше maxJobsPerTick задач, остальные переносятся
+ * на следующий шаг.
+ * Используется только потоком, которому принадлежит объект.
+ */
+class VecsScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void()> Job;
+
+    explicit VecsScheduler(QObject *parent = 0);
+    ~VecsScheduler();
+
+    // Шаг колеса, мс; задается до добавления задач
+    int tick() const;
+    void setTick(int tick);
+    void setMaxJobsPerTick(int count);
+
+    // Задача выполняется каждые period мс (с округлением до шага), пока существует owner;
+    // возвращает идентификатор задачи
+    int addJob(QObject *owner, int period, const Job &job);
+    // Новый период отсчитывается от текущего момента; задача, срок которой наступил
+    // на текущем шаге, все равно выполняется на нем
+    void setPeriod(int id, int period);
+    void removeJob(int id);
+    void removeJobs(QObject *owner);
+
+    int jobCount() const;
+    // Выполнения, перенесенные из-за ограничения maxJobsPerTick
+    quint64 deferredJobs() const;
+
+private slots:
+    void advance();
+    void ownerDestroyed(QObject *owner);
+
+private:
+    enum { WheelSize = 256 };
+
+    struct Entry {
+        int id;
+        QObject *owner;
+        Job job;
+        int period;     // Шагов колеса
+        int rounds;     // Полных оборотов до срока
+        int slot;       // -1 - задача вынута из колеса на время шага
+    };
+
+    int ticks(int period) const;
+    void insert(Entry *entry, int delay);
+    void unlink(Entry *entry);
+
+private:
+    QTimer *m_timer;
+    int m_tick;
+    int m_maxJobsPerTick;
+
+    QVector<QVector<Entry *> > m_wheel;
+    int m_current;
+    QHash<int, Entry *> m_jobs;
+    int m_nextId;
+    quint64 m_deferred;
+};
+
+#endif // VECSSCHEDULER_H
@@ -0,0 +1,131 @@
+#include "vecssequencetracker.h"
+
+// Скачок счетчика больше этого значения считаем перезапуском потока, а не потерей
+static const int ResyncThreshold = 4096;
+
+VecsSequenceTracker::VecsSequenceTracker() :
+    m_started(false),
+    m_next(0),
+    m_history(0),
+    m_received(0),
+    m_expected(0),
+    m_duplicates(0),
+    m_reordered(0),
+    m_stale(0),
+    m_longestGap(0)
+{
+}
+
+void VecsSequenceTracker::reset()
+{
+    // Счетчики накапливаются за все время соединения, сбрасывается только позиция в потоке
+    m_started = false;
+}
+
+VecsSequenceTracker::Result VecsSequenceTracker::track(quint16 index, int *gap)
+{
+    if (gap != nullptr)
+        *gap = 0;
+
+    if (!m_started) {
+        restart(index);
+        return Accepted;
+    }
+
+    const int delta = qint16(quint16(index - m_next));
+
+    if (delta >= 0) {
+        if (delta > ResyncThreshold) {
+            restart(index);
+            return Accepted;
+        }
+
+        m_history = (delta + 1 < 64) ? ((m_history << (delta + 1)) | 1) : 1;
+        m_next = index + 1;
+        m_received.store(m_received.load() + 1);
+        m_expected.store(m_expected.load() + quint64(delta) + 1);
+
+        if (delta > 0) {
+            if (delta > m_longestGap.load())
+                m_longestGap.store(delta);
+            if (gap != nullptr)
+                *gap = delta;
+        }
+        return Accepted;
+    }
+
+    // Пакет из прошлого: m_next - 1 соответствует смещению 0
+    const int offset = -delta - 1;
+    if (offset >= 64) {
+        if (offset > ResyncThreshold) {
+            restart(index);
+            return Accepted;
+        }
+        // Слишком старый, чтобы отличить дубликат от опоздавшего
+        m_stale.store(m_stale.load() + 1);
+        return Stale;
+    }
+
+    const quint64 bit = quint64(1) << offset;
+    if (m_history & bit) {
+        m_duplicates.store(m_duplicates.load() + 1);
+        return Duplicate;
+    }
+
+    m_history |= bit;
+    m_received.store(m_received.load() + 1);
+    m_reordered.store(m_reordered.load() + 1);
+    return Late;
+}
+
+void VecsSequenceTracker::restart(quint16 index)
+{
+    m_started = true;
+    m_next = index + 1;
+    m_history = 1;
+    m_received.store(m_received.load() + 1);
+    m_expected.store(m_expected.load() + 1);
+}
+
+quint64 VecsSequenceTracker::received() const
+{
+    return m_received.load();
+}
+
+quint64 VecsSequenceTracker::expected() const
+{
+    return m_expected.load();
+}
+
+quint64 VecsSequenceTracker::lost() const
+{
+    const quint64 expected = m_expected.load();
+    const quint64 received = m_received.load();
+    return (expected > received) ? expected - received : 0;
+}
+
+quint64 VecsSequenceTracker::duplicates() const
+{
+    return m_duplicates.load();
+}
+
+quint64 VecsSequenceTracker::reordered() const
+{
+    return m_reordered.load();
+}
+
+quint64 VecsSequenceTracker::stale() const
+{
+    return m_stale.load();
+}
+
+int VecsSequenceTracker::longestGap() const
+{
+    return m_longestGap.load();
+}
+
+double VecsSequenceTracker::lossRate() const
+{
+    const quint64 expected = m_expected.load();
+    return (expected > 0) ? double(lost()) / expected : 0.0;
+}
@@ -0,0 +1,60 @@
+#ifndef VECSSEQUENCETRACKER_H
+#define VECSSEQUENCETRACKER_H
+
+#include <QtGlobal>
+#include <QAtomicInteger>
+
+/*
+ * Учет потерь по 16-битному счетчику пакетов MPU с учетом переполнения.
+ * Отслеживает пропуски, дубликаты и пакеты, пришедшие не по порядку
+ * (в окне последних 64 пакетов). Пакет старше окна, но не дальше ResyncThreshold,
+ * учитывается отдельно: отличить дубликат от опоздавшего уже нельзя, поэтому он
+ * не считается ни принятым, ни повтором. Вызывается только из потока-писателя,
+ * счетчики можно читать из любого потока.
+ */
+class VecsSequenceTracker
+{
+public:
+    enum Result {
+        Accepted,       // Пакет в порядке следования (возможно, после пропуска)
+        Duplicate,      // Повтор уже принятого пакета
+        Late,           // Пакет пришел позже следующих за ним, ранее учтен как потерянный
+        Stale           // Пакет старше окна истории: повтор или сильно опоздавший
+    };
+
+    VecsSequenceTracker();
+
+    // Начинает новый поток (например, после перезапуска MPU)
+    void reset();
+
+    // gap - число пропущенных пакетов перед принятым
+    Result track(quint16 index, int *gap = nullptr);
+
+    quint64 received() const;
+    quint64 expected() const;
+    quint64 lost() const;
+    quint64 duplicates() const;
+    quint64 reordered() const;
+    quint64 stale() const;
+    int longestGap() const;
+
+    // Доля потерянных пакетов от ожидаемых
+    double lossRate() const;
+
+private:
+    void restart(quint16 index);
+
+private:
+    bool m_started;
+    quint16 m_next;
+    quint64 m_history;  // Бит i: принят пакет m_next - 1 - i
+
+    QAtomicInteger<quint64> m_received;
+    QAtomicInteger<quint64> m_expected;
+    QAtomicInteger<quint64> m_duplicates;
+    QAtomicInteger<quint64> m_reordered;
+    QAtomicInteger<quint64> m_stale;
+    QAtomicInt m_longestGap;
+};
+
+#endif // VECSSEQUENCETRACKER_H
@@ -0,0 +1,82 @@
+#ifndef VECSSESSIONFORMAT_H
+#define VECSSESSIONFORMAT_H
+
+#include <QtGlobal>
+#include <QtEndian>
+#include <QString>
+#include "vecssamplering.h"
+#include "vecssamplecodec.h"
+
+/*
+ * Формат файла записи сессии (*.vecs), все числа little endian.
+ *
+ * Заголовок файла (24 байта):
+ *   char[8] magic "VECSREC\0", u16 version, u16 headerSize, u32 reserved,
+ *   i64 время начала записи (мс от начала эпохи, UTC).
+ *   Версия 2 добавляет блоки ChunkSamplesPacked; файл без них пишется с версией 1,
+ *   чтобы его могли читать и прежние версии программы
+ *
+ * Далее только дописываемые блоки. Заголовок блока (8 байт):
+ *   u8 type, u8 stream, u16 reserved, u32 размер данных блока
+ *
+ *   ChunkStream  - описание потока устройства (при добавлении и при смене настроек):
+ *                  u8 role, u8 accelRange, u8 gyroRange, u8 reserved, u16 mpuRate,
+ *                  u16 длина адреса, адрес (latin1)
+ *   ChunkSamples - отсчеты потока, по SampleRecordSize байт на отсчет:
+ *                  i64 timestamp, u16 packetIndex, u16 flags, i16 accel[3], i16 gyro[3]
+ *   ChunkGap     - u64 число отсчетов, которые запись не успела прочитать из буфера
+ *   ChunkSamplesPacked - отсчеты потока в сжатом виде: подряд один или несколько блоков
+ *                  VecsSampleCodec (формат в vecssamplecodec.h), около 9 байт на отсчет
+ *
+ * Неизвестные типы блоков читатель пропускает; недописанный последний блок отбрасывается.
+ */
+namespace VecsSessionFormat {
+
+const char Magic[8] = { 'V', 'E', 'C', 'S', 'R', 'E', 'C', '\0' };
+const quint16 Version = 2;
+const quint16 VersionPlain = 1;
+const int FileHeaderSize = 24;
+const int ChunkHeaderSize = 8;
+const int SampleRecordSize = 24;
+
+enum ChunkType {
+    ChunkStream = 1,
+    ChunkSamples = 2,
+    ChunkGap = 3,
+    ChunkSamplesPacked = 4
+};
+
+// Описание потока одного устройства (блок ChunkStream)
+struct StreamInfo {
+    QString address;
+    int role;
+    int accelRange;
+    int gyroRange;
+    int mpuRate;
+};
+
+inline void writeSample(uchar *p, const VecsSample &s)
+{
+    qToLittleEndian<qint64>(s.timestamp, p);
+    qToLittleEndian<quint16>(s.packetIndex, p + 8);
+    qToLittleEndian<quint16>(s.flags, p + 10);
+    for (int i = 0; i < 3; ++i) {
+        qToLittleEndian<qint16>(s.accel[i], p + 12 + 2 * i);
+        qToLittleEndian<qint16>(s.gyro[i], p + 18 + 2 * i);
+    }
+}
+
+inline void readSample(const uchar *p, VecsSample *s)
+{
+    s->timestamp = qFromLittleEndian<qint64>(p);
+    s->packetIndex = qFromLittleEndian<quint16>(p + 8);
+    s->flags = qFromLittleEndian<quint16>(p + 10);
+    for (int i = 0; i < 3; ++i) {
+        s->accel[i] = qFromLittleEndian<qint16>(p + 12 + 2 * i);
+        s->gyro[i] = qFromLittleEndian<qint16>(p + 18 + 2 * i);
+    }
+}
+
+}
+
+#endif // VECSSESSIONFORMAT_H
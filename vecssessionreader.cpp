@@ -0,0 +1,179 @@
+#include "vecssessionreader.h"
+#include <cstring>
+
+VecsSessionReader::VecsSessionReader() :
+    m_data(nullptr),
+    m_size(0),
+    m_pos(0),
+    m_version(0),
+    m_startTime(0)
+{
+}
+
+VecsSessionReader::~VecsSessionReader()
+{
+    close();
+}
+
+bool VecsSessionReader::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size < VecsSessionFormat::FileHeaderSize) {
+        m_errorString = "File is too short";
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (m_data == nullptr) {
+        m_errorString = m_file.errorString();
+        close();
+        return false;
+    }
+
+    if (memcmp(m_data, VecsSessionFormat::Magic, sizeof(VecsSessionFormat::Magic)) != 0) {
+        m_errorString = "Not a VECS session file";
+        close();
+        return false;
+    }
+
+    m_version = qFromLittleEndian<quint16>(m_data + 8);
+    if (m_version > VecsSessionFormat::Version) {
+        m_errorString = QString("Unsupported session file version %1").arg(m_version);
+        close();
+        return false;
+    }
+
+    m_startTime = qFromLittleEndian<qint64>(m_data + 16);
+    rewind();
+
+    return true;
+}
+
+void VecsSessionReader::close()
+{
+    if (m_data != nullptr)
+        m_file.unmap(const_cast<uchar *>(m_data));
+    m_file.close();
+
+    m_data = nullptr;
+    m_size = 0;
+    m_pos = 0;
+    m_streams.clear();
+}
+
+QString VecsSessionReader::errorString() const
+{
+    return m_errorString;
+}
+
+int VecsSessionReader::version() const
+{
+    return m_version;
+}
+
+qint64 VecsSessionReader::startTime() const
+{
+    return m_startTime;
+}
+
+void VecsSessionReader::rewind()
+{
+    if (m_data == nullptr)
+        return;
+
+    m_pos = qFromLittleEndian<quint16>(m_data + 10);
+    m_streams.clear();
+}
+
+bool VecsSessionReader::readChunk(Chunk *chunk)
+{
+    if (m_data == nullptr || m_pos + VecsSessionFormat::ChunkHeaderSize > m_size)
+        return false;
+
+    const uchar *header = m_data + m_pos;
+    const qint64 size = qFromLittleEndian<quint32>(header + 4);
+    if (m_pos + VecsSessionFormat::ChunkHeaderSize + size > m_size)
+        return false;
+
+    chunk->type = header[0];
+    chunk->stream = header[1];
+    chunk->data = header + VecsSessionFormat::ChunkHeaderSize;
+    chunk->size = int(size);
+    m_pos += VecsSessionFormat::ChunkHeaderSize + size;
+
+    if (chunk->type == VecsSessionFormat::ChunkStream && chunk->size >= 8) {
+        VecsSessionFormat::StreamInfo info;
+        info.role = chunk->data[0];
+        info.accelRange = chunk->data[1];
+        info.gyroRange = chunk->data[2];
+        info.mpuRate = qFromLittleEndian<quint16>(chunk->data + 4);
+        const int length = qMin<int>(qFromLittleEndian<quint16>(chunk->data + 6), chunk->size - 8);
+        info.address = QString::fromLatin1(reinterpret_cast<const char *>(chunk->data + 8), length);
+
+        if (m_streams.size() <= chunk->stream)
+            m_streams.resize(chunk->stream + 1);
+        m_streams[chunk->stream] = info;
+    }
+
+    return true;
+}
+
+QVector<VecsSessionFormat::StreamInfo> VecsSessionReader::streams() const
+{
+    return m_streams;
+}
+
+int VecsSessionReader::sampleCount(const Chunk &chunk)
+{
+    if (chunk.type == VecsSessionFormat::ChunkSamples)
+        return chunk.size / VecsSessionFormat::SampleRecordSize;
+    if (chunk.type != VecsSessionFormat::ChunkSamplesPacked)
+        return 0;
+
+    // Заголовки сжатых блоков просматриваются без распаковки
+    int count = 0;
+    for (int pos = 0; pos < chunk.size; ) {
+        const int size = VecsSampleCodec::blockSize(chunk.data + pos, chunk.size - pos);
+        if (size < 0)
+            break;
+        count += VecsSampleCodec::sampleCount(chunk.data + pos, size);
+        pos += size;
+    }
+    return count;
+}
+
+void VecsSessionReader::sample(const Chunk &chunk, int index, VecsSample *sample)
+{
+    VecsSessionFormat::readSample(chunk.data + index * VecsSessionFormat::SampleRecordSize, sample);
+}
+
+int VecsSessionReader::readSamples(const Chunk &chunk, QVector<VecsSample> *samples)
+{
+    samples->resize(sampleCount(chunk));
+
+    if (chunk.type == VecsSessionFormat::ChunkSamples) {
+        for (int i = 0; i < samples->size(); ++i)
+            sample(chunk, i, samples->data() + i);
+        return samples->size();
+    }
+
+    int count = 0;
+    for (int pos = 0; count < samples->size(); ) {
+        const int size = VecsSampleCodec::decode(chunk.data + pos, chunk.size - pos, samples->data() + count);
+        if (size < 0)
+            break;
+        count += VecsSampleCodec::sampleCount(chunk.data + pos, size);
+        pos += size;
+    }
+    samples->resize(count);
+    return count;
+}
@@ -0,0 +1,58 @@
+#ifndef VECSSESSIONREADER_H
+#define VECSSESSIONREADER_H
+
+#include <QFile>
+#include <QVector>
+#include "vecssessionformat.h"
+
+/*
+ * Чтение файла сессии. Файл отображается в память целиком, блоки отсчетов
+ * отдаются указателями на отображенную память без копирования.
+ */
+class VecsSessionReader
+{
+public:
+    struct Chunk {
+        int type;
+        int stream;
+        const uchar *data;
+        int size;
+    };
+
+    VecsSessionReader();
+    ~VecsSessionReader();
+
+    bool open(const QString &fileName);
+    void close();
+    QString errorString() const;
+
+    int version() const;
+    qint64 startTime() const;
+
+    // Перематывает к первому блоку
+    void rewind();
+    // Возвращает false в конце файла (в т.ч. если последний блок недописан)
+    bool readChunk(Chunk *chunk);
+
+    // Описания потоков, встреченные к текущей позиции чтения
+    QVector<VecsSessionFormat::StreamInfo> streams() const;
+
+    // Число отсчетов в блоке ChunkSamples или ChunkSamplesPacked
+    static int sampleCount(const Chunk &chunk);
+    // Отсчет по номеру без копирования блока, только для ChunkSamples
+    static void sample(const Chunk &chunk, int index, VecsSample *sample);
+    // Все отсчеты блока любого из двух типов; поврежденный сжатый блок обрывает список
+    static int readSamples(const Chunk &chunk, QVector<VecsSample> *samples);
+
+private:
+    QFile m_file;
+    const uchar *m_data;
+    qint64 m_size;
+    qint64 m_pos;
+    int m_version;
+    qint64 m_startTime;
+    QString m_errorString;
+    QVector<VecsSessionFormat::StreamInfo> m_streams;
+};
+
+#endif // VECSSESSIONREADER_H
@@ -0,0 +1,270 @@
+#include "vecssessionrecorder.h"
+#include <QDateTime>
+#include <QMutexLocker>
+#include <cstring>
+
+// Начальный размер буферов; на диск они сбрасываются по таймеру
+static const int BufferReserve = 1 << 20;
+
+VecsSessionRecorder::VecsSessionRecorder(QObject *parent) :
+    QObject(parent),
+    m_timer(nullptr),
+    m_recording(false),
+    m_compress(false),
+    m_packed(false)
+{
+}
+
+VecsSessionRecorder::~VecsSessionRecorder()
+{
+    stop();
+    qDeleteAll(m_streams);
+}
+
+void VecsSessionRecorder::addStream(const VecsSampleRing *ring, const StreamInfo &info)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring)
+            return;
+    }
+
+    // Вне записи номера потоков еще не назначены: места удаленных потоков освобождаются
+    if (!m_recording)
+        m_streams.removeAll(nullptr);
+
+    // Номер потока в файле занимает один байт
+    if (m_streams.size() >= 255) {
+        locker.unlock();
+        emit error(QString("Can't record %1: too many streams in the session").arg(info.address));
+        return;
+    }
+
+    Stream *stream = new Stream;
+    stream->reader.attach(ring);
+    stream->info = info;
+    stream->infoDirty = true;
+    stream->lost = 0;
+    m_streams.append(stream);
+}
+
+void VecsSessionRecorder::updateStream(const VecsSampleRing *ring, const StreamInfo &info)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring) {
+            stream->info = info;
+            stream->infoDirty = true;
+        }
+    }
+}
+
+void VecsSessionRecorder::removeStream(const VecsSampleRing *ring)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring) {
+            delete stream;
+            stream = nullptr;
+        }
+    }
+}
+
+bool VecsSessionRecorder::isRecording() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_recording;
+}
+
+QString VecsSessionRecorder::fileName() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_file.fileName();
+}
+
+void VecsSessionRecorder::setCompress(bool compress)
+{
+    QMutexLocker locker(&m_mutex);
+    m_compress = compress;
+}
+
+bool VecsSessionRecorder::compress() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_compress;
+}
+
+bool VecsSessionRecorder::start(const QString &fileName)
+{
+    stop();
+
+    QMutexLocker locker(&m_mutex);
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        emit error(QString("Can't open %1: %2").arg(fileName, m_file.errorString()));
+        return false;
+    }
+
+    m_buffer.clear();
+    m_buffer.reserve(BufferReserve);
+    m_writeBuffer.clear();
+    m_writeBuffer.reserve(BufferReserve);
+
+    uchar header[VecsSessionFormat::FileHeaderSize] = { 0 };
+    memcpy(header, VecsSessionFormat::Magic, sizeof(VecsSessionFormat::Magic));
+    // Файл без сжатых блоков остается читаемым прежними версиями
+    m_packed = m_compress;
+    qToLittleEndian<quint16>(m_packed ? VecsSessionFormat::Version : VecsSessionFormat::VersionPlain, header + 8);
+    qToLittleEndian<quint16>(VecsSessionFormat::FileHeaderSize, header + 10);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 16);
+    m_buffer.append(reinterpret_cast<const char *>(header), sizeof(header));
+
+    // Номера потоков в новом файле назначаются заново
+    m_streams.removeAll(nullptr);
+
+    // Запись начинается с текущего момента, старые отсчеты в буферах пропускаются
+    for (const auto& stream : m_streams) {
+        stream->reader.seekToHead();
+        stream->infoDirty = true;
+        stream->lost = stream->reader.lost();
+    }
+
+    if (m_timer == nullptr) {
+        m_timer = new QTimer(this);
+        m_timer->setInterval(100);
+        connect(m_timer, &QTimer::timeout, this, &VecsSessionRecorder::flush);
+    }
+    m_timer->start();
+    m_recording = true;
+
+    return true;
+}
+
+void VecsSessionRecorder::stop()
+{
+    if (!isRecording())
+        return;
+
+    flush();
+
+    QMutexLocker locker(&m_mutex);
+    m_timer->stop();
+    m_file.close();
+    m_recording = false;
+}
+
+void VecsSessionRecorder::flush()
+{
+    if (collect())
+        writeBuffer();
+}
+
+bool VecsSessionRecorder::collect()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_recording)
+        return false;
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        Stream *stream = m_streams.at(i);
+        if (stream == nullptr)
+            continue;
+
+        if (stream->infoDirty) {
+            appendStreamInfo(i, stream->info);
+            stream->infoDirty = false;
+        }
+
+        // Блок отсчетов пишется прямо в буфер без промежуточных копий
+        const int headerPos = m_buffer.size();
+        appendChunkHeader(m_packed ? VecsSessionFormat::ChunkSamplesPacked : VecsSessionFormat::ChunkSamples, i, 0);
+        const int count = m_packed ? appendPackedSamples(stream) : appendSamples(stream);
+
+        if (count == 0) {
+            m_buffer.resize(headerPos);
+        } else {
+            const int size = m_buffer.size() - headerPos - VecsSessionFormat::ChunkHeaderSize;
+            qToLittleEndian<quint32>(quint32(size), reinterpret_cast<uchar *>(m_buffer.data()) + headerPos + 4);
+        }
+
+        const quint64 lost = stream->reader.lost();
+        if (lost != stream->lost) {
+            appendChunkHeader(VecsSessionFormat::ChunkGap, i, 8);
+            uchar value[8];
+            qToLittleEndian<quint64>(lost - stream->lost, value);
+            m_buffer.append(reinterpret_cast<const char *>(value), sizeof(value));
+            stream->lost = lost;
+        }
+    }
+
+    // На диск накопленное уходит уже без блокировки
+    m_writeBuffer.swap(m_buffer);
+    return true;
+}
+
+int VecsSessionRecorder::appendSamples(Stream *stream)
+{
+    return stream->reader.drain([&](const VecsSample *data, int n) {
+        const int pos = m_buffer.size();
+        m_buffer.resize(pos + n * VecsSessionFormat::SampleRecordSize);
+        uchar *p = reinterpret_cast<uchar *>(m_buffer.data()) + pos;
+        for (int k = 0; k < n; ++k, p += VecsSessionFormat::SampleRecordSize)
+            VecsSessionFormat::writeSample(p, data[k]);
+    });
+}
+
+int VecsSessionRecorder::appendPackedSamples(Stream *stream)
+{
+    // Блок не выходит за участок, переданный drain (до DrainChunk отсчетов), последний блок участка короче
+    return stream->reader.drain([&](const VecsSample *data, int n) {
+        for (int k = 0; k < n; k += VecsSampleCodec::BlockSamples) {
+            const int count = qMin(VecsSampleCodec::BlockSamples, n - k);
+            const int pos = m_buffer.size();
+            m_buffer.resize(pos + VecsSampleCodec::maxEncodedSize(count));
+            uchar *p = reinterpret_cast<uchar *>(m_buffer.data()) + pos;
+            const int size = VecsSampleCodec::encode(data + k, count, stream->info.accelRange,
+                                                     stream->info.gyroRange, p);
+            m_buffer.resize(pos + size);
+        }
+    });
+}
+
+void VecsSessionRecorder::appendChunkHeader(int type, int stream, int size)
+{
+    uchar header[VecsSessionFormat::ChunkHeaderSize] = { 0 };
+    header[0] = uchar(type);
+    header[1] = uchar(stream);
+    qToLittleEndian<quint32>(quint32(size), header + 4);
+    m_buffer.append(reinterpret_cast<const char *>(header), sizeof(header));
+}
+
+void VecsSessionRecorder::appendStreamInfo(int index, const StreamInfo &info)
+{
+    const QByteArray address = info.address.toLatin1();
+
+    appendChunkHeader(VecsSessionFormat::ChunkStream, index, 8 + address.size());
+    uchar data[8] = { 0 };
+    data[0] = uchar(info.role);
+    data[1] = uchar(info.accelRange);
+    data[2] = uchar(info.gyroRange);
+    qToLittleEndian<quint16>(quint16(info.mpuRate), data + 4);
+    qToLittleEndian<quint16>(quint16(address.size()), data + 6);
+    m_buffer.append(reinterpret_cast<const char *>(data), sizeof(data));
+    m_buffer.append(address);
+}
+
+void VecsSessionRecorder::writeBuffer()
+{
+    if (m_writeBuffer.isEmpty())
+        return;
+
+    if (m_file.write(m_writeBuffer) != m_writeBuffer.size())
+        emit error(QString("Session write failed: %1").arg(m_file.errorString()));
+
+    m_writeBuffer.resize(0);
+}
@@ -0,0 +1,86 @@
+#ifndef VECSSESSIONRECORDER_H
+#define VECSSESSIONRECORDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
+#include "vecssamplering.h"
+#include "vecssessionformat.h"
+
+/*
+ * Запись всех потоков MPU в файл сессии (формат описан в vecssessionformat.h).
+ * Объект работает в собственном потоке: по таймеру читает кольцевые буферы устройств
+ * своими курсорами, собирает блоки в большой буфер и пишет его одним вызовом.
+ * Блокировка потоков держится только на время кодирования: на диск пишется
+ * второй буфер, поэтому add/update/removeStream из потока GUI не ждут записи.
+ * Поток сбора данных с записью никак не синхронизируется: если запись отстанет
+ * больше чем на емкость буфера, в файл попадет блок ChunkGap.
+ * При включенном сжатии отсчеты пишутся блоками ChunkSamplesPacked (VecsSampleCodec).
+ */
+class VecsSessionRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef VecsSessionFormat::StreamInfo StreamInfo;
+
+    explicit VecsSessionRecorder(QObject *parent = 0);
+    ~VecsSessionRecorder();
+
+    // Потокобезопасны; поток записи начинается с текущей позиции буфера.
+    // В файле до 255 потоков (включая удаленные за время записи), сверх этого - error()
+    void addStream(const VecsSampleRing *ring, const StreamInfo &info);
+    void updateStream(const VecsSampleRing *ring, const StreamInfo &info);
+    // Вызывается до удаления буфера; номер потока в текущем файле больше не используется
+    void removeStream(const VecsSampleRing *ring);
+
+    bool isRecording() const;
+    QString fileName() const;
+
+    // Действует со следующего start()
+    void setCompress(bool compress);
+    bool compress() const;
+
+public slots:
+    bool start(const QString &fileName);
+    void stop();
+
+signals:
+    void error(const QString &message);
+
+private slots:
+    void flush();
+
+private:
+    struct Stream {
+        VecsSampleReader reader;
+        StreamInfo info;
+        bool infoDirty;
+        quint64 lost;
+    };
+
+    // Под блокировкой собирает новые блоки всех потоков в m_writeBuffer
+    bool collect();
+    void appendChunkHeader(int type, int stream, int size);
+    void appendStreamInfo(int index, const StreamInfo &info);
+    int appendSamples(Stream *stream);
+    int appendPackedSamples(Stream *stream);
+    void writeBuffer();
+
+private:
+    mutable QMutex m_mutex;
+    QVector<Stream *> m_streams;
+
+    QFile m_file;
+    QByteArray m_buffer;
+    // Только в потоке записи, без блокировки
+    QByteArray m_writeBuffer;
+    QTimer *m_timer;
+    bool m_recording;
+    bool m_compress;
+    bool m_packed;
+};
+
+#endif // VECSSESSIONRECORDER_H
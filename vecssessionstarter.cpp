@@ -0,0 +1,272 @@
+#include "vecssessionstarter.h"
+#include <QDebug>
+
+VecsSessionStarter::VecsSessionStarter(QObject *parent) :
+    QObject(parent),
+    m_maxConcurrency(2),
+    m_timeout(20000),
+    m_inFlight(0),
+    m_ready(0),
+    m_failed(0),
+    m_running(false),
+    m_elapsed(0),
+    m_timer(new QTimer(this))
+{
+    m_timer->setInterval(250);
+    connect(m_timer, &QTimer::timeout, this, &VecsSessionStarter::checkTimeouts);
+}
+
+int VecsSessionStarter::maxConcurrency() const
+{
+    return m_maxConcurrency;
+}
+
+void VecsSessionStarter::setMaxConcurrency(int maxConcurrency)
+{
+    m_maxConcurrency = qMax(1, maxConcurrency);
+    if (m_running)
+        launch();
+}
+
+int VecsSessionStarter::timeout() const
+{
+    return m_timeout;
+}
+
+void VecsSessionStarter::setTimeout(int timeout)
+{
+    m_timeout = qMax(1000, timeout);
+}
+
+bool VecsSessionStarter::running() const
+{
+    return m_running;
+}
+
+int VecsSessionStarter::total() const
+{
+    return m_entries.size();
+}
+
+int VecsSessionStarter::ready() const
+{
+    return m_ready;
+}
+
+int VecsSessionStarter::failed() const
+{
+    return m_failed;
+}
+
+int VecsSessionStarter::elapsed() const
+{
+    return m_running ? int(m_clock.elapsed()) : m_elapsed;
+}
+
+QVariantMap VecsSessionStarter::results() const
+{
+    QVariantMap results;
+    for (const auto& entry : m_entries)
+        results.insert(entry.address, entry.readyTime);
+    return results;
+}
+
+void VecsSessionStarter::start(const QList<VecsDevice *> &devices)
+{
+    cancel();
+
+    m_entries.clear();
+    m_inFlight = m_ready = m_failed = 0;
+    m_clock.start();
+
+    for (const auto& dev : devices) {
+        Entry entry;
+        entry.device = dev;
+        entry.address = dev->address();
+        entry.phase = Waiting;
+        entry.needsMpu = false;
+        entry.started = 0;
+        entry.readyTime = -1;
+
+        switch (dev->role()) {
+        case VecsDevice::RoleUndefined:
+            dev->disconnectFromDevice();
+            continue;
+        case VecsDevice::RoleDoctor:
+            if (dev->connectionState() == VecsDevice::StateConnected) {
+                if (dev->mpuState())
+                    dev->mpuStop();
+                entry.phase = Ready;
+                entry.readyTime = 0;
+            }
+            break;
+        case VecsDevice::RolePatientHand:
+        case VecsDevice::RolePatientBack:
+            entry.needsMpu = true;
+            if (dev->connectionState() == VecsDevice::StateConnected) {
+                dev->mpuStart();
+                entry.phase = Configuring;
+            }
+            break;
+        }
+
+        // Подключение, начатое до запуска сеанса, тоже занимает слот
+        if (entry.phase == Waiting && dev->connectionState() == VecsDevice::StateConnecting) {
+            entry.phase = Connecting;
+            m_inFlight++;
+        }
+
+        if (entry.phase == Ready)
+            m_ready++;
+
+        connect(dev, &VecsDevice::stateChanged, this, &VecsSessionStarter::deviceStateChanged);
+        connect(dev, &VecsDevice::firstSampleReceived, this, &VecsSessionStarter::deviceFirstSample);
+        m_entries.append(entry);
+    }
+
+    m_running = true;
+    emit runningChanged();
+
+    m_timer->start();
+    launch();
+
+    emit progressChanged();
+    if (m_ready + m_failed == m_entries.size())
+        finish();
+}
+
+void VecsSessionStarter::cancel()
+{
+    if (!m_running)
+        return;
+
+    for (const auto& entry : m_entries) {
+        if (entry.device != nullptr)
+            disconnect(entry.device, nullptr, this, nullptr);
+    }
+
+    m_timer->stop();
+    m_elapsed = int(m_clock.elapsed());
+    m_running = false;
+    emit runningChanged();
+}
+
+void VecsSessionStarter::launch()
+{
+    for (auto& entry : m_entries) {
+        if (m_inFlight >= m_maxConcurrency)
+            break;
+        if (entry.phase != Waiting || entry.device == nullptr)
+            continue;
+
+        entry.phase = Connecting;
+        entry.started = m_clock.elapsed();
+        m_inFlight++;
+
+        // Для ролей пациента MPU запустится автоматически после обнаружения сервиса
+        entry.device->connectToDevice();
+    }
+}
+
+void VecsSessionStarter::deviceStateChanged()
+{
+    Entry *entry = find(sender());
+    if (entry == nullptr || entry->device == nullptr)
+        return;
+
+    const VecsDevice::ConnectionState state = entry->device->connectionState();
+
+    if (entry->phase == Connecting) {
+        if (state == VecsDevice::StateConnected) {
+            // Сервисы найдены: слот отдается следующему устройству, детали сервисов
+            // и настройка MPU продолжаются параллельно
+            m_inFlight--;
+            if (entry->needsMpu)
+                entry->phase = Configuring;
+            else
+                complete(entry, true);
+            launch();
+        } else if (state == VecsDevice::StateDisconnected) {
+            m_inFlight--;
+            complete(entry, false, "connection failed");
+            launch();
+        }
+    } else if (entry->phase == Configuring && state == VecsDevice::StateDisconnected) {
+        complete(entry, false, "connection lost");
+    }
+}
+
+void VecsSessionStarter::deviceFirstSample()
+{
+    Entry *entry = find(sender());
+    if (entry != nullptr && entry->phase == Configuring)
+        complete(entry, true);
+}
+
+void VecsSessionStarter::checkTimeouts()
+{
+    const qint64 now = m_clock.elapsed();
+
+    for (auto& entry : m_entries) {
+        if (entry.phase != Connecting && entry.phase != Configuring)
+            continue;
+
+        if (entry.device == nullptr) {
+            if (entry.phase == Connecting)
+                m_inFlight--;
+            complete(&entry, false, "device removed");
+            continue;
+        }
+
+        if (now - entry.started < m_timeout)
+            continue;
+
+        // Зависшее подключение отменяется, чтобы освободить адаптер
+        if (entry.phase == Connecting) {
+            m_inFlight--;
+            entry.device->disconnectFromDevice();
+        }
+        complete(&entry, false, "timeout");
+    }
+
+    if (m_running)
+        launch();
+}
+
+void VecsSessionStarter::complete(Entry *entry, bool ok, const QString &reason)
+{
+    if (ok) {
+        entry->phase = Ready;
+        entry->readyTime = int(m_clock.elapsed());
+        m_ready++;
+        qDebug() << "device [" << entry->address << "] ready after" << entry->readyTime << "ms";
+        emit deviceReady(entry->device, entry->readyTime);
+    } else {
+        entry->phase = Failed;
+        m_failed++;
+        qDebug() << "device [" << entry->address << "] failed:" << reason;
+        emit deviceFailed(entry->address, reason);
+    }
+
+    emit progressChanged();
+
+    if (m_ready + m_failed == m_entries.size())
+        finish();
+}
+
+void VecsSessionStarter::finish()
+{
+    cancel();
+    qDebug() << "session started in" << m_elapsed << "ms:" << m_ready << "ready," << m_failed << "failed";
+    emit progressChanged();
+    emit finished(m_elapsed);
+}
+
+VecsSessionStarter::Entry *VecsSessionStarter::find(QObject *device)
+{
+    for (auto& entry : m_entries) {
+        if (entry.device == device)
+            return &entry;
+    }
+    return nullptr;
+}
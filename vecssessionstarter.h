@@ -0,0 +1,105 @@
+#ifndef VECSSESSIONSTARTER_H
+#define VECSSESSIONSTARTER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QTimer>
+#include <QVariantMap>
+#include "vecsdevice.h"
+
+/*
+ * Запуск сеанса на всех устройствах. Одновременно подключается не больше
+ * maxConcurrency устройств (адаптер плохо переносит много параллельных запросов
+ * на соединение), но слот освобождается сразу после обнаружения сервисов:
+ * получение деталей сервисов и настройка MPU одного устройства идут параллельно
+ * с подключением следующих. Устройство, которое не стало готовым за timeout,
+ * считается неудачным и не задерживает остальные.
+ *
+ * Устройство готово, когда от него пришел первый отсчет MPU (роли пациента)
+ * или когда оно подключено (врач). Время считается от начала запуска сеанса.
+ */
+class VecsSessionStarter : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(int total READ total NOTIFY progressChanged)
+    Q_PROPERTY(int ready READ ready NOTIFY progressChanged)
+    Q_PROPERTY(int failed READ failed NOTIFY progressChanged)
+    Q_PROPERTY(int elapsed READ elapsed NOTIFY progressChanged)
+    // Адрес устройства -> время до готовности, мс (-1, если устройство не стало готовым)
+    Q_PROPERTY(QVariantMap results READ results NOTIFY progressChanged)
+
+public:
+    explicit VecsSessionStarter(QObject *parent = 0);
+
+    int maxConcurrency() const;
+    void setMaxConcurrency(int maxConcurrency);
+    // Время на подключение и первый отсчет одного устройства, мс
+    int timeout() const;
+    void setTimeout(int timeout);
+
+    bool running() const;
+    int total() const;
+    int ready() const;
+    int failed() const;
+    int elapsed() const;
+    QVariantMap results() const;
+
+public slots:
+    void start(const QList<VecsDevice *> &devices);
+    void cancel();
+
+signals:
+    void runningChanged();
+    void progressChanged();
+    void deviceReady(VecsDevice *device, int elapsed);
+    // Адрес, а не устройство: к моменту отказа оно могло быть уже удалено
+    void deviceFailed(const QString &address, const QString &reason);
+    void finished(int elapsed);
+
+private slots:
+    void deviceStateChanged();
+    void deviceFirstSample();
+    void checkTimeouts();
+
+private:
+    enum Phase {
+        Waiting,        // Ждет свободного слота подключения
+        Connecting,     // Занимает слот
+        Configuring,    // Подключено, ждем первого отсчета
+        Ready,
+        Failed
+    };
+
+    struct Entry {
+        QPointer<VecsDevice> device;
+        QString address;
+        Phase phase;
+        bool needsMpu;
+        qint64 started;
+        int readyTime;
+    };
+
+    void launch();
+    void complete(Entry *entry, bool ok, const QString &reason = QString());
+    void finish();
+    Entry *find(QObject *device);
+
+private:
+    int m_maxConcurrency;
+    int m_timeout;
+
+    QList<Entry> m_entries;
+    int m_inFlight;
+    int m_ready;
+    int m_failed;
+    bool m_running;
+    int m_elapsed;
+
+    QElapsedTimer m_clock;
+    QTimer *m_timer;
+};
+
+#endif // VECSSESSIONSTARTER_H
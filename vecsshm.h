@@ -0,0 +1,135 @@
+/*
+ * Разделяемая память VECS: потоки MPU всех устройств для процессов на той же машине.
+ * Заголовок на чистом C, без Qt; область публикует VecsShmPublisher.
+ *
+ *   int fd = shm_open(VECS_SHM_NAME, O_RDONLY, 0);
+ *   const vecs_shm_header *h = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+ *
+ * Размер области - vecs_shm_size(h) (сначала отобразить sizeof(vecs_shm_header)).
+ * Расположение: заголовок, max_devices описаний устройств, затем кольца отсчетов
+ * устройств подряд, по capacity отсчетов (степень двойки).
+ *
+ * Писатель один. Отсчет seq устройства лежит в samples[seq & (capacity - 1)], head -
+ * число записанных в слот отсчетов; он только растет, в том числе когда слот занимает
+ * другое устройство (об этом сообщает generation). Чтение без блокировок и копирования:
+ * прочитать head, читать отсчеты прямо из области, затем vecs_shm_valid() подтверждает,
+ * что писатель их не перезаписал (иначе прочитать заново). Последние n отсчетов: seq
+ * от head - n до head - 1, n < capacity и n <= head.
+ *
+ * update увеличивается после каждой публикации новых отсчетов; на Linux ждать его
+ * изменения можно через vecs_shm_wait() (futex; в строгом C99 нужен _GNU_SOURCE),
+ * иначе опрашивать.
+ * generation устройства меняется при смене устройства в слоте или его настроек
+ * (нечетное значение - описание меняется прямо сейчас).
+ */
+#ifndef VECSSHM_H
+#define VECSSHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VECS_SHM_NAME       "/vecs"
+#define VECS_SHM_MAGIC      0x4d485356u     /* "VSHM" */
+#define VECS_SHM_VERSION    1
+
+/* Совпадает с VecsSample и записью файла сессии */
+typedef struct vecs_shm_sample {
+    int64_t timestamp;          /* время приема хостом, нс (см. clock_offset) */
+    uint16_t packet_index;      /* счетчик пакетов устройства */
+    uint16_t flags;             /* 0x1 - интерполированный отсчет, 0x2 - смена частоты */
+    int16_t accel[3];
+    int16_t gyro[3];
+} vecs_shm_sample;
+
+typedef struct vecs_shm_device {
+    uint64_t head;
+    uint32_t generation;
+    uint8_t active;
+    uint8_t role;               /* VecsDevice::DeviceRole */
+    uint8_t accel_range;        /* VecsDevice::AccelRange */
+    uint8_t gyro_range;         /* VecsDevice::GyroRange */
+    uint16_t mpu_rate;
+    char address[18];           /* "XX:XX:XX:XX:XX:XX" */
+    uint8_t reserved[28];
+} vecs_shm_device;
+
+typedef struct vecs_shm_header {
+    uint32_t magic;             /* записывается последним, когда область готова */
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t max_devices;
+    uint32_t capacity;
+    uint32_t sample_size;
+    uint32_t devices_offset;
+    uint32_t samples_offset;
+    uint32_t update;
+    uint32_t writer_pid;
+    uint32_t reserved0;
+    int64_t clock_offset;       /* CLOCK_MONOTONIC = timestamp + clock_offset, нс */
+    uint32_t reserved[4];
+} vecs_shm_header;
+
+static inline size_t vecs_shm_size(const vecs_shm_header *h)
+{
+    return (size_t)h->samples_offset + (size_t)h->max_devices * h->capacity * h->sample_size;
+}
+
+static inline const vecs_shm_device *vecs_shm_device_at(const vecs_shm_header *h, uint32_t device)
+{
+    return (const vecs_shm_device *)((const char *)h + h->devices_offset) + device;
+}
+
+static inline const vecs_shm_sample *vecs_shm_sample_at(const vecs_shm_header *h, uint32_t device, uint64_t seq)
+{
+    const vecs_shm_sample *ring = (const vecs_shm_sample *)((const char *)h + h->samples_offset
+                                                            + (size_t)device * h->capacity * h->sample_size);
+    return ring + (seq & (h->capacity - 1));
+}
+
+static inline uint64_t vecs_shm_head(const vecs_shm_header *h, uint32_t device)
+{
+    return __atomic_load_n(&vecs_shm_device_at(h, device)->head, __ATOMIC_ACQUIRE);
+}
+
+/* Отсчеты с номерами от seq и дальше, прочитанные до вызова, не были перезаписаны */
+static inline int vecs_shm_valid(const vecs_shm_header *h, uint32_t device, uint64_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    const uint64_t head = __atomic_load_n(&vecs_shm_device_at(h, device)->head, __ATOMIC_RELAXED);
+    return seq + h->capacity > head;
+}
+
+static inline uint32_t vecs_shm_update(const vecs_shm_header *h)
+{
+    return __atomic_load_n(&h->update, __ATOMIC_ACQUIRE);
+}
+
+#ifdef __linux__
+/* Ждет изменения update относительно last не дольше timeout_ms; 0 - дождались или значение уже другое */
+static inline int vecs_shm_wait(const vecs_shm_header *h, uint32_t last, int timeout_ms)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+    if (vecs_shm_update(h) != last)
+        return 0;
+    return (int)syscall(SYS_futex, &h->update, FUTEX_WAIT, last, &ts, NULL, 0);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VECSSHM_H */
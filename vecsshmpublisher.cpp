@@ -0,0 +1,329 @@
+#include "vecsshmpublisher.h"
+#include <QMutexLocker>
+#include <QCoreApplication>
+#include <cstddef>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// Отсчет в области копируется из VecsSample как есть
+Q_STATIC_ASSERT(sizeof(VecsSample) == sizeof(vecs_shm_sample));
+Q_STATIC_ASSERT(offsetof(VecsSample, accel) == offsetof(vecs_shm_sample, accel));
+Q_STATIC_ASSERT(sizeof(vecs_shm_header) == 64);
+Q_STATIC_ASSERT(sizeof(vecs_shm_device) == 64);
+Q_STATIC_ASSERT(sizeof(QAtomicInteger<quint64>) == sizeof(quint64));
+
+VecsShmPublisher::VecsShmPublisher(QObject *parent) :
+    QObject(parent),
+    m_name(VECS_SHM_NAME),
+    m_capacity(1024),
+    m_maxDevices(32),
+    m_interval(1),
+    m_timer(nullptr),
+    m_fd(-1),
+    m_size(0),
+    m_header(nullptr)
+{
+}
+
+VecsShmPublisher::~VecsShmPublisher()
+{
+    stop();
+    qDeleteAll(m_streams);
+}
+
+void VecsShmPublisher::addStream(const VecsSampleRing *ring, const StreamInfo &info)
+{
+    QMutexLocker locker(&m_mutex);
+
+    int slot = -1;
+    for (int i = 0; i < m_streams.size(); ++i) {
+        if (m_streams.at(i) != nullptr && m_streams.at(i)->reader.ring() == ring)
+            return;
+        if (m_streams.at(i) == nullptr && slot < 0)
+            slot = i;
+    }
+
+    if (slot < 0) {
+        if (m_streams.size() >= m_maxDevices)
+            return;
+        slot = m_streams.size();
+        m_streams.append(nullptr);
+    }
+
+    Stream *stream = new Stream;
+    stream->reader.attach(ring);
+    stream->reader.seekToHead();
+    stream->info = info;
+    stream->infoDirty = true;
+    m_streams[slot] = stream;
+}
+
+void VecsShmPublisher::updateStream(const VecsSampleRing *ring, const StreamInfo &info)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring) {
+            stream->info = info;
+            stream->infoDirty = true;
+        }
+    }
+}
+
+void VecsShmPublisher::removeStream(const VecsSampleRing *ring)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        Stream *stream = m_streams.at(i);
+        if (stream == nullptr || stream->reader.ring() != ring)
+            continue;
+
+        // Писатель области сейчас не работает (он держит тот же мьютекс)
+        if (m_header != nullptr) {
+            vecs_shm_device *dev = device(i);
+            dev->generation++;
+            dev->active = 0;
+            __atomic_store_n(&dev->generation, dev->generation + 1, __ATOMIC_RELEASE);
+        }
+        delete stream;
+        m_streams[i] = nullptr;
+    }
+}
+
+void VecsShmPublisher::setName(const QString &name)
+{
+    m_name = name.startsWith('/') ? name : '/' + name;
+}
+
+void VecsShmPublisher::setCapacity(int capacity)
+{
+    // Степень двойки: номер ячейки - младшие биты порядкового номера
+    int size = 16;
+    while (size < capacity && size < (1 << 20))
+        size <<= 1;
+    m_capacity = size;
+}
+
+void VecsShmPublisher::setMaxDevices(int maxDevices)
+{
+    m_maxDevices = qBound(1, maxDevices, 255);
+}
+
+void VecsShmPublisher::setInterval(int interval)
+{
+    m_interval = qMax(1, interval);
+    if (m_timer != nullptr)
+        m_timer->setInterval(m_interval);
+}
+
+#ifdef Q_OS_UNIX
+// Процесс, создавший существующую область (0 - неизвестен)
+static pid_t shmWriterPid(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(vecs_shm_header))
+        return 0;
+
+    void *memory = mmap(nullptr, sizeof(vecs_shm_header), PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+        return 0;
+    const pid_t pid = pid_t(static_cast<const vecs_shm_header *>(memory)->writer_pid);
+    munmap(memory, sizeof(vecs_shm_header));
+    return pid;
+}
+#endif
+
+vecs_shm_device *VecsShmPublisher::device(int slot) const
+{
+    return reinterpret_cast<vecs_shm_device *>(reinterpret_cast<char *>(m_header) + m_header->devices_offset) + slot;
+}
+
+vecs_shm_sample *VecsShmPublisher::samples(int slot) const
+{
+    return reinterpret_cast<vecs_shm_sample *>(reinterpret_cast<char *>(m_header) + m_header->samples_offset)
+            + size_t(slot) * size_t(m_capacity);
+}
+
+bool VecsShmPublisher::start()
+{
+    stop();
+
+#ifdef Q_OS_UNIX
+    QMutexLocker locker(&m_mutex);
+
+    const QByteArray name = m_name.toLocal8Bit();
+    const size_t devicesOffset = sizeof(vecs_shm_header);
+    const size_t samplesOffset = devicesOffset + size_t(m_maxDevices) * sizeof(vecs_shm_device);
+    m_size = samplesOffset + size_t(m_maxDevices) * size_t(m_capacity) * sizeof(vecs_shm_sample);
+
+    // Область работающего писателя не трогаем: его читатели увидели бы остановившийся поток.
+    // Область завершившегося (например, аварийно) процесса создается заново
+    const int existing = shm_open(name.constData(), O_RDONLY, 0);
+    if (existing >= 0) {
+        const pid_t pid = shmWriterPid(existing);
+        close(existing);
+        if (pid > 0 && pid != getpid() && (kill(pid, 0) == 0 || errno == EPERM)) {
+            emit error(QString("Shared memory %1 is in use by process %2").arg(m_name).arg(pid));
+            return false;
+        }
+        shm_unlink(name.constData());
+    }
+
+    m_fd = shm_open(name.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (m_fd < 0 || ftruncate(m_fd, off_t(m_size)) != 0) {
+        emit error(QString("Can't create shared memory %1: %2").arg(m_name, QString::fromLocal8Bit(strerror(errno))));
+        locker.unlock();
+        stop();
+        return false;
+    }
+
+    void *memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (memory == MAP_FAILED) {
+        emit error(QString("Can't map shared memory %1: %2").arg(m_name, QString::fromLocal8Bit(strerror(errno))));
+        locker.unlock();
+        stop();
+        return false;
+    }
+
+    // ftruncate заполняет область нулями: все слоты неактивны, head = 0
+    m_header = static_cast<vecs_shm_header *>(memory);
+    m_header->version = VECS_SHM_VERSION;
+    m_header->header_size = sizeof(vecs_shm_header);
+    m_header->max_devices = quint32(m_maxDevices);
+    m_header->capacity = quint32(m_capacity);
+    m_header->sample_size = sizeof(vecs_shm_sample);
+    m_header->devices_offset = quint32(devicesOffset);
+    m_header->samples_offset = quint32(samplesOffset);
+    m_header->writer_pid = quint32(QCoreApplication::applicationPid());
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    m_header->clock_offset = qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec - vecsTimestamp();
+
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr) {
+            stream->reader.seekToHead();
+            stream->infoDirty = true;
+        }
+    }
+
+    __atomic_store_n(&m_header->magic, VECS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    if (m_timer == nullptr) {
+        m_timer = new QTimer(this);
+        m_timer->setTimerType(Qt::PreciseTimer);
+        connect(m_timer, &QTimer::timeout, this, &VecsShmPublisher::poll);
+    }
+    m_timer->setInterval(m_interval);
+    m_timer->start();
+    return true;
+#else
+    emit error("Shared memory publishing requires POSIX shared memory");
+    return false;
+#endif
+}
+
+void VecsShmPublisher::stop()
+{
+    if (m_timer != nullptr)
+        m_timer->stop();
+
+#ifdef Q_OS_UNIX
+    QMutexLocker locker(&m_mutex);
+
+    // Уже подключенные читатели сохраняют отображение, новые область не найдут
+    if (m_header != nullptr) {
+        m_header->magic = 0;
+        munmap(m_header, m_size);
+        m_header = nullptr;
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        shm_unlink(m_name.toLocal8Bit().constData());
+        m_fd = -1;
+    }
+#endif
+}
+
+void VecsShmPublisher::writeInfo(int slot, const Stream *stream)
+{
+    // Описание меняется под нечетным generation, чтобы читатель мог заметить гонку
+    vecs_shm_device *dev = device(slot);
+    __atomic_store_n(&dev->generation, dev->generation + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    const QByteArray address = stream->info.address.toLatin1().left(int(sizeof(dev->address)) - 1);
+    memset(dev->address, 0, sizeof(dev->address));
+    memcpy(dev->address, address.constData(), size_t(address.size()));
+    dev->role = quint8(stream->info.role);
+    dev->accel_range = quint8(stream->info.accelRange);
+    dev->gyro_range = quint8(stream->info.gyroRange);
+    dev->mpu_rate = quint16(stream->info.mpuRate);
+    // head не сбрасывается: новое устройство в слоте продолжает нумерацию, иначе
+    // читатель принял бы старые отсчеты за новые; о смене сообщает generation
+    dev->active = 1;
+
+    __atomic_store_n(&dev->generation, dev->generation + 1, __ATOMIC_RELEASE);
+}
+
+void VecsShmPublisher::poll()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_header == nullptr)
+        return;
+
+    bool published = false;
+    for (int i = 0; i < m_streams.size(); ++i) {
+        Stream *stream = m_streams.at(i);
+        if (stream == nullptr)
+            continue;
+
+        if (stream->infoDirty) {
+            writeInfo(i, stream);
+            stream->infoDirty = false;
+        }
+
+        vecs_shm_device *dev = device(i);
+        vecs_shm_sample *ring = samples(i);
+        const quint64 mask = quint64(m_capacity - 1);
+        quint64 head = dev->head;
+
+        // head обновляется после каждого отсчета: читатель проверяет перезапись по head
+        const int count = stream->reader.drain([&](const VecsSample *data, int n) {
+            for (int k = 0; k < n; ++k, ++head) {
+                // Ячейку head нельзя менять, пока читатели могут не видеть head,
+                // объявляющий ее перезаписываемой
+                __atomic_thread_fence(__ATOMIC_RELEASE);
+                memcpy(ring + (head & mask), data + k, sizeof(vecs_shm_sample));
+                __atomic_store_n(&dev->head, head + 1, __ATOMIC_RELEASE);
+            }
+        });
+        published |= count > 0;
+    }
+
+    if (published)
+        wake();
+}
+
+void VecsShmPublisher::wake()
+{
+    __atomic_add_fetch(&m_header->update, 1, __ATOMIC_RELEASE);
+#ifdef Q_OS_LINUX
+    syscall(SYS_futex, &m_header->update, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
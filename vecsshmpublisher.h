@@ -0,0 +1,78 @@
+#ifndef VECSSHMPUBLISHER_H
+#define VECSSHMPUBLISHER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
+#include "vecssamplering.h"
+#include "vecssessionformat.h"
+#include "vecsshm.h"
+
+/*
+ * Публикация потоков MPU всех устройств в разделяемую память POSIX (расположение
+ * описано в vecsshm.h) для процессов на той же машине. Объект работает в собственном
+ * потоке: каждые interval мс читает буферы устройств своими курсорами и копирует
+ * новые отсчеты в кольца области; читатели обращаются к ним без копирования и
+ * без блокировок. Слот устройства в области - порядок добавления, освобожденные
+ * слоты используются повторно (с новым generation).
+ */
+class VecsShmPublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef VecsSessionFormat::StreamInfo StreamInfo;
+
+    explicit VecsShmPublisher(QObject *parent = 0);
+    ~VecsShmPublisher();
+
+    // Потокобезопасны
+    void addStream(const VecsSampleRing *ring, const StreamInfo &info);
+    void updateStream(const VecsSampleRing *ring, const StreamInfo &info);
+    // Вызывается до удаления буфера
+    void removeStream(const VecsSampleRing *ring);
+
+    // Задаются до start()
+    void setName(const QString &name);
+    void setCapacity(int capacity);
+    void setMaxDevices(int maxDevices);
+    void setInterval(int interval);
+
+public slots:
+    bool start();
+    void stop();
+    void poll();
+
+signals:
+    void error(const QString &message);
+
+private:
+    struct Stream {
+        VecsSampleReader reader;
+        StreamInfo info;
+        bool infoDirty;
+    };
+
+    vecs_shm_device *device(int slot) const;
+    vecs_shm_sample *samples(int slot) const;
+    void writeInfo(int slot, const Stream *stream);
+    void wake();
+
+private:
+    mutable QMutex m_mutex;
+    // Индекс - слот в области; nullptr - слот свободен
+    QVector<Stream *> m_streams;
+
+    QString m_name;
+    int m_capacity;
+    int m_maxDevices;
+    int m_interval;
+
+    QTimer *m_timer;
+    int m_fd;
+    size_t m_size;
+    vecs_shm_header *m_header;
+};
+
+#endif // VECSSHMPUBLISHER_H
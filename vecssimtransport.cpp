@@ -0,0 +1,312 @@
+#include "vecssimtransport.h"
+#include "vecstrace.h"
+#include <QDebug>
+#include <cmath>
+
+static const double Pi = 3.14159265358979323846;
+
+VecsSimConfig::VecsSimConfig() :
+    lossRate(0.0),
+    jitter(0),
+    connectTime(300),
+    disconnectInterval(0),
+    keyInterval(0),
+    seed(1)
+{
+}
+
+VecsSimTransport::VecsSimTransport(const QBluetoothAddress &address, const VecsSimConfig &config, QObject *parent) :
+    VecsTransport(address, parent),
+    m_config(config),
+    m_random(config.seed),
+    m_normalDisconnect(true),
+    m_reconnections(0),
+    m_resumeMpu(false),
+    m_batteryLevel(100),
+    m_streaming(false),
+    m_packetIndex(0),
+    m_streamStart(0),
+    m_nextPacketTime(0),
+    m_connectTimer(nullptr),
+    m_streamTimer(nullptr),
+    m_linkTimer(nullptr),
+    m_keyTimer(nullptr),
+    m_stableTimer(nullptr)
+{
+}
+
+void VecsSimTransport::open()
+{
+    if (m_connectTimer != nullptr)
+        return;
+
+    m_connectTimer = new QTimer(this);
+    m_connectTimer->setSingleShot(true);
+    connect(m_connectTimer, &QTimer::timeout, this, &VecsSimTransport::linkEstablished);
+
+    m_streamTimer = new QTimer(this);
+    m_streamTimer->setSingleShot(true);
+    m_streamTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_streamTimer, &QTimer::timeout, this, &VecsSimTransport::streamTick);
+
+    m_linkTimer = new QTimer(this);
+    m_linkTimer->setSingleShot(true);
+    connect(m_linkTimer, &QTimer::timeout, this, &VecsSimTransport::linkLost);
+
+    m_keyTimer = new QTimer(this);
+    m_keyTimer->setSingleShot(true);
+    connect(m_keyTimer, &QTimer::timeout, this, &VecsSimTransport::keyTick);
+
+    m_stableTimer = new QTimer(this);
+    m_stableTimer->setSingleShot(true);
+    m_stableTimer->setInterval(StableLinkTime);
+    connect(m_stableTimer, &QTimer::timeout, [=]() {
+        m_reconnections = 0;
+    });
+}
+
+void VecsSimTransport::connectToDevice()
+{
+    // Подключение по запросу пользователя начинает отсчет попыток заново
+    m_reconnections = 0;
+    connectLink();
+}
+
+void VecsSimTransport::connectLink()
+{
+    open();
+    VECS_TRACE_ASYNC_BEGIN("ble", "connect", m_address.toUInt64(), 0);
+
+    setConnectionState(StateConnecting);
+    m_connectTimer->start(m_config.connectTime);
+}
+
+void VecsSimTransport::disconnectFromDevice()
+{
+    if (m_connectTimer == nullptr)
+        return;
+
+    // Отменяет и ожидающее переподключение
+    m_normalDisconnect = true;
+    m_resumeMpu = false;
+    clearLinkLost();
+    if (m_connectionState != StateDisconnected)
+        linkLost();
+}
+
+void VecsSimTransport::linkEstablished()
+{
+    qDebug() << "simulated device [" << m_address.toString() << "] connected";
+    VECS_TRACE_ASYNC_END("ble", "connect", m_address.toUInt64());
+
+    m_normalDisconnect = false;
+    m_stableTimer->start();
+    emit connected();
+
+    setConnectionState(StateConnected);
+    negotiateConnectionParameters();
+    emit batteryLevelChanged(m_batteryLevel);
+
+    if (m_config.disconnectInterval > 0)
+        m_linkTimer->start(randomInterval(m_config.disconnectInterval * 1000));
+    if (m_config.keyInterval > 0)
+        m_keyTimer->start(randomInterval(m_config.keyInterval * 1000));
+
+    // Автоматически запускаем прием данных для ролей пациента,
+    // после обрыва связи - если прием шел до него
+    if (m_autoStart || m_resumeMpu)
+        mpuStart();
+    m_resumeMpu = false;
+}
+
+void VecsSimTransport::linkLost()
+{
+    m_connectTimer->stop();
+    m_streamTimer->stop();
+    m_linkTimer->stop();
+    m_keyTimer->stop();
+    m_stableTimer->stop();
+
+    if (m_streaming) {
+        if (!m_normalDisconnect)
+            m_resumeMpu = true;
+        m_streaming = false;
+        endMpuStream();
+        emit mpuStateChanged(false);
+    }
+
+    setConnectionState(StateDisconnected);
+
+    if (m_normalDisconnect)
+        return;
+
+    markLinkLost();
+    if (m_reconnections < m_maxReconnections) {
+        m_reconnections++;
+        const int delay = reconnectDelay(m_reconnections);
+        qDebug() << "Connection to simulated [" << m_address.toString() << "] lost.. trying to reconnect after" << delay << "ms";
+        QTimer::singleShot(delay, this, SLOT(reconnect()));
+    }
+}
+
+void VecsSimTransport::reconnect()
+{
+    // Пользователь мог отключить устройство, пока шла задержка
+    if (m_normalDisconnect || m_connectionState != StateDisconnected)
+        return;
+
+    markReconnectAttempt();
+    connectLink();
+}
+
+void VecsSimTransport::setConnectionParameters(double minInterval, double maxInterval, int latency, int supervisionTimeout)
+{
+    VecsTransport::setConnectionParameters(minInterval, maxInterval, latency, supervisionTimeout);
+    if (m_connectionState == StateConnected)
+        negotiateConnectionParameters();
+}
+
+void VecsSimTransport::negotiateConnectionParameters()
+{
+    if (m_connMinInterval <= 0)
+        return;
+
+    // Как реальный стек: наибольший интервал из диапазона, кратный 1.25 мс, не меньше 7.5 мс
+    const double interval = qMax(7.5, std::floor(m_connMaxInterval / 1.25) * 1.25);
+    emit connectionParametersChanged(interval, m_connLatency, m_connTimeout);
+}
+
+void VecsSimTransport::keyRequest(int delay)
+{
+    Q_UNUSED(delay)
+}
+
+void VecsSimTransport::mpuStart()
+{
+    if (m_connectionState != StateConnected)
+        return;
+
+    beginMpuStream();
+
+    m_streaming = true;
+    m_packetIndex = 0;
+    m_streamStart = vecsTimestamp();
+    m_nextPacketTime = m_streamStart + 1000000000 / m_mpuRate;
+    scheduleTick();
+
+    emit mpuStateChanged(true);
+}
+
+void VecsSimTransport::mpuStop()
+{
+    if (m_connectionState != StateConnected)
+        return;
+
+    m_streaming = false;
+    m_streamTimer->stop();
+    endMpuStream();
+
+    emit mpuStateChanged(false);
+}
+
+void VecsSimTransport::setMpuRate(int rate)
+{
+    if (rate == m_mpuRate)
+        return;
+
+    const qint64 oldPeriod = 1000000000 / m_mpuRate;
+    VecsTransport::setMpuRate(rate);
+    if (!m_streaming)
+        return;
+
+    // Следующий пакет отсчитывается от последнего отправленного уже с новым периодом
+    m_nextPacketTime += 1000000000 / m_mpuRate - oldPeriod;
+    markRateChange();
+    scheduleTick();
+}
+
+void VecsSimTransport::streamTick()
+{
+    if (!m_streaming)
+        return;
+
+    // Отдаем все пакеты, время отправки которых уже наступило
+    const qint64 period = 1000000000 / m_mpuRate;
+    const qint64 now = vecsTimestamp();
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    while (m_nextPacketTime <= now) {
+        const quint16 index = m_packetIndex++;
+        const double t = double(m_nextPacketTime - m_streamStart) / 1e9;
+        m_nextPacketTime += period;
+
+        if (m_config.lossRate > 0.0 && chance(m_random) < m_config.lossRate)
+            continue;
+
+        // Размер уведомления MPU реального датчика
+        m_counters.addNotification(14, now);
+
+        VecsSample s;
+        s.timestamp = now;
+        s.flags = VecsSample::FlagNone;
+        s.packetIndex = index;
+        generateSample(&s, t);
+        pushSample(s);
+    }
+
+    scheduleTick();
+}
+
+void VecsSimTransport::scheduleTick()
+{
+    qint64 delay = m_nextPacketTime - vecsTimestamp();
+    if (m_config.jitter > 0) {
+        std::uniform_int_distribution<int> jitter(0, m_config.jitter * 1000000);
+        delay += jitter(m_random);
+    }
+    m_streamTimer->start(int(qMax<qint64>(0, delay / 1000000)));
+}
+
+void VecsSimTransport::generateSample(VecsSample *sample, double t)
+{
+    std::normal_distribution<double> noise(0.0, 0.01);
+
+    // Медленное сгибание (0.5 Гц, 30°) и тремор (6 Гц, 2°) вокруг оси Y
+    const double angle = 30.0 * std::sin(2 * Pi * 0.5 * t) + 2.0 * std::sin(2 * Pi * 6.0 * t);
+    const double rate = 30.0 * 2 * Pi * 0.5 * std::cos(2 * Pi * 0.5 * t) + 2.0 * 2 * Pi * 6.0 * std::cos(2 * Pi * 6.0 * t);
+    const double rad = angle * Pi / 180.0;
+
+    // Чувствительность MPU-6050: 16384 LSB/g на ±2g и 131 LSB/(°/s) на ±250°/s
+    const double accelScale = 16384.0 / (1 << m_accelRange);
+    const double gyroScale = 131.0 / (1 << m_gyroRange);
+
+    const double accel[3] = { std::sin(rad), 0.0, std::cos(rad) };
+    const double gyro[3] = { 0.0, rate, 0.0 };
+
+    for (int i = 0; i < 3; ++i) {
+        sample->accel[i] = qint16(qBound(-32768.0, (accel[i] + noise(m_random)) * accelScale, 32767.0));
+        sample->gyro[i] = qint16(qBound(-32768.0, (gyro[i] + 50 * noise(m_random)) * gyroScale, 32767.0));
+    }
+}
+
+void VecsSimTransport::keyTick()
+{
+    std::uniform_int_distribution<int> type(1, 3);
+    emit keyPressed(type(m_random));
+
+    m_keyTimer->start(randomInterval(m_config.keyInterval * 1000));
+}
+
+void VecsSimTransport::refreshBattery()
+{
+    // Модель разряда: один процент за каждый запрос
+    if (m_connectionState == StateConnected && m_batteryLevel > 0)
+        emit batteryLevelChanged(--m_batteryLevel);
+}
+
+int VecsSimTransport::randomInterval(int mean)
+{
+    // Экспоненциальное распределение интервалов между событиями
+    std::exponential_distribution<double> interval(1.0 / qMax(1, mean));
+    return int(qMin(interval(m_random), 1e9));
+}
@@ -0,0 +1,83 @@
+#ifndef VECSSIMTRANSPORT_H
+#define VECSSIMTRANSPORT_H
+
+#include <QTimer>
+#include <random>
+#include "vecstransport.h"
+
+// Параметры имитации канала связи
+struct VecsSimConfig
+{
+    VecsSimConfig();
+
+    double lossRate;            // Вероятность потери пакета MPU
+    int jitter;                 // Максимальная задержка доставки пакетов, мс (пакеты приходят пачками)
+    int connectTime;            // Время подключения, мс
+    int disconnectInterval;     // Среднее время между обрывами связи, с (0 - без обрывов)
+    int keyInterval;            // Среднее время между нажатиями кнопки, с (0 - без нажатий)
+    quint32 seed;
+};
+
+/*
+ * Имитация датчика: генерирует поток MPU с заданной частотой (движение руки
+ * с тремором, гравитация, шум), нажатия кнопки, потери пакетов, неравномерную
+ * доставку и обрывы связи. Позволяет проверять нагрузку и задержки без оборудования.
+ */
+class VecsSimTransport : public VecsTransport
+{
+    Q_OBJECT
+
+public:
+    VecsSimTransport(const QBluetoothAddress &address, const VecsSimConfig &config, QObject *parent = 0);
+
+public slots:
+    void open() override;
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+
+    void keyRequest(int delay) override;
+    void mpuStart() override;
+    void mpuStop() override;
+    void refreshBattery() override;
+    void setMpuRate(int rate) override;
+
+    void setConnectionParameters(double minInterval, double maxInterval, int latency, int supervisionTimeout) override;
+
+private slots:
+    void linkEstablished();
+    void linkLost();
+    void reconnect();
+    void streamTick();
+    void keyTick();
+
+private:
+    void connectLink();
+    void generateSample(VecsSample *sample, double t);
+    int randomInterval(int mean);
+    void scheduleTick();
+    void negotiateConnectionParameters();
+
+private:
+    VecsSimConfig m_config;
+    std::mt19937 m_random;
+
+    bool m_normalDisconnect;
+    int m_reconnections;
+    bool m_resumeMpu;
+    int m_batteryLevel;
+
+    bool m_streaming;
+    quint16 m_packetIndex;
+    qint64 m_streamStart;
+    qint64 m_nextPacketTime;
+
+    QTimer *m_connectTimer;
+    QTimer *m_streamTimer;
+    QTimer *m_linkTimer;
+    QTimer *m_keyTimer;
+    // Сбрасывает m_reconnections, если связь продержалась StableLinkTime
+    QTimer *m_stableTimer;
+};
+
+#endif // VECSSIMTRANSPORT_H
@@ -0,0 +1,314 @@
+#include "vecsstreamaligner.h"
+#include <QMutexLocker>
+#include <queue>
+#include <vector>
+#include <functional>
+
+// Поток считается активным, если присылал отсчеты за это время (плюс maxLatency), нс
+static const qint64 ActiveTimeout = 1000000000;
+
+VecsAlignedFrame::VecsAlignedFrame() :
+    timestamp(0),
+    validMask(0)
+{
+}
+
+VecsStreamAligner::VecsStreamAligner(QObject *parent) :
+    QObject(parent),
+    m_framePeriod(10000000),
+    m_maxLatency(50000000),
+    m_frameIndex(0),
+    m_active(0),
+    m_frames(0),
+    m_incompleteFrames(0),
+    m_lateSamples(0),
+    m_timer(nullptr)
+{
+    qRegisterMetaType<VecsAlignedFrame>();
+}
+
+VecsStreamAligner::~VecsStreamAligner()
+{
+    qDeleteAll(m_streams);
+}
+
+int VecsStreamAligner::addStream(const VecsSampleRing *ring, int rate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        if (m_streams.at(i) != nullptr && m_streams.at(i)->reader.ring() == ring)
+            return i;
+    }
+
+    Stream *stream = new Stream;
+    stream->reader.attach(ring);
+    stream->reader.seekToHead();
+    stream->clock.reset(rate);
+    stream->rate = rate;
+    stream->lastArrival = 0;
+
+    // Номера удаленных потоков используются повторно
+    int index = m_streams.indexOf(nullptr);
+    if (index < 0) {
+        if (m_streams.size() >= MaxStreams) {
+            delete stream;
+            return -1;
+        }
+        index = m_streams.size();
+        m_streams.append(stream);
+    } else {
+        m_streams[index] = stream;
+    }
+
+    return index;
+}
+
+void VecsStreamAligner::updateStream(const VecsSampleRing *ring, int rate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring) {
+            stream->clock.setRate(rate);
+            stream->rate = rate;
+        }
+    }
+}
+
+void VecsStreamAligner::removeStream(const VecsSampleRing *ring)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        if (m_streams.at(i) != nullptr && m_streams.at(i)->reader.ring() == ring) {
+            delete m_streams.at(i);
+            m_streams[i] = nullptr;
+            m_frame.validMask &= ~(1u << i);
+            m_active &= ~(1u << i);
+        }
+    }
+}
+
+int VecsStreamAligner::streamIndex(const VecsSampleRing *ring) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        if (m_streams.at(i) != nullptr && m_streams.at(i)->reader.ring() == ring)
+            return i;
+    }
+    return -1;
+}
+
+int VecsStreamAligner::frameRate() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(1000000000 / m_framePeriod);
+}
+
+void VecsStreamAligner::setFrameRate(int rate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Открытый кадр сначала выдается со старым периодом
+    finishFrame();
+    m_framePeriod = 1000000000 / qBound(1, rate, 1000);
+    m_frameIndex = 0;
+}
+
+int VecsStreamAligner::maxLatency() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_maxLatency / 1000000);
+}
+
+void VecsStreamAligner::setMaxLatency(int latency)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxLatency = qint64(qMax(0, latency)) * 1000000;
+}
+
+quint64 VecsStreamAligner::frames() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_frames;
+}
+
+quint64 VecsStreamAligner::incompleteFrames() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_incompleteFrames;
+}
+
+quint64 VecsStreamAligner::lateSamples() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_lateSamples;
+}
+
+void VecsStreamAligner::start()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Выравнивание начинается с текущего момента, старые отсчеты в буферах пропускаются
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr) {
+            stream->reader.seekToHead();
+            stream->pending.clear();
+        }
+    }
+    m_frame.validMask = 0;
+    m_frameIndex = 0;
+
+    if (m_timer == nullptr) {
+        m_timer = new QTimer(this);
+        m_timer->setTimerType(Qt::PreciseTimer);
+        m_timer->setInterval(5);
+        connect(m_timer, &QTimer::timeout, this, &VecsStreamAligner::process);
+    }
+    m_timer->start();
+}
+
+void VecsStreamAligner::stop()
+{
+    if (m_timer == nullptr || !m_timer->isActive())
+        return;
+
+    process();
+
+    QMutexLocker locker(&m_mutex);
+    m_timer->stop();
+    finishFrame();
+
+    const QVector<VecsAlignedFrame> ready = m_ready;
+    m_ready.clear();
+    locker.unlock();
+
+    for (const auto& frame : ready)
+        emit frameReady(frame);
+}
+
+void VecsStreamAligner::process()
+{
+    QMutexLocker locker(&m_mutex);
+
+    const qint64 now = vecsTimestamp();
+
+    // Новые отсчеты каждого потока переводятся на часы датчика
+    for (const auto& stream : m_streams) {
+        if (stream == nullptr)
+            continue;
+
+        stream->reader.drain([&](const VecsSample *data, int n) {
+            for (int i = 0; i < n; ++i) {
+                // Смену частоты на ходу (FlagRateChange) учитывает сама оценка часов
+                VecsSample s = data[i];
+                s.timestamp = stream->clock.correct(data[i]);
+                stream->pending.enqueue(s);
+            }
+            stream->lastArrival = now;
+        });
+    }
+
+    m_active = activeMask(now);
+
+    // Слияние потоков по скорректированному времени: очередь с приоритетом по первым отсчетам
+    typedef std::pair<qint64, int> Head;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head> > heads;
+    quint32 ready = 0;
+    for (int i = 0; i < m_streams.size(); ++i) {
+        if (m_streams.at(i) != nullptr && !m_streams.at(i)->pending.isEmpty()) {
+            heads.push(Head(m_streams.at(i)->pending.head().timestamp, i));
+            ready |= 1u << i;
+        }
+    }
+
+    const qint64 deadline = now - m_maxLatency;
+    while (!heads.empty()) {
+        const Head head = heads.top();
+
+        // Пока у активного потока нет данных, его следующий отсчет может оказаться раньше;
+        // ждем его не дольше maxLatency
+        if ((ready & m_active) != m_active && head.first > deadline)
+            break;
+
+        heads.pop();
+        Stream *stream = m_streams.at(head.second);
+        place(head.second, stream->pending.dequeue());
+
+        if (stream->pending.isEmpty())
+            ready &= ~(1u << head.second);
+        else
+            heads.push(Head(stream->pending.head().timestamp, head.second));
+    }
+
+    // Открытый кадр выдается, когда в него уже не может попасть ни один отсчет
+    if (m_frame.validMask != 0 && m_frame.timestamp + m_framePeriod / 2 <= deadline)
+        finishFrame();
+
+    if (m_ready.isEmpty())
+        return;
+
+    const QVector<VecsAlignedFrame> frames = m_ready;
+    m_ready.clear();
+    locker.unlock();
+
+    for (const auto& frame : frames)
+        emit frameReady(frame);
+}
+
+void VecsStreamAligner::place(int stream, const VecsSample &sample)
+{
+    const qint64 index = (sample.timestamp + m_framePeriod / 2) / m_framePeriod;
+    if (index < m_frameIndex) {
+        m_lateSamples++;
+        return;
+    }
+
+    if (index > m_frameIndex) {
+        finishFrame();
+        m_frameIndex = index;
+    }
+
+    if (m_frame.validMask == 0) {
+        m_frame.timestamp = m_frameIndex * m_framePeriod;
+        m_frame.samples.fill(VecsSample(), m_streams.size());
+    } else if (m_frame.samples.size() <= stream) {
+        m_frame.samples.resize(m_streams.size());
+    }
+
+    // Из нескольких отсчетов потока в кадре остается ближайший ко времени кадра
+    const quint32 bit = 1u << stream;
+    VecsSample &slot = m_frame.samples[stream];
+    if (!(m_frame.validMask & bit)
+            || qAbs(sample.timestamp - m_frame.timestamp) < qAbs(slot.timestamp - m_frame.timestamp)) {
+        slot = sample;
+    }
+    m_frame.validMask |= bit;
+}
+
+void VecsStreamAligner::finishFrame()
+{
+    if (m_frame.validMask == 0)
+        return;
+
+    if ((m_frame.validMask & m_active) != m_active)
+        m_incompleteFrames++;
+    m_frames++;
+
+    m_ready.append(m_frame);
+    m_frame.validMask = 0;
+    m_frameIndex++;
+}
+
+quint32 VecsStreamAligner::activeMask(qint64 now) const
+{
+    quint32 mask = 0;
+    for (int i = 0; i < m_streams.size(); ++i) {
+        const Stream *stream = m_streams.at(i);
+        if (stream != nullptr && stream->lastArrival > 0 && now - stream->lastArrival < ActiveTimeout + m_maxLatency)
+            mask |= 1u << i;
+    }
+    return mask;
+}
@@ -0,0 +1,109 @@
+#ifndef VECSSTREAMALIGNER_H
+#define VECSSTREAMALIGNER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QQueue>
+#include <QTimer>
+#include <QVector>
+#include "vecssamplering.h"
+#include "vecsstreamclock.h"
+
+// Кадр с отсчетами всех потоков, приведенными к общему времени
+struct VecsAlignedFrame
+{
+    VecsAlignedFrame();
+
+    qint64 timestamp;               // Время кадра (кратно периоду кадров), нс
+    quint32 validMask;              // Бит i установлен, если в кадре есть отсчет потока i
+    QVector<VecsSample> samples;    // По одному отсчету на поток, timestamp - скорректированное время
+};
+
+Q_DECLARE_METATYPE(VecsAlignedFrame)
+
+/*
+ * Выравнивание потоков MPU нескольких датчиков (врач, рука, спина) по времени.
+ * Объект работает в собственном потоке: по таймеру читает кольцевые буферы устройств
+ * своими курсорами, пересчитывает время каждого отсчета по оценке часов датчика
+ * (VecsStreamClock) и сливает потоки в один упорядоченный по времени (k-way merge).
+ * Отсчеты раскладываются по кадрам с общим периодом; кадр выдается, когда пришли
+ * отсчеты следующего кадра, но не позже maxLatency после его времени - отстающий
+ * или замолчавший датчик не задерживает остальные.
+ */
+class VecsStreamAligner : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Номер потока соответствует биту в VecsAlignedFrame::validMask
+    enum { MaxStreams = 32 };
+
+    explicit VecsStreamAligner(QObject *parent = 0);
+    ~VecsStreamAligner();
+
+    // Потокобезопасны; возвращает номер потока или -1
+    int addStream(const VecsSampleRing *ring, int rate);
+    // Смена частоты MPU: применяется с первого отсчета новой частоты, оценка
+    // дрейфа часов датчика сохраняется
+    void updateStream(const VecsSampleRing *ring, int rate);
+    // Вызывается до удаления буфера; номер потока больше не используется
+    void removeStream(const VecsSampleRing *ring);
+    int streamIndex(const VecsSampleRing *ring) const;
+
+    int frameRate() const;
+    void setFrameRate(int rate);
+    // Максимальная задержка выдачи кадра относительно его времени, мс
+    int maxLatency() const;
+    void setMaxLatency(int latency);
+
+    quint64 frames() const;
+    // Кадры, выданные по таймауту без отсчетов части активных потоков
+    quint64 incompleteFrames() const;
+    // Отсчеты, пришедшие после выдачи своего кадра
+    quint64 lateSamples() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void frameReady(const VecsAlignedFrame &frame);
+
+private slots:
+    void process();
+
+private:
+    struct Stream {
+        VecsSampleReader reader;
+        VecsStreamClock clock;
+        int rate;
+        QQueue<VecsSample> pending;
+        qint64 lastArrival;
+    };
+
+    void place(int stream, const VecsSample &sample);
+    void finishFrame();
+    quint32 activeMask(qint64 now) const;
+
+private:
+    mutable QMutex m_mutex;
+    QVector<Stream *> m_streams;
+
+    qint64 m_framePeriod;
+    qint64 m_maxLatency;
+
+    // Индекс открытого кадра (или следующего, если открытого нет)
+    qint64 m_frameIndex;
+    VecsAlignedFrame m_frame;
+    quint32 m_active;
+    // Готовые кадры выдаются после снятия блокировки
+    QVector<VecsAlignedFrame> m_ready;
+
+    quint64 m_frames;
+    quint64 m_incompleteFrames;
+    quint64 m_lateSamples;
+
+    QTimer *m_timer;
+};
+
+#endif // VECSSTREAMALIGNER_H
@@ -0,0 +1,139 @@
+#include "vecsstreamclock.h"
+#include <cmath>
+
+// Окно усреднения оценки периода, с
+static const int ClockWindow = 10;
+// Скачок счетчика больше этого значения считается началом нового потока
+static const int ResyncThreshold = 4096;
+// Допустимое отклонение частоты кварца от номинала
+static const double MaxDrift = 0.01;
+
+VecsStreamClock::VecsStreamClock(int rate)
+{
+    reset(rate);
+}
+
+void VecsStreamClock::reset(int rate)
+{
+    m_rate = qMax(1, rate);
+    m_nextRate = m_rate;
+    m_nominal = 1e9 / m_rate;
+    m_period = m_nominal;
+    m_started = false;
+    m_lastIndex = 0;
+    m_sequence = 0;
+    m_origin = 0;
+    m_count = 0;
+    m_meanN = m_meanT = m_varN = m_covNT = 0.0;
+    m_envelope = 0.0;
+    m_jitter = 0.0;
+    m_lastCorrected = 0;
+}
+
+void VecsStreamClock::setRate(int rate)
+{
+    m_nextRate = qMax(1, rate);
+}
+
+int VecsStreamClock::rate() const
+{
+    return m_rate;
+}
+
+void VecsStreamClock::restart(const VecsSample &sample)
+{
+    reset(m_nextRate);
+    m_started = true;
+    m_lastIndex = sample.packetIndex;
+    m_origin = sample.timestamp;
+}
+
+void VecsStreamClock::changeRate(const VecsSample &sample)
+{
+    // Дрейф кварца от частоты не зависит: отношение периода к номиналу переносится
+    // на новую частоту, а регрессия строится заново от этого отсчета
+    const double ratio = m_period / m_nominal;
+    const double jitter = m_jitter;
+    const qint64 lastCorrected = m_lastCorrected;
+
+    restart(sample);
+    m_period = m_nominal * ratio;
+    m_jitter = jitter;
+    m_lastCorrected = lastCorrected;
+}
+
+qint64 VecsStreamClock::correct(const VecsSample &sample)
+{
+    if (!m_started) {
+        restart(sample);
+    } else if (sample.flags & VecsSample::FlagRateChange) {
+        changeRate(sample);
+    } else {
+        // Отсчеты в буфере упорядочены, поэтому шаг назад означает перезапуск MPU
+        const int delta = qint16(sample.packetIndex - m_lastIndex);
+        if (delta <= 0 || delta > ResyncThreshold)
+            restart(sample);
+        else
+            m_sequence += delta;
+        m_lastIndex = sample.packetIndex;
+    }
+
+    const double n = double(m_sequence);
+    const double t = double(sample.timestamp - m_origin);
+
+    // Интерполированные отсчеты несут вычисленное время и в оценку не попадают
+    if (!(sample.flags & VecsSample::FlagSynthetic)) {
+        m_count++;
+
+        // Пока окно не заполнено, усредняем равномерно
+        const double window = double(m_rate) * ClockWindow;
+        const double a = 1.0 / qMin(double(m_count), window);
+
+        const double dn = n - m_meanN;
+        const double dt = t - m_meanT;
+        m_meanN += a * dn;
+        m_meanT += a * dt;
+        m_varN = (1.0 - a) * (m_varN + a * dn * dn);
+        m_covNT = (1.0 - a) * (m_covNT + a * dn * dt);
+
+        // Наклон надежен, только когда отсчеты охватывают хотя бы секунду
+        if (m_varN > double(m_rate) * m_rate / 12.0) {
+            const double period = m_covNT / m_varN;
+            if (std::fabs(period / m_nominal - 1.0) < MaxDrift)
+                m_period = period;
+        }
+
+        // Нижняя огибающая медленно поднимается, чтобы отследить рост минимальной задержки
+        const double residual = t - (m_meanT + m_period * (n - m_meanN));
+        if (m_count == 1 || residual < m_envelope)
+            m_envelope = residual;
+        else
+            m_envelope += m_period * 1e-3;
+
+        m_jitter += a * (std::fabs(residual - m_envelope) - m_jitter);
+    }
+
+    qint64 corrected = m_origin + qint64(m_meanT + m_period * (n - m_meanN) + m_envelope);
+
+    // Время потока не должно идти назад при уточнении оценки
+    if (corrected <= m_lastCorrected)
+        corrected = m_lastCorrected + 1;
+    m_lastCorrected = corrected;
+
+    return corrected;
+}
+
+double VecsStreamClock::period() const
+{
+    return m_period;
+}
+
+double VecsStreamClock::drift() const
+{
+    return (m_nominal / m_period - 1.0) * 1e6;
+}
+
+double VecsStreamClock::jitter() const
+{
+    return m_jitter;
+}
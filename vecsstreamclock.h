@@ -0,0 +1,67 @@
+#ifndef VECSSTREAMCLOCK_H
+#define VECSSTREAMCLOCK_H
+
+#include <QtGlobal>
+#include "vecssamplering.h"
+
+/*
+ * Оценка часов датчика по счетчику пакетов и времени приема.
+ * Датчик отправляет пакеты с постоянным периодом своего кварца, а хост принимает их
+ * с переменной задержкой (интервал соединения BLE, планировщик ОС). По парам
+ * (номер пакета, время приема) строится экспоненциально взвешенная линейная регрессия:
+ * ее наклон - реальный период датчика (дрейф относительно номинала), а нижняя огибающая
+ * остатков - минимальная задержка доставки. Скорректированное время отсчета лежит на
+ * прямой регрессии, сдвинутой к нижней огибающей, поэтому в нем нет ни дрейфа, ни джиттера.
+ * Используется только одним потоком.
+ */
+class VecsStreamClock
+{
+public:
+    explicit VecsStreamClock(int rate = 100);
+
+    // Начинает оценку заново (новый поток MPU)
+    void reset(int rate);
+    // Новая номинальная частота: вступает в силу с отсчетом, помеченным
+    // VecsSample::FlagRateChange, или с перезапуском потока. Оценка дрейфа
+    // кварца при смене частоты на ходу сохраняется
+    void setRate(int rate);
+    int rate() const;
+
+    // Время отсчета по часам датчика, приведенное к vecsTimestamp(), нс
+    qint64 correct(const VecsSample &sample);
+
+    // Оценка периода датчика, нс
+    double period() const;
+    // Отклонение частоты датчика от номинала, ppm
+    double drift() const;
+    // Средний разброс задержки доставки относительно минимальной, нс
+    double jitter() const;
+
+private:
+    void restart(const VecsSample &sample);
+    void changeRate(const VecsSample &sample);
+
+private:
+    int m_rate;
+    int m_nextRate;
+    double m_nominal;
+
+    bool m_started;
+    quint16 m_lastIndex;
+    qint64 m_sequence;          // Счетчик пакетов без переполнения
+    qint64 m_origin;            // Время приема первого отсчета, от него считаются все времена
+    quint64 m_count;
+
+    // Экспоненциально взвешенные средние и ковариации (номер пакета, время)
+    double m_meanN;
+    double m_meanT;
+    double m_varN;
+    double m_covNT;
+
+    double m_period;
+    double m_envelope;
+    double m_jitter;
+    qint64 m_lastCorrected;
+};
+
+#endif // VECSSTREAMCLOCK_H
@@ -0,0 +1,113 @@
+#ifndef VECSSTREAMFORMAT_H
+#define VECSSTREAMFORMAT_H
+
+#include <QtGlobal>
+#include <QtEndian>
+#include "vecssamplering.h"
+#include "vecssamplecodec.h"
+
+/*
+ * Формат кадров сервера потоков (VecsStreamServer), все числа little endian.
+ * По UDP один кадр - одна датаграмма, по TCP кадры идут подряд (длина в заголовке).
+ *
+ * Заголовок кадра (24 байта):
+ *   u16 magic 0x5356 ("VS"), u8 version, u8 type, u16 device, u8 role, u8 count,
+ *   u32 sequence, u16 размер данных после заголовка, u16 reserved,
+ *   i64 timestamp (нс, время приема хостом последнего отсчета кадра)
+ *
+ *   FrameSamples   - count отсчетов по SampleSize байт:
+ *                    u16 packetIndex, u16 flags, i16 accel[3], i16 gyro[3].
+ *                    sequence - порядковый номер первого отсчета в потоке устройства
+ *                    (разрыв в sequence - отсчеты пропущены сервером)
+ *   FrameSamplesPacked - те же count отсчетов одним сжатым блоком VecsSampleCodec
+ *                    (формат в vecssamplecodec.h), с временем приема каждого отсчета.
+ *                    Сервер шлет их вместо FrameSamples, если включено сжатие
+ *   FrameKey       - u8 тип нажатия (VecsDevice::ButtonClick), 3 байта reserved
+ *   FrameDevice    - описание устройства (при подписке и при смене настроек):
+ *                    u8 role, u8 accelRange, u8 gyroRange, u8 reserved, u16 mpuRate,
+ *                    u16 длина адреса, адрес (latin1)
+ *
+ * Клиент подписывается кадром FrameSubscribe (только заголовок): в поле role маска
+ * ролей (бит 1 << role, 0 - все роли), в поле device номер устройства (0xffff - все).
+ * По UDP подписка действует SubscriptionTimeout мс и продлевается повтором кадра,
+ * FrameUnsubscribe отменяет ее сразу. По TCP подписка действует до закрытия соединения.
+ *
+ * Накладные расходы на отсчет: 16 байт данных плюс (24 байта заголовка + 28 байт
+ * UDP/IPv4) / batch, т.е. 68 байт при batch = 1 и 22.5 байта при batch = 8
+ * (полные кадры набираются, если holdTime сервера не меньше batch периодов MPU).
+ * Сжатый блок добавляет 40 байт заголовка, зато отсчет в нем занимает около 9 байт:
+ * при batch = 8 около 19 байт на отсчет, при batch = 32 около 11.5 (против 17.6).
+ */
+namespace VecsStreamFormat {
+
+const quint16 Magic = 0x5356;
+const quint8 Version = 1;
+const int HeaderSize = 24;
+const int SampleSize = 16;
+const int KeySize = 4;
+const int MaxSamples = 255;
+const quint16 AllDevices = 0xffff;
+const int SubscriptionTimeout = 10000;
+
+enum FrameType {
+    FrameSamples = 1,
+    FrameKey = 2,
+    FrameDevice = 3,
+    FrameSamplesPacked = 4,
+    FrameSubscribe = 16,
+    FrameUnsubscribe = 17
+};
+
+struct Header {
+    quint8 type;
+    quint16 device;
+    quint8 role;
+    quint8 count;
+    quint32 sequence;
+    quint16 size;
+    qint64 timestamp;
+};
+
+inline void writeHeader(uchar *p, const Header &h)
+{
+    qToLittleEndian<quint16>(Magic, p);
+    p[2] = Version;
+    p[3] = h.type;
+    qToLittleEndian<quint16>(h.device, p + 4);
+    p[6] = h.role;
+    p[7] = h.count;
+    qToLittleEndian<quint32>(h.sequence, p + 8);
+    qToLittleEndian<quint16>(h.size, p + 12);
+    qToLittleEndian<quint16>(0, p + 14);
+    qToLittleEndian<qint64>(h.timestamp, p + 16);
+}
+
+// false, если это не кадр протокола
+inline bool readHeader(const uchar *p, Header *h)
+{
+    if (qFromLittleEndian<quint16>(p) != Magic || p[2] != Version)
+        return false;
+
+    h->type = p[3];
+    h->device = qFromLittleEndian<quint16>(p + 4);
+    h->role = p[6];
+    h->count = p[7];
+    h->sequence = qFromLittleEndian<quint32>(p + 8);
+    h->size = qFromLittleEndian<quint16>(p + 12);
+    h->timestamp = qFromLittleEndian<qint64>(p + 16);
+    return true;
+}
+
+inline void writeSample(uchar *p, const VecsSample &s)
+{
+    qToLittleEndian<quint16>(s.packetIndex, p);
+    qToLittleEndian<quint16>(s.flags, p + 2);
+    for (int i = 0; i < 3; ++i) {
+        qToLittleEndian<qint16>(s.accel[i], p + 4 + 2 * i);
+        qToLittleEndian<qint16>(s.gyro[i], p + 10 + 2 * i);
+    }
+}
+
+}
+
+#endif // VECSSTREAMFORMAT_H
@@ -0,0 +1,493 @@
+#include "vecsstreamserver.h"
+#include <QMutexLocker>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <cstring>
+
+// Кадры для TCP-клиента, который не успевает читать, отбрасываются сверх этого объема
+static const qint64 MaxTcpBacklog = 256 * 1024;
+
+VecsStreamServer::VecsStreamServer(QObject *parent) :
+    QObject(parent),
+    m_udpPort(5760),
+    m_tcpPort(5761),
+    m_interval(1),
+    m_batch(1),
+    m_holdTime(10000000),
+    m_compress(false),
+    m_timer(nullptr),
+    m_udp(nullptr),
+    m_tcp(nullptr),
+    m_statsTime(0),
+    m_latencySum(0),
+    m_latencyMax(0),
+    m_latencyCount(0),
+    m_latency(0),
+    m_maxLatency(0),
+    m_samplesSent(0),
+    m_bytesSent(0)
+{
+}
+
+VecsStreamServer::~VecsStreamServer()
+{
+    stop();
+    qDeleteAll(m_streams);
+}
+
+void VecsStreamServer::addStream(const VecsSampleRing *ring, const StreamInfo &info)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring)
+            return;
+    }
+
+    if (m_streams.size() >= VecsStreamFormat::AllDevices)
+        return;
+
+    Stream *stream = new Stream;
+    stream->reader.attach(ring);
+    stream->reader.seekToHead();
+    stream->info = info;
+    stream->infoDirty = true;
+    stream->pendingSequence = 0;
+    stream->pending.reserve(m_batch);
+    m_streams.append(stream);
+}
+
+void VecsStreamServer::updateStream(const VecsSampleRing *ring, const StreamInfo &info)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring) {
+            stream->info = info;
+            stream->infoDirty = true;
+        }
+    }
+}
+
+void VecsStreamServer::removeStream(const VecsSampleRing *ring)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Номер удаленного устройства больше не используется, чтобы клиенты его не перепутали
+    for (auto& stream : m_streams) {
+        if (stream != nullptr && stream->reader.ring() == ring) {
+            delete stream;
+            stream = nullptr;
+        }
+    }
+}
+
+void VecsStreamServer::setUdpPort(quint16 port)
+{
+    m_udpPort = port;
+}
+
+void VecsStreamServer::setTcpPort(quint16 port)
+{
+    m_tcpPort = port;
+}
+
+void VecsStreamServer::setInterval(int interval)
+{
+    m_interval = qMax(1, interval);
+    if (m_timer != nullptr)
+        m_timer->setInterval(m_interval);
+}
+
+void VecsStreamServer::setBatch(int batch)
+{
+    m_batch = qBound(1, batch, VecsStreamFormat::MaxSamples);
+}
+
+void VecsStreamServer::setHoldTime(int holdTime)
+{
+    m_holdTime = qint64(qMax(0, holdTime)) * 1000000;
+}
+
+void VecsStreamServer::setCompress(bool compress)
+{
+    m_compress = compress;
+}
+
+int VecsStreamServer::latency() const
+{
+    return m_latency.load();
+}
+
+int VecsStreamServer::maxLatency() const
+{
+    return m_maxLatency.load();
+}
+
+quint64 VecsStreamServer::samplesSent() const
+{
+    return m_samplesSent.load();
+}
+
+quint64 VecsStreamServer::bytesSent() const
+{
+    return m_bytesSent.load();
+}
+
+bool VecsStreamServer::start()
+{
+    stop();
+
+    // Сервер доступен только локальным приложениям
+    if (m_udpPort != 0) {
+        m_udp = new QUdpSocket(this);
+        if (!m_udp->bind(QHostAddress::LocalHost, m_udpPort)) {
+            emit error(QString("Can't bind UDP port %1: %2").arg(m_udpPort).arg(m_udp->errorString()));
+            stop();
+            return false;
+        }
+        connect(m_udp, &QUdpSocket::readyRead, this, &VecsStreamServer::readDatagrams);
+    }
+
+    if (m_tcpPort != 0) {
+        m_tcp = new QTcpServer(this);
+        if (!m_tcp->listen(QHostAddress::LocalHost, m_tcpPort)) {
+            emit error(QString("Can't listen on TCP port %1: %2").arg(m_tcpPort).arg(m_tcp->errorString()));
+            stop();
+            return false;
+        }
+        connect(m_tcp, &QTcpServer::newConnection, this, &VecsStreamServer::acceptConnection);
+    }
+
+    if (m_timer == nullptr) {
+        m_timer = new QTimer(this);
+        m_timer->setTimerType(Qt::PreciseTimer);
+        connect(m_timer, &QTimer::timeout, this, &VecsStreamServer::poll);
+    }
+    m_timer->setInterval(m_interval);
+    m_timer->start();
+
+    m_statsTime = vecsTimestamp();
+    return true;
+}
+
+void VecsStreamServer::stop()
+{
+    if (m_timer != nullptr)
+        m_timer->stop();
+
+    for (const auto& subscriber : m_subscribers) {
+        if (subscriber.socket != nullptr)
+            subscriber.socket->deleteLater();
+    }
+    m_subscribers.clear();
+
+    delete m_udp;
+    m_udp = nullptr;
+    delete m_tcp;
+    m_tcp = nullptr;
+}
+
+bool VecsStreamServer::accepts(const Subscriber &subscriber, int device, int role) const
+{
+    return (subscriber.roleMask == 0 || (subscriber.roleMask & (1 << role))) &&
+           (subscriber.device == VecsStreamFormat::AllDevices || subscriber.device == device);
+}
+
+void VecsStreamServer::send(const QByteArray &frame, int device, int role, Subscriber *only)
+{
+    for (auto& subscriber : m_subscribers) {
+        if ((only != nullptr && &subscriber != only) || !accepts(subscriber, device, role))
+            continue;
+
+        if (subscriber.socket != nullptr) {
+            if (subscriber.socket->bytesToWrite() > MaxTcpBacklog)
+                continue;
+            subscriber.socket->write(frame);
+            subscriber.socket->flush();
+        } else if (m_udp != nullptr) {
+            m_udp->writeDatagram(frame, subscriber.address, subscriber.port);
+        }
+        m_bytesSent.fetchAndAddRelaxed(quint64(frame.size()));
+    }
+}
+
+QByteArray VecsStreamServer::deviceFrame(int device, const StreamInfo &info) const
+{
+    const QByteArray address = info.address.toLatin1();
+
+    VecsStreamFormat::Header header;
+    header.type = VecsStreamFormat::FrameDevice;
+    header.device = quint16(device);
+    header.role = quint8(info.role);
+    header.count = 0;
+    header.sequence = 0;
+    header.size = quint16(8 + address.size());
+    header.timestamp = vecsTimestamp();
+
+    QByteArray frame(VecsStreamFormat::HeaderSize + header.size, 0);
+    uchar *p = reinterpret_cast<uchar *>(frame.data());
+    VecsStreamFormat::writeHeader(p, header);
+    p += VecsStreamFormat::HeaderSize;
+    p[0] = uchar(info.role);
+    p[1] = uchar(info.accelRange);
+    p[2] = uchar(info.gyroRange);
+    qToLittleEndian<quint16>(quint16(info.mpuRate), p + 4);
+    qToLittleEndian<quint16>(quint16(address.size()), p + 6);
+    memcpy(p + 8, address.constData(), size_t(address.size()));
+    return frame;
+}
+
+void VecsStreamServer::poll()
+{
+    const qint64 now = vecsTimestamp();
+
+    // Просроченные подписки UDP (клиент не продлил подписку)
+    for (int i = m_subscribers.size() - 1; i >= 0; --i) {
+        if (m_subscribers.at(i).socket == nullptr && m_subscribers.at(i).expires < now)
+            m_subscribers.removeAt(i);
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        Stream *stream = m_streams.at(i);
+        if (stream == nullptr)
+            continue;
+
+        const int role = stream->info.role;
+        if (stream->infoDirty) {
+            send(deviceFrame(i, stream->info), i, role);
+            stream->infoDirty = false;
+        }
+
+        bool wanted = false;
+        for (const auto& subscriber : m_subscribers)
+            wanted |= accepts(subscriber, i, role);
+
+        // Без подписчиков отсчеты не кодируются, курсор просто догоняет писателя
+        if (!wanted) {
+            stream->reader.seekToHead();
+            stream->pending.clear();
+            continue;
+        }
+
+        // Кадр собирается из участков drain (и из нескольких опросов) и уходит заполненным;
+        // после пропуска в потоке начинается новый кадр: номера отсчетов в нем подряд
+        stream->reader.drain([&](const VecsSample *data, int n) {
+            const quint64 first = stream->reader.position();
+            for (int k = 0; k < n; ++k) {
+                const quint64 sequence = first + quint64(k);
+                if (!stream->pending.isEmpty() && stream->pendingSequence + quint64(stream->pending.size()) != sequence)
+                    sendSamples(i, stream);
+                if (stream->pending.isEmpty())
+                    stream->pendingSequence = sequence;
+                stream->pending.append(data[k]);
+                if (stream->pending.size() >= m_batch)
+                    sendSamples(i, stream);
+            }
+        });
+
+        // Неполный кадр ждет следующих отсчетов, пока самый старый не прождет holdTime
+        if (!stream->pending.isEmpty() && now - stream->pending.first().timestamp >= m_holdTime)
+            sendSamples(i, stream);
+    }
+
+    updateStats(now);
+}
+
+void VecsStreamServer::sendSamples(int device, Stream *stream)
+{
+    const VecsSample *data = stream->pending.constData();
+    const int count = stream->pending.size();
+    const int role = stream->info.role;
+
+    VecsStreamFormat::Header header;
+    header.type = VecsStreamFormat::FrameSamples;
+    header.device = quint16(device);
+    header.role = quint8(role);
+    header.count = quint8(count);
+    header.sequence = quint32(stream->pendingSequence);
+    header.size = quint16(count * VecsStreamFormat::SampleSize);
+    header.timestamp = data[count - 1].timestamp;
+
+    if (m_compress) {
+        // Размер сжатого блока известен только после кодирования
+        m_frame.resize(VecsStreamFormat::HeaderSize + VecsSampleCodec::maxEncodedSize(count));
+        uchar *p = reinterpret_cast<uchar *>(m_frame.data());
+        header.type = VecsStreamFormat::FrameSamplesPacked;
+        header.size = quint16(VecsSampleCodec::encode(data, count, stream->info.accelRange,
+                                                      stream->info.gyroRange, p + VecsStreamFormat::HeaderSize));
+        VecsStreamFormat::writeHeader(p, header);
+        m_frame.resize(VecsStreamFormat::HeaderSize + header.size);
+    } else {
+        m_frame.resize(VecsStreamFormat::HeaderSize + header.size);
+        uchar *p = reinterpret_cast<uchar *>(m_frame.data());
+        VecsStreamFormat::writeHeader(p, header);
+        p += VecsStreamFormat::HeaderSize;
+        for (int j = 0; j < count; ++j, p += VecsStreamFormat::SampleSize)
+            VecsStreamFormat::writeSample(p, data[j]);
+    }
+
+    send(m_frame, device, role);
+
+    const qint64 sent = vecsTimestamp();
+    for (int j = 0; j < count; ++j) {
+        const qint64 latency = sent - data[j].timestamp;
+        m_latencySum += latency;
+        m_latencyMax = qMax(m_latencyMax, latency);
+    }
+    m_latencyCount += count;
+    m_samplesSent.fetchAndAddRelaxed(quint64(count));
+
+    stream->pending.clear();
+}
+
+void VecsStreamServer::updateStats(qint64 now)
+{
+    if (now - m_statsTime < 1000000000)
+        return;
+
+    m_latency.store(m_latencyCount > 0 ? int(m_latencySum / m_latencyCount / 1000) : 0);
+    m_maxLatency.store(int(m_latencyMax / 1000));
+    m_latencySum = m_latencyMax = m_latencyCount = 0;
+    m_statsTime = now;
+    emit statsUpdated();
+}
+
+void VecsStreamServer::sendKey(const QString &address, int type)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_streams.size(); ++i) {
+        const Stream *stream = m_streams.at(i);
+        if (stream == nullptr || stream->info.address != address)
+            continue;
+
+        VecsStreamFormat::Header header;
+        header.type = VecsStreamFormat::FrameKey;
+        header.device = quint16(i);
+        header.role = quint8(stream->info.role);
+        header.count = 0;
+        header.sequence = 0;
+        header.size = VecsStreamFormat::KeySize;
+        header.timestamp = vecsTimestamp();
+
+        QByteArray frame(VecsStreamFormat::HeaderSize + VecsStreamFormat::KeySize, 0);
+        VecsStreamFormat::writeHeader(reinterpret_cast<uchar *>(frame.data()), header);
+        frame[VecsStreamFormat::HeaderSize] = char(type);
+        send(frame, i, stream->info.role);
+    }
+}
+
+void VecsStreamServer::subscribe(const VecsStreamFormat::Header &header, const QHostAddress &address,
+                                 quint16 port, QTcpSocket *socket)
+{
+    int index = -1;
+    for (int i = 0; i < m_subscribers.size(); ++i) {
+        const Subscriber &subscriber = m_subscribers.at(i);
+        if (socket != nullptr ? subscriber.socket == socket
+                              : (subscriber.socket == nullptr && subscriber.address == address && subscriber.port == port)) {
+            index = i;
+            break;
+        }
+    }
+
+    if (header.type == VecsStreamFormat::FrameUnsubscribe) {
+        if (index >= 0)
+            m_subscribers.removeAt(index);
+        return;
+    }
+    if (header.type != VecsStreamFormat::FrameSubscribe)
+        return;
+
+    // Повтор подписки UDP только продлевает ее, если фильтр не изменился
+    const bool renewal = index >= 0 && m_subscribers.at(index).roleMask == header.role &&
+                         m_subscribers.at(index).device == header.device;
+    if (index < 0) {
+        Subscriber subscriber;
+        subscriber.address = address;
+        subscriber.port = port;
+        subscriber.socket = socket;
+        m_subscribers.append(subscriber);
+        index = m_subscribers.size() - 1;
+    }
+
+    Subscriber &subscriber = m_subscribers[index];
+    subscriber.roleMask = header.role;
+    subscriber.device = header.device;
+    subscriber.expires = vecsTimestamp() + qint64(VecsStreamFormat::SubscriptionTimeout) * 1000000;
+    if (renewal)
+        return;
+
+    // Новый подписчик сначала получает описания устройств
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_streams.size(); ++i) {
+        const Stream *stream = m_streams.at(i);
+        if (stream != nullptr)
+            send(deviceFrame(i, stream->info), i, stream->info.role, &subscriber);
+    }
+}
+
+void VecsStreamServer::readDatagrams()
+{
+    while (m_udp->hasPendingDatagrams()) {
+        QByteArray datagram(int(m_udp->pendingDatagramSize()), 0);
+        QHostAddress address;
+        quint16 port = 0;
+        m_udp->readDatagram(datagram.data(), datagram.size(), &address, &port);
+
+        VecsStreamFormat::Header header;
+        if (datagram.size() >= VecsStreamFormat::HeaderSize &&
+            VecsStreamFormat::readHeader(reinterpret_cast<const uchar *>(datagram.constData()), &header))
+            subscribe(header, address, port, nullptr);
+    }
+}
+
+void VecsStreamServer::acceptConnection()
+{
+    while (m_tcp->hasPendingConnections()) {
+        QTcpSocket *socket = m_tcp->nextPendingConnection();
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::readyRead, this, &VecsStreamServer::readSubscription);
+        connect(socket, &QTcpSocket::disconnected, this, &VecsStreamServer::clientDisconnected);
+    }
+}
+
+void VecsStreamServer::readSubscription()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == nullptr)
+        return;
+
+    uchar data[VecsStreamFormat::HeaderSize];
+    while (socket->bytesAvailable() >= VecsStreamFormat::HeaderSize) {
+        socket->peek(reinterpret_cast<char *>(data), sizeof(data));
+
+        VecsStreamFormat::Header header;
+        if (!VecsStreamFormat::readHeader(data, &header)) {
+            // Поток рассинхронизирован - клиент не говорит на нашем протоколе
+            socket->abort();
+            return;
+        }
+        if (socket->bytesAvailable() < VecsStreamFormat::HeaderSize + header.size)
+            return;
+
+        socket->read(VecsStreamFormat::HeaderSize + header.size);
+        subscribe(header, socket->peerAddress(), socket->peerPort(), socket);
+    }
+}
+
+void VecsStreamServer::clientDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == nullptr)
+        return;
+
+    for (int i = m_subscribers.size() - 1; i >= 0; --i) {
+        if (m_subscribers.at(i).socket == socket)
+            m_subscribers.removeAt(i);
+    }
+    socket->deleteLater();
+}
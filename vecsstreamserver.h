@@ -0,0 +1,135 @@
+#ifndef VECSSTREAMSERVER_H
+#define VECSSTREAMSERVER_H
+
+#include <QObject>
+#include <QAtomicInteger>
+#include <QHostAddress>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
+#include "vecssamplering.h"
+#include "vecssessionformat.h"
+#include "vecsstreamformat.h"
+
+class QUdpSocket;
+class QTcpServer;
+class QTcpSocket;
+
+/*
+ * Сервер потоков MPU и нажатий кнопок для внешних приложений (движок VR и т.п.)
+ * на localhost, по UDP и TCP (формат кадров в vecsstreamformat.h).
+ * Работает в собственном потоке: каждые interval мс читает буферы устройств своими
+ * курсорами. Кадр устройства уходит, когда накопилось batch отсчетов или самый
+ * старый из них ждет дольше holdTime; при batch = 1 отсчеты отправляются сразу.
+ * Поток сбора данных с сервером не синхронизируется; отстающий TCP-клиент теряет
+ * кадры, а не задерживает остальных.
+ *
+ * Задержка от приема пакета хостом до записи в сокет усредняется за секунду
+ * (latency, maxLatency). Доставка от датчика до хоста (BLE) в нее не входит.
+ * При batch = 1 и interval = 1 мс она не превышает примерно 1 мс плюс время
+ * планирования потока, при batch > 1 - еще и holdTime.
+ */
+class VecsStreamServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef VecsSessionFormat::StreamInfo StreamInfo;
+
+    explicit VecsStreamServer(QObject *parent = 0);
+    ~VecsStreamServer();
+
+    // Потокобезопасны; номер устройства в протоколе - порядок добавления
+    void addStream(const VecsSampleRing *ring, const StreamInfo &info);
+    void updateStream(const VecsSampleRing *ring, const StreamInfo &info);
+    // Вызывается до удаления буфера
+    void removeStream(const VecsSampleRing *ring);
+
+    // Задаются до start(); порт 0 - протокол отключен
+    void setUdpPort(quint16 port);
+    void setTcpPort(quint16 port);
+    void setInterval(int interval);
+    void setBatch(int batch);
+    // Наибольшее время, которое отсчет ждет заполнения кадра, мс
+    void setHoldTime(int holdTime);
+    // Отсчеты кадрами FrameSamplesPacked
+    void setCompress(bool compress);
+
+    // Задержка от приема хостом (не от датчика) до отправки за последнюю секунду, мкс
+    int latency() const;
+    int maxLatency() const;
+    quint64 samplesSent() const;
+    quint64 bytesSent() const;
+
+public slots:
+    bool start();
+    void stop();
+    void sendKey(const QString &address, int type);
+    // Отправка новых отсчетов (вызывается таймером)
+    void poll();
+
+signals:
+    void error(const QString &message);
+    void statsUpdated();
+
+private slots:
+    void readDatagrams();
+    void acceptConnection();
+    void readSubscription();
+    void clientDisconnected();
+
+private:
+    struct Stream {
+        VecsSampleReader reader;
+        StreamInfo info;
+        bool infoDirty;
+        // Неполный кадр: отсчеты с номера pendingSequence подряд
+        QVector<VecsSample> pending;
+        quint64 pendingSequence;
+    };
+
+    struct Subscriber {
+        QHostAddress address;
+        quint16 port;
+        QTcpSocket *socket;
+        quint8 roleMask;
+        quint16 device;
+        qint64 expires;
+    };
+
+    void subscribe(const VecsStreamFormat::Header &header, const QHostAddress &address, quint16 port, QTcpSocket *socket);
+    bool accepts(const Subscriber &subscriber, int device, int role) const;
+    void send(const QByteArray &frame, int device, int role, Subscriber *only = nullptr);
+    // Отправляет stream->pending одним кадром
+    void sendSamples(int device, Stream *stream);
+    QByteArray deviceFrame(int device, const StreamInfo &info) const;
+    void updateStats(qint64 now);
+
+private:
+    mutable QMutex m_mutex;
+    QVector<Stream *> m_streams;
+
+    quint16 m_udpPort;
+    quint16 m_tcpPort;
+    int m_interval;
+    int m_batch;
+    qint64 m_holdTime;
+    bool m_compress;
+
+    QTimer *m_timer;
+    QUdpSocket *m_udp;
+    QTcpServer *m_tcp;
+    QList<Subscriber> m_subscribers;
+    QByteArray m_frame;
+
+    qint64 m_statsTime;
+    qint64 m_latencySum;
+    qint64 m_latencyMax;
+    qint64 m_latencyCount;
+    QAtomicInt m_latency;
+    QAtomicInt m_maxLatency;
+    QAtomicInteger<quint64> m_samplesSent;
+    QAtomicInteger<quint64> m_bytesSent;
+};
+
+#endif // VECSSTREAMSERVER_H
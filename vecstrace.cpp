@@ -0,0 +1,192 @@
+#include "vecstrace.h"
+#include "vecssamplering.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+QBasicAtomicInt VecsTrace::g_enabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+namespace {
+
+struct Event {
+    qint64 timestamp;
+    const char *category;
+    const char *name;
+    quint64 id;
+    quint64 arg;
+    char phase;
+};
+
+/*
+ * Буфер одного потока: пишет только владелец, читает dump(). Ячейка seq
+ * перезаписывается событием seq + size, поэтому после копирования dump()
+ * отбрасывает события, которые писатель мог успеть затереть.
+ */
+class Buffer
+{
+public:
+    Buffer(int size, int tid, const QString &name) :
+        m_events(size),
+        m_mask(quint64(size - 1)),
+        m_head(0),
+        m_tid(tid),
+        m_name(name)
+    {
+    }
+
+    void record(const Event &event)
+    {
+        const quint64 head = m_head.load();
+        // Как в VecsSampleRing::beginWrite(): ячейка меняется после публикации head
+        std::atomic_thread_fence(std::memory_order_release);
+        m_events[int(head & m_mask)] = event;
+        m_head.storeRelease(head + 1);
+    }
+
+    QVector<Event> events() const
+    {
+        // Ячейку head писатель может заполнять прямо сейчас, она совпадает с head - size:
+        // тот же запас, что у VecsSampleRing::oldestValid()
+        const quint64 window = m_mask;
+        const quint64 head = m_head.loadAcquire();
+        const quint64 first = (head > window) ? head - window : 0;
+
+        QVector<Event> events;
+        events.reserve(int(head - first));
+        for (quint64 seq = first; seq < head; ++seq)
+            events.append(m_events.at(int(seq & m_mask)));
+
+        // Затертые во время копирования события лежат в начале
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const quint64 after = m_head.load();
+        const quint64 oldest = (after > window) ? after - window : 0;
+        if (oldest > first)
+            events.remove(0, int(qMin(head, oldest) - first));
+        return events;
+    }
+
+    int tid() const { return m_tid; }
+    QString name() const { return m_name; }
+
+private:
+    QVector<Event> m_events;
+    const quint64 m_mask;
+    QAtomicInteger<quint64> m_head;
+    const int m_tid;
+    const QString m_name;
+};
+
+// Буферы живут до конца процесса: события завершившихся потоков тоже попадают в выгрузку
+QMutex g_mutex;
+QVector<Buffer *> g_buffers;
+int g_bufferSize = 65536;
+
+thread_local Buffer *t_buffer = nullptr;
+
+Buffer *threadBuffer()
+{
+    if (t_buffer == nullptr) {
+        QMutexLocker locker(&g_mutex);
+        QString name = QThread::currentThread()->objectName();
+        if (name.isEmpty())
+            name = (QThread::currentThread() == qApp->thread()) ? QString("main") : QString("thread");
+        t_buffer = new Buffer(g_bufferSize, g_buffers.size() + 1, name);
+        g_buffers.append(t_buffer);
+    }
+    return t_buffer;
+}
+
+}
+
+// Строка для JSON в кавычках (имя потока задает приложение и может содержать что угодно)
+static QString jsonString(const QString &value)
+{
+    QString result("\"");
+    for (const QChar c : value) {
+        if (c == '"' || c == '\\')
+            result += '\\' + QString(c);
+        else if (c.unicode() < 0x20)
+            result += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        else
+            result += c;
+    }
+    result += '"';
+    return result;
+}
+
+void VecsTrace::setEnabled(bool enabled)
+{
+    g_enabled.store(enabled ? 1 : 0);
+}
+
+void VecsTrace::setBufferSize(int events)
+{
+    // Степень двойки: номер ячейки - младшие биты порядкового номера
+    int size = 1024;
+    while (size < events && size < (1 << 24))
+        size <<= 1;
+
+    QMutexLocker locker(&g_mutex);
+    g_bufferSize = size;
+}
+
+void VecsTrace::record(char phase, const char *category, const char *name, quint64 id, quint64 arg)
+{
+    threadBuffer()->record({ vecsTimestamp(), category, name, id, arg, phase });
+}
+
+QByteArray VecsTrace::toJson()
+{
+    QVector<Buffer *> buffers;
+    {
+        QMutexLocker locker(&g_mutex);
+        buffers = g_buffers;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QByteArray json("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&] {
+        if (!first)
+            json += ",\n";
+        first = false;
+    };
+
+    for (const Buffer *buffer : buffers) {
+        separator();
+        json += QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":%2,\"args\":{\"name\":%3}}")
+                .arg(pid).arg(buffer->tid()).arg(jsonString(buffer->name())).toUtf8();
+
+        for (const Event &e : buffer->events()) {
+            separator();
+            // Время в микросекундах, как требует формат
+            json += QString("{\"name\":\"%1\",\"cat\":\"%2\",\"ph\":\"%3\",\"ts\":%4,\"pid\":%5,\"tid\":%6")
+                    .arg(QString::fromLatin1(e.name), QString::fromLatin1(e.category), QString(QChar(e.phase)))
+                    .arg(e.timestamp / 1000.0, 0, 'f', 3)
+                    .arg(pid).arg(buffer->tid()).toUtf8();
+            if (e.phase == 'b' || e.phase == 'e')
+                json += QString(",\"id\":\"0x%1\"").arg(e.id, 0, 16).toUtf8();
+            if (e.phase == 'i')
+                json += ",\"s\":\"t\"";
+            if (e.arg != 0)
+                json += QString(",\"args\":{\"arg\":\"0x%1\"}").arg(e.arg, 0, 16).toUtf8();
+            json += "}";
+        }
+    }
+
+    json += "\n]}\n";
+    return json;
+}
+
+bool VecsTrace::dump(const QString &fileName)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(toJson());
+    return file.commit();
+}
@@ -0,0 +1,86 @@
+#ifndef VECSTRACE_H
+#define VECSTRACE_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QString>
+
+/*
+ * Трассировка горячих путей в формате Chrome trace (chrome://tracing, Perfetto).
+ * Каждый поток пишет события в собственный кольцевой буфер без блокировок
+ * (при переполнении теряются самые старые); dump() собирает буферы всех потоков.
+ * Имена и категории - строковые литералы, событие не выделяет память.
+ *
+ * Трассировка включается во время работы (setEnabled); выключенная стоит одной
+ * атомарной загрузки и ветвления на событие. Сборка с CONFIG += vecs_notrace
+ * (VECS_NO_TRACE) убирает макросы полностью.
+ *
+ *   VECS_TRACE_SCOPE(cat, name, arg)        - интервал до конца блока (B/E)
+ *   VECS_TRACE_INSTANT(cat, name, arg)      - мгновенное событие
+ *   VECS_TRACE_ASYNC_BEGIN(cat, name, id, arg) / VECS_TRACE_ASYNC_END(cat, name, id)
+ *                                            - интервал между обработчиками (b/e, по id)
+ */
+namespace VecsTrace
+{
+    extern QBasicAtomicInt g_enabled;
+
+    inline bool isEnabled()
+    {
+        return g_enabled.load();
+    }
+
+    void setEnabled(bool enabled);
+    // Число событий в буфере каждого потока; действует для буферов, созданных позже
+    void setBufferSize(int events);
+
+    void record(char phase, const char *category, const char *name, quint64 id, quint64 arg);
+
+    // Все записанные события в формате Chrome trace JSON
+    QByteArray toJson();
+    bool dump(const QString &fileName);
+}
+
+class VecsTraceScope
+{
+public:
+    VecsTraceScope(const char *category, const char *name, quint64 arg) :
+        m_category(nullptr),
+        m_name(name)
+    {
+        if (VecsTrace::isEnabled()) {
+            m_category = category;
+            VecsTrace::record('B', category, name, 0, arg);
+        }
+    }
+
+    ~VecsTraceScope()
+    {
+        if (m_category != nullptr)
+            VecsTrace::record('E', m_category, m_name, 0, 0);
+    }
+
+private:
+    const char *m_category;
+    const char *m_name;
+};
+
+#ifndef VECS_NO_TRACE
+#define VECS_TRACE_CONCAT_(a, b) a##b
+#define VECS_TRACE_CONCAT(a, b) VECS_TRACE_CONCAT_(a, b)
+#define VECS_TRACE_SCOPE(category, name, arg) \
+    VecsTraceScope VECS_TRACE_CONCAT(vecsTraceScope, __LINE__)(category, name, quint64(arg))
+#define VECS_TRACE_INSTANT(category, name, arg) \
+    do { if (VecsTrace::isEnabled()) VecsTrace::record('i', category, name, 0, quint64(arg)); } while (0)
+#define VECS_TRACE_ASYNC_BEGIN(category, name, id, arg) \
+    do { if (VecsTrace::isEnabled()) VecsTrace::record('b', category, name, quint64(id), quint64(arg)); } while (0)
+#define VECS_TRACE_ASYNC_END(category, name, id) \
+    do { if (VecsTrace::isEnabled()) VecsTrace::record('e', category, name, quint64(id), 0); } while (0)
+#else
+#define VECS_TRACE_SCOPE(category, name, arg) do {} while (0)
+#define VECS_TRACE_INSTANT(category, name, arg) do {} while (0)
+#define VECS_TRACE_ASYNC_BEGIN(category, name, id, arg) do {} while (0)
+#define VECS_TRACE_ASYNC_END(category, name, id) do {} while (0)
+#endif
+
+#endif // VECSTRACE_H
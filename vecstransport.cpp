@@ -0,0 +1,237 @@
+#include "vecstransport.h"
+#include "vecstrace.h"
+
+VecsTransport::VecsTransport(const QBluetoothAddress &address, QObject *parent) :
+    QObject(parent),
+    m_address(address),
+    m_connectionState(StateDisconnected),
+    m_autoStart(false),
+    m_mpuRate(100),
+    m_accelRange(0),
+    m_gyroRange(0),
+    m_maxReconnections(3),
+    m_reconnectBase(250),
+    m_reconnectMax(8000),
+    m_connMinInterval(0),
+    m_connMaxInterval(0),
+    m_connLatency(0),
+    m_connTimeout(0),
+    m_ring(nullptr),
+    m_samplesPending(0),
+    m_hasLastSample(false),
+    m_rateChanged(false),
+    m_maxInterpolatedGap(0),
+    m_mpuStartTime(-1),
+    m_backoffRandom(quint32(address.toUInt64())),
+    m_linkLostTime(-1),
+    m_reconnectTime(-1)
+{
+}
+
+VecsTransport::~VecsTransport()
+{
+}
+
+QBluetoothAddress VecsTransport::address() const
+{
+    return m_address;
+}
+
+void VecsTransport::setRing(VecsSampleRing *ring)
+{
+    m_ring = ring;
+}
+
+void VecsTransport::close()
+{
+    // Повторный вызов (из деструктора устройства после VecsController) ничего не делает
+    if (m_ring == nullptr)
+        return;
+
+    disconnectFromDevice();
+    m_ring = nullptr;
+}
+
+void VecsTransport::acknowledgeSamples()
+{
+    m_samplesPending.storeRelease(0);
+}
+
+const VecsSequenceTracker *VecsTransport::sequence() const
+{
+    return &m_sequence;
+}
+
+void VecsTransport::open()
+{
+}
+
+const VecsLinkCounters *VecsTransport::counters() const
+{
+    return &m_counters;
+}
+
+void VecsTransport::setMpuConfig(int rate, int accelRange, int gyroRange)
+{
+    m_mpuRate = rate;
+    m_accelRange = accelRange;
+    m_gyroRange = gyroRange;
+}
+
+void VecsTransport::setMpuRate(int rate)
+{
+    // Источник, не умеющий менять частоту на ходу, применит ее при следующем mpuStart()
+    m_mpuRate = rate;
+}
+
+void VecsTransport::refreshBattery()
+{
+}
+
+void VecsTransport::setMaxReconnections(int maxReconnections)
+{
+    m_maxReconnections = maxReconnections;
+}
+
+void VecsTransport::setReconnectBackoff(int baseDelay, int maxDelay)
+{
+    m_reconnectBase = qMax(1, baseDelay);
+    m_reconnectMax = qMax(m_reconnectBase, maxDelay);
+}
+
+void VecsTransport::setAutoStart(bool autoStart)
+{
+    m_autoStart = autoStart;
+}
+
+void VecsTransport::setMaxInterpolatedGap(int maxGap)
+{
+    m_maxInterpolatedGap = maxGap;
+}
+
+void VecsTransport::setConnectionParameters(double minInterval, double maxInterval, int latency, int supervisionTimeout)
+{
+    m_connMinInterval = minInterval;
+    m_connMaxInterval = qMax(minInterval, maxInterval);
+    m_connLatency = latency;
+    m_connTimeout = supervisionTimeout;
+}
+
+void VecsTransport::setConnectionState(ConnectionState state)
+{
+    if (state != m_connectionState) {
+        m_connectionState = state;
+        emit connectionStateChanged(state);
+    }
+}
+
+void VecsTransport::beginMpuStream()
+{
+    VECS_TRACE_ASYNC_BEGIN("mpu", "mpuStart", m_address.toUInt64(), m_mpuRate);
+    m_mpuStartTime = vecsTimestamp();
+    m_sequence.reset();
+    m_hasLastSample = false;
+    m_rateChanged = false;
+}
+
+void VecsTransport::endMpuStream()
+{
+    m_mpuStartTime = -1;
+}
+
+void VecsTransport::markRateChange()
+{
+    m_rateChanged = true;
+}
+
+void VecsTransport::pushSample(const VecsSample &sample)
+{
+    if (m_ring == nullptr)
+        return;
+
+    // Дубликаты и опоздавшие пакеты только учитываются: поток в буфере остается упорядоченным
+    int gap = 0;
+    if (m_sequence.track(sample.packetIndex, &gap) != VecsSequenceTracker::Accepted)
+        return;
+
+    if (gap > 0 && gap <= m_maxInterpolatedGap && m_hasLastSample)
+        interpolateGap(sample, gap);
+
+    if (m_rateChanged) {
+        VecsSample marked = sample;
+        marked.flags |= VecsSample::FlagRateChange;
+        m_ring->push(marked);
+        m_rateChanged = false;
+    } else {
+        m_ring->push(sample);
+    }
+    m_lastSample = sample;
+    m_hasLastSample = true;
+
+    if (m_mpuStartTime >= 0) {
+        VECS_TRACE_ASYNC_END("mpu", "mpuStart", m_address.toUInt64());
+        emit mpuFirstSample(sample.timestamp - m_mpuStartTime);
+        m_mpuStartTime = -1;
+
+        if (m_linkLostTime >= 0) {
+            const int outage = int((sample.timestamp - m_linkLostTime) / 1000000);
+            m_counters.outage.add(quint64(outage));
+            if (outage > m_counters.outageMax.load())
+                m_counters.outageMax.store(outage);
+            emit reconnected(sample.timestamp - m_reconnectTime, sample.timestamp - m_linkLostTime);
+            clearLinkLost();
+        }
+    }
+
+    // Будим потребителя, только если он уже забрал предыдущую порцию
+    if (m_samplesPending.testAndSetAcquire(0, 1))
+        emit samplesAvailable();
+}
+
+int VecsTransport::reconnectDelay(int attempt)
+{
+    // Половина задержки фиксирована, вторая половина случайна
+    const qint64 delay = qMin<qint64>(m_reconnectMax, qint64(m_reconnectBase) << qBound(0, attempt - 1, 20));
+    std::uniform_int_distribution<int> jitter(0, int(delay / 2));
+    return int(delay - delay / 2) + jitter(m_backoffRandom);
+}
+
+void VecsTransport::markLinkLost()
+{
+    // При повторных обрывах время считается от первого
+    if (m_linkLostTime < 0)
+        m_linkLostTime = vecsTimestamp();
+}
+
+void VecsTransport::markReconnectAttempt()
+{
+    if (m_linkLostTime >= 0) {
+        m_reconnectTime = vecsTimestamp();
+        m_counters.reconnects.fetchAndAddRelaxed(1);
+    }
+}
+
+void VecsTransport::clearLinkLost()
+{
+    m_linkLostTime = -1;
+    m_reconnectTime = -1;
+}
+
+void VecsTransport::interpolateGap(const VecsSample &next, int gap)
+{
+    // Линейная интерполяция между последним принятым и текущим отсчетом
+    const VecsSample &prev = m_lastSample;
+    const int steps = gap + 1;
+
+    for (int k = 1; k <= gap; ++k) {
+        VecsSample *s = m_ring->beginWrite();
+        s->timestamp = prev.timestamp + (next.timestamp - prev.timestamp) * k / steps;
+        s->packetIndex = quint16(prev.packetIndex + k);
+        s->flags = VecsSample::FlagSynthetic;
+        for (int i = 0; i < 3; ++i) {
+            s->accel[i] = qint16(prev.accel[i] + (next.accel[i] - prev.accel[i]) * k / steps);
+            s->gyro[i] = qint16(prev.gyro[i] + (next.gyro[i] - prev.gyro[i]) * k / steps);
+        }
+        m_ring->commitWrite();
+    }
+}
@@ -0,0 +1,164 @@
+#ifndef VECSTRANSPORT_H
+#define VECSTRANSPORT_H
+
+#include <QObject>
+#include <QAtomicInteger>
+#include <QBluetoothAddress>
+#include <random>
+#include "vecssamplering.h"
+#include "vecssequencetracker.h"
+#include "vecsmetrics.h"
+
+/*
+ * Канал связи VecsDevice с датчиком. Объект живет в потоке сбора данных,
+ * пишет декодированные отсчеты MPU прямо в кольцевой буфер устройства
+ * и сообщает VecsDevice только об изменениях состояния. Все публичные слоты
+ * вызываются через очередь событий.
+ *
+ * Реализации: VecsBleTransport (реальный датчик), VecsSimTransport (генератор
+ * потока), VecsReplayTransport (воспроизведение записанной сессии).
+ */
+class VecsTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Значения совпадают с VecsDevice::ConnectionState
+    enum ConnectionState {
+        StateDisconnected = 0,
+        StateConnecting,
+        StateConnected
+    };
+
+    explicit VecsTransport(const QBluetoothAddress &address, QObject *parent = 0);
+    ~VecsTransport();
+
+    QBluetoothAddress address() const;
+
+    // Задается владельцем буфера до переноса транспорта в поток сбора данных
+    void setRing(VecsSampleRing *ring);
+
+    // Сбрасывает флаг ожидания; вызывается потребителем перед чтением буфера
+    void acknowledgeSamples();
+
+    // Статистика потерь пакетов MPU (счетчики можно читать из любого потока)
+    const VecsSequenceTracker *sequence() const;
+    // Счетчики канала связи для VecsDeviceMetrics (читать можно из любого потока)
+    const VecsLinkCounters *counters() const;
+
+public slots:
+    // Создание объектов, которые должны принадлежать потоку сбора данных
+    virtual void open();
+
+    virtual void connectToDevice() = 0;
+    virtual void disconnectFromDevice() = 0;
+    // Отключение перед удалением владельца буфера: после возврата отсчеты
+    // в буфер больше не пишутся (в т.ч. из уже стоящих в очереди уведомлений)
+    void close();
+
+    virtual void keyRequest(int delay) = 0;
+    virtual void mpuStart() = 0;
+    virtual void mpuStop() = 0;
+
+    // Параметры MPU, применяемые при следующем mpuStart() (в т.ч. автоматическом)
+    void setMpuConfig(int rate, int accelRange, int gyroRange);
+    // Смена частоты работающего потока без перезапуска, если ее поддерживает источник;
+    // первый отсчет с новой частотой помечается VecsSample::FlagRateChange
+    virtual void setMpuRate(int rate);
+
+    // Запрос уровня заряда, по расписанию VecsScheduler; источники, которые сообщают
+    // уровень сами (уведомления BLE), запрос игнорируют
+    virtual void refreshBattery();
+    void setMaxReconnections(int maxReconnections);
+    // Границы задержки переподключения, мс
+    void setReconnectBackoff(int baseDelay, int maxDelay);
+    void setAutoStart(bool autoStart);
+    // Пропуски не длиннее maxGap пакетов заполняются интерполированными отсчетами (0 - отключено)
+    void setMaxInterpolatedGap(int maxGap);
+    // Желаемые параметры соединения: интервал, мс; число пропускаемых датчиком событий;
+    // таймаут разрыва, мс. minInterval = 0 - параметры выбирает стек
+    virtual void setConnectionParameters(double minInterval, double maxInterval, int latency, int supervisionTimeout);
+
+signals:
+    void connectionStateChanged(int state);
+    void connected();
+    void batteryLevelChanged(int level);
+    void keyPressed(int type);
+    void mpuStateChanged(bool state);
+    // Время от запроса mpuStart() до первого пакета MPU, нс
+    void mpuFirstSample(qint64 elapsed);
+    // Первый отсчет после восстановления связи: время от начала успешной попытки
+    // переподключения и от момента обрыва, нс
+    void reconnected(qint64 reconnectTime, qint64 outageTime);
+    // Параметры, согласованные с датчиком
+    void connectionParametersChanged(double interval, int latency, int supervisionTimeout);
+
+    // Испускается не чаще одного раза до вызова acknowledgeSamples()
+    void samplesAvailable();
+
+protected:
+    void setConnectionState(ConnectionState state);
+
+    // Начало нового потока MPU: счетчик пакетов устройства начинается заново
+    void beginMpuStream();
+    void endMpuStream();
+    // Следующий отсчет потока получит флаг FlagRateChange
+    void markRateChange();
+
+    // Общий путь всех реализаций: учет потерь, интерполяция, запись в буфер
+    void pushSample(const VecsSample &sample);
+
+    // Задержка перед попыткой переподключения attempt (с 1), мс:
+    // экспоненциальный рост от baseDelay до maxDelay со случайным разбросом,
+    // чтобы датчики, потерявшие связь одновременно, не переподключались разом
+    int reconnectDelay(int attempt);
+    // Связь, продержавшаяся столько мс, считается восстановленной, и попытки
+    // переподключения считаются заново. Сброс сразу при подключении не дал бы
+    // задержке расти, если связь рвется сразу после установления
+    enum { StableLinkTime = 10000 };
+    // Учет времени восстановления связи
+    void markLinkLost();
+    void markReconnectAttempt();
+    void clearLinkLost();
+
+private:
+    void interpolateGap(const VecsSample &next, int gap);
+
+protected:
+    QBluetoothAddress m_address;
+    ConnectionState m_connectionState;
+    bool m_autoStart;
+
+    int m_mpuRate;
+    int m_accelRange;
+    int m_gyroRange;
+
+    int m_maxReconnections;
+    int m_reconnectBase;
+    int m_reconnectMax;
+
+    // Пишутся только в потоке транспорта
+    VecsLinkCounters m_counters;
+
+    double m_connMinInterval;
+    double m_connMaxInterval;
+    int m_connLatency;
+    int m_connTimeout;
+
+private:
+    VecsSampleRing *m_ring;
+    QAtomicInt m_samplesPending;
+
+    VecsSequenceTracker m_sequence;
+    VecsSample m_lastSample;
+    bool m_hasLastSample;
+    bool m_rateChanged;
+    int m_maxInterpolatedGap;
+    qint64 m_mpuStartTime;
+
+    std::minstd_rand m_backoffRandom;
+    qint64 m_linkLostTime;
+    qint64 m_reconnectTime;
+};
+
+#endif // VECSTRANSPORT_H
@@ -0,0 +1,74 @@
+#include "vecsunits.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define VECS_UNITS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define VECS_UNITS_NEON
+#endif
+
+static const float StandardGravity = 9.80665f;
+static const float DegreesToRadians = 3.14159265358979323846f / 180.0f;
+
+// Чувствительность MPU-6050 по документации: LSB/g и LSB/(°/s) для каждого диапазона
+static const float AccelSensitivity[] = { 16384.0f, 8192.0f, 4096.0f, 2048.0f };
+static const float GyroSensitivity[] = { 131.0f, 65.5f, 32.8f, 16.4f };
+
+float VecsUnits::accelScale(int range, AccelUnit unit)
+{
+    const float scale = 1.0f / AccelSensitivity[qBound(0, range, 3)];
+    return (unit == MetersPerSecondSquared) ? scale * StandardGravity : scale;
+}
+
+float VecsUnits::gyroScale(int range, GyroUnit unit)
+{
+    const float scale = 1.0f / GyroSensitivity[qBound(0, range, 3)];
+    return (unit == RadiansPerSecond) ? scale * DegreesToRadians : scale;
+}
+
+void VecsUnits::scale(const qint16 *src, float *dst, int count, float scale)
+{
+    int i = 0;
+
+#if defined(VECS_UNITS_SSE2)
+    // 8 отсчетов за итерацию: расширение со знаком до int32, перевод в float, умножение
+    const __m128 k = _mm_set1_ps(scale);
+    for (; i + 8 <= count; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+#elif defined(VECS_UNITS_NEON)
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t v = vld1q_s16(src + i);
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(dst + i, vmulq_n_f32(lo, scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(hi, scale));
+    }
+#endif
+
+    // Остаток блока (или весь блок без SIMD)
+    for (; i < count; ++i)
+        dst[i] = float(src[i]) * scale;
+}
+
+void VecsUnits::convert(const VecsSampleBlock &raw, int accelRange, int gyroRange, VecsMotionBlock *out,
+                        AccelUnit accelUnit, GyroUnit gyroUnit)
+{
+    const int count = raw.size();
+    out->resize(count);
+    out->timestamp = raw.timestamp;
+
+    // Цена разряда одна на весь блок
+    const float a = accelScale(accelRange, accelUnit);
+    const float g = gyroScale(gyroRange, gyroUnit);
+
+    for (int i = 0; i < 3; ++i) {
+        scale(raw.accel[i].constData(), out->accel[i].data(), count, a);
+        scale(raw.gyro[i].constData(), out->gyro[i].data(), count, g);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef VECSUNITS_H
+#define VECSUNITS_H
+
+#include <QtGlobal>
+#include "vecssampleblock.h"
+
+/*
+ * Перевод отсчетов MPU-6050 из единиц АЦП в физические единицы.
+ * Цена разряда определяется диапазоном устройства и вычисляется один раз на блок,
+ * внутренний цикл - умножение плотного массива qint16 на константу
+ * (SSE2 или NEON, если доступны при сборке, иначе скалярный вариант).
+ */
+namespace VecsUnits
+{
+    enum AccelUnit {
+        G,
+        MetersPerSecondSquared
+    };
+
+    enum GyroUnit {
+        DegreesPerSecond,
+        RadiansPerSecond
+    };
+
+    // Цена разряда для VecsDevice::AccelRange / VecsDevice::GyroRange
+    float accelScale(int range, AccelUnit unit = G);
+    float gyroScale(int range, GyroUnit unit = DegreesPerSecond);
+
+    // dst[i] = src[i] * scale
+    void scale(const qint16 *src, float *dst, int count, float scale);
+
+    // Переводит весь блок; out принимает размер raw
+    void convert(const VecsSampleBlock &raw, int accelRange, int gyroRange, VecsMotionBlock *out,
+                 AccelUnit accelUnit = G, GyroUnit gyroUnit = DegreesPerSecond);
+}
+
+#endif // VECSUNITS_H
@@ -0,0 +1,238 @@
+#include "vecswaveform.h"
+#include <QSGGeometryNode>
+#include <QSGFlatColorMaterial>
+#include <QtGui/qopengl.h>
+
+// Цвета осей X, Y, Z (одинаковые для акселерометра и гироскопа)
+static const QRgb AxisColors[3] = { 0xc0392b, 0x27ae60, 0x1d5c97 };
+
+VecsWaveform::VecsWaveform(QQuickItem *parent) :
+    QQuickItem(parent),
+    m_channels(0x3f),
+    m_points(1000),
+    m_range(32768),
+    m_written(0),
+    m_rebuild(true)
+{
+    setFlag(ItemHasContents, true);
+    m_values.fill(0, m_points * ChannelCount);
+}
+
+VecsDevice *VecsWaveform::device() const
+{
+    return m_device;
+}
+
+void VecsWaveform::setDevice(VecsDevice *device)
+{
+    if (device == m_device)
+        return;
+
+    if (m_device != nullptr)
+        disconnect(m_device, nullptr, this, nullptr);
+
+    m_device = device;
+    m_reader.attach(device != nullptr ? device->samples() : nullptr);
+    m_reader.seekToHead();
+
+    if (m_device != nullptr) {
+        // Новые отсчеты публикуются устройством раз в кадр
+        connect(m_device, &VecsDevice::mpuDataRecieved, this, &QQuickItem::update);
+        connect(m_device, &QObject::destroyed, this, &VecsWaveform::deviceDestroyed);
+    }
+
+    restart();
+    emit deviceChanged();
+}
+
+void VecsWaveform::deviceDestroyed()
+{
+    m_reader.attach(nullptr);
+    restart();
+    emit deviceChanged();
+}
+
+int VecsWaveform::channels() const
+{
+    return m_channels;
+}
+
+void VecsWaveform::setChannels(int channels)
+{
+    channels &= (1 << ChannelCount) - 1;
+    if (channels != m_channels) {
+        m_channels = channels;
+        m_rebuild = true;
+        update();
+        emit channelsChanged();
+    }
+}
+
+int VecsWaveform::points() const
+{
+    return m_points;
+}
+
+void VecsWaveform::setPoints(int points)
+{
+    points = qMax(2, points);
+    if (points != m_points) {
+        m_points = points;
+        restart();
+        emit pointsChanged();
+    }
+}
+
+int VecsWaveform::range() const
+{
+    return m_range;
+}
+
+void VecsWaveform::setRange(int range)
+{
+    range = qMax(1, range);
+    if (range != m_range) {
+        m_range = range;
+        m_rebuild = true;
+        update();
+        emit rangeChanged();
+    }
+}
+
+void VecsWaveform::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size()) {
+        m_rebuild = true;
+        update();
+    }
+}
+
+void VecsWaveform::restart()
+{
+    m_values.fill(0, m_points * ChannelCount);
+    m_written = 0;
+    m_rebuild = true;
+    update();
+}
+
+float VecsWaveform::valueY(qint16 value) const
+{
+    const float h = float(height());
+    return qBound(0.0f, h / 2 - float(value) * h / (2 * m_range), h);
+}
+
+void VecsWaveform::writeSlot(QSGGeometry *geometry, int channel, int slot) const
+{
+    // Режим GL_LINES: отрезок slot соединяет точки slot - 1 и slot. Отрезок 0 вырожденный
+    // (нет перехода с правого края на левый), следующий за головой развертки тоже,
+    // чтобы старые данные не соединялись с новыми
+    QSGGeometry::Point2D *v = geometry->vertexDataAsPoint2D();
+    const float x = float(slot) * float(width()) / (m_points - 1);
+    const float y = valueY(m_values.at(slot * ChannelCount + channel));
+
+    v[2 * slot + 1].set(x, y);
+    if (slot == 0)
+        v[0].set(x, y);
+    if (slot + 1 < m_points) {
+        v[2 * (slot + 1)].set(x, y);
+        v[2 * (slot + 1) + 1].set(x, y);
+    }
+}
+
+void VecsWaveform::rebuild(QSGNode *root)
+{
+    while (QSGNode *child = root->firstChild()) {
+        root->removeChildNode(child);
+        delete child;
+    }
+
+    const int valid = int(qMin<quint64>(m_written, quint64(m_points)));
+    const int head = (m_written > 0) ? int((m_written - 1) % quint64(m_points)) : -1;
+
+    for (int c = 0; c < ChannelCount; ++c) {
+        if (!(m_channels & (1 << c)))
+            continue;
+
+        QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 2 * m_points);
+        geometry->setDrawingMode(GL_LINES);
+        geometry->setLineWidth(1);
+        // Вершины меняются каждый кадр: отдельный буфер, без объединения с другими узлами
+        geometry->setVertexDataPattern(QSGGeometry::DynamicPattern);
+
+        // Незаполненные точки - вырожденные отрезки в начале координат
+        QSGGeometry::Point2D *v = geometry->vertexDataAsPoint2D();
+        for (int i = 0; i < 2 * m_points; ++i)
+            v[i].set(0, float(height()) / 2);
+
+        // Заполненные точки в порядке записи, чтобы голова развертки осталась с разрывом
+        for (int i = 0; i < valid; ++i)
+            writeSlot(geometry, c, (head + 1 + i + (m_points - valid)) % m_points);
+
+        QSGFlatColorMaterial *material = new QSGFlatColorMaterial;
+        material->setColor(QColor(AxisColors[c % 3]));
+
+        QSGGeometryNode *node = new QSGGeometryNode;
+        node->setGeometry(geometry);
+        node->setMaterial(material);
+        node->setFlags(QSGNode::OwnedByParent | QSGNode::OwnsGeometry | QSGNode::OwnsMaterial);
+        root->appendChildNode(node);
+    }
+
+    m_rebuild = false;
+}
+
+QSGNode *VecsWaveform::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data)
+
+    // Вызывается в потоке отрисовки, пока поток GUI заблокирован: курсор и значения
+    // можно менять без синхронизации. Писатель буфера (поток сбора данных) не ждет
+    QSGNode *root = oldNode;
+    if (root == nullptr) {
+        root = new QSGNode;
+        m_rebuild = true;
+    }
+
+    bool changed = false;
+    const int first = int(m_written % quint64(m_points));
+    int count = 0;
+    m_reader.drain([&](const VecsSample *samples, int n) {
+        for (int i = 0; i < n; ++i, ++m_written) {
+            const int slot = int(m_written % quint64(m_points));
+            qint16 *values = m_values.data() + slot * ChannelCount;
+            values[0] = samples[i].accel[0];
+            values[1] = samples[i].accel[1];
+            values[2] = samples[i].accel[2];
+            values[3] = samples[i].gyro[0];
+            values[4] = samples[i].gyro[1];
+            values[5] = samples[i].gyro[2];
+        }
+        count += n;
+    });
+
+    if (m_rebuild) {
+        rebuild(root);
+        changed = true;
+    } else if (count > 0) {
+        // Обновляются только вершины новых отсчетов (не больше одной развертки)
+        const int slots = qMin(count, m_points);
+        const int start = (count > m_points) ? int(m_written % quint64(m_points)) : first;
+        int c = 0;
+        for (QSGNode *node = root->firstChild(); node != nullptr; node = node->nextSibling(), ++c) {
+            while (!(m_channels & (1 << c)))
+                ++c;
+            QSGGeometry *geometry = static_cast<QSGGeometryNode *>(node)->geometry();
+            for (int i = 0; i < slots; ++i)
+                writeSlot(geometry, c, (start + i) % m_points);
+        }
+        changed = true;
+    }
+
+    if (changed) {
+        for (QSGNode *node = root->firstChild(); node != nullptr; node = node->nextSibling())
+            node->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    return root;
+}
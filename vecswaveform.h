@@ -0,0 +1,81 @@
+#ifndef VECSWAVEFORM_H
+#define VECSWAVEFORM_H
+
+#include <QQuickItem>
+#include <QPointer>
+#include <QVector>
+#include "vecsdevice.h"
+
+class QSGGeometry;
+
+/*
+ * Осциллограмма осей MPU одного устройства. Отсчеты берутся прямо из кольцевого
+ * буфера устройства своим курсором, без привязок QML. Развертка "бегущая":
+ * новый отсчет записывается в следующую по X точку поверх самого старого, поэтому
+ * за кадр меняются только вершины новых отсчетов, а не весь график.
+ * Каналы: 0-2 акселерометр X, Y, Z; 3-5 гироскоп X, Y, Z (маска channels).
+ */
+class VecsWaveform : public QQuickItem
+{
+    Q_OBJECT
+
+    Q_PROPERTY(VecsDevice *device READ device WRITE setDevice NOTIFY deviceChanged)
+    Q_PROPERTY(int channels READ channels WRITE setChannels NOTIFY channelsChanged)
+    // Число отсчетов по ширине графика
+    Q_PROPERTY(int points READ points WRITE setPoints NOTIFY pointsChanged)
+    // Модуль значения (в отсчетах АЦП), соответствующий краю графика
+    Q_PROPERTY(int range READ range WRITE setRange NOTIFY rangeChanged)
+
+public:
+    enum { ChannelCount = 6 };
+
+    explicit VecsWaveform(QQuickItem *parent = 0);
+
+    VecsDevice *device() const;
+    void setDevice(VecsDevice *device);
+
+    int channels() const;
+    void setChannels(int channels);
+
+    int points() const;
+    void setPoints(int points);
+
+    int range() const;
+    void setRange(int range);
+
+signals:
+    void deviceChanged();
+    void channelsChanged();
+    void pointsChanged();
+    void rangeChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+private slots:
+    void deviceDestroyed();
+
+private:
+    // Сбрасывает развертку (новое устройство или число точек)
+    void restart();
+    void rebuild(QSGNode *root);
+    void writeSlot(QSGGeometry *geometry, int channel, int slot) const;
+    float valueY(qint16 value) const;
+
+private:
+    QPointer<VecsDevice> m_device;
+    int m_channels;
+    int m_points;
+    int m_range;
+
+    VecsSampleReader m_reader;
+    // Значения всех каналов по точкам развертки, для перестроения при изменении размера
+    QVector<qint16> m_values;
+    // Число отсчетов, записанных в развертку с ее начала
+    quint64 m_written;
+    // Вершины нужно построить заново (размер, каналы, устройство)
+    bool m_rebuild;
+};
+
+#endif // VECSWAVEFORM_H